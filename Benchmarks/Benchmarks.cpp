@@ -0,0 +1,539 @@
+#include "../srt/srt.h"
+#include "../srt/wavelength.h"
+#include "../srt/RayDump.h"
+using namespace srt;
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+// micro benchmarks of the hot paths.
+//
+// usage: Benchmarks [filter] [--out file.csv] [--baseline file.csv] [--quick]
+//        Benchmarks --check
+//
+// a benchmark is run in batches. the batch is grown until it takes
+// kMinBatchSeconds, then `samples` batches are timed. ns/op is the median of
+// the batches, the spread is given as the median absolute deviation (mad).
+// with --baseline, a benchmark whose median is slower by more than 10% and
+// more than 3 mad of both runs is reported, and the exit code is 1.
+// --check compares the fast paths with their reference code on random
+// inputs instead, e.g. the quadric kernels or the rays a screen records
+// through the origin cache, the exit code is 1 if one of them differs.
+
+// the checksums of the batches are written here, so the work is kept
+volatile double gSink;
+
+double const kMinBatchSeconds = 0.01;
+
+struct Result {
+    std::string name;
+    int64_t batch = 0;
+    int samples = 0;
+    double median = 0;
+    double min = 0;
+    double mean = 0;
+    double stddev = 0;
+    double mad = 0;
+};
+
+double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// op(i) does the i-th operation and returns something of its result
+template<class Op>
+Result measure(std::string const& name, int samples, Op op)
+{
+    using clock = std::chrono::steady_clock;
+    auto run = [&](int64_t n) {
+        double sum = 0;
+        auto t0 = clock::now();
+        for (int64_t i = 0; i < n; ++i) {
+            sum += op(i);
+        }
+        auto t1 = clock::now();
+        gSink = sum;
+        return std::chrono::duration<double>(t1 - t0).count();
+    };
+
+    // calibrate, the first batches also warm the caches
+    int64_t batch = 1;
+    for (;;) {
+        double t = run(batch);
+        if (t >= kMinBatchSeconds || batch >= (int64_t(1) << 40)) {
+            break;
+        }
+        batch *= t > 0 ? std::clamp<int64_t>(int64_t(kMinBatchSeconds / t * 1.2), 2, 100) : 100;
+    }
+
+    std::vector<double> ns(samples);
+    for (int s = 0; s < samples; ++s) {
+        ns[s] = run(batch) * 1E9 / batch;
+    }
+
+    Result r;
+    r.name = name;
+    r.batch = batch;
+    r.samples = samples;
+    r.median = median(ns);
+    r.min = *std::min_element(ns.begin(), ns.end());
+    for (double x : ns) {
+        r.mean += x / samples;
+    }
+    for (double x : ns) {
+        r.stddev += (x - r.mean) * (x - r.mean);
+    }
+    r.stddev = samples > 1 ? sqrt(r.stddev / (samples - 1)) : 0;
+    std::vector<double> dev(samples);
+    for (int s = 0; s < samples; ++s) {
+        dev[s] = fabs(ns[s] - r.median);
+    }
+    r.mad = median(dev);
+    return r;
+}
+
+// rays from a box around the origin, aimed near the origin,
+// so some hit and some miss the test objects
+std::vector<Ray> makeRays(size_t n)
+{
+    std::vector<Ray> rays;
+    rays.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        Vec3 o = { uniform(-3, 3), uniform(-3, 3), uniform(-3, 3) };
+        Vec3 t = { uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+        rays.emplace_back(o, normalize(t - o), 1., 500., Vec3{ 0, 0, 1 }, int64_t(i));
+    }
+    return rays;
+}
+
+std::vector<Vec3> makeNormals(size_t n)
+{
+    std::vector<Vec3> v(n);
+    for (auto& d : v) {
+        d = normalize(Vec3{ uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) });
+    }
+    return v;
+}
+
+// a source of the given power, for the source choice only
+struct PowerSource : Source {
+    PowerSource(Real amp) : Source(amp) {}
+    Ray generate() override { return Ray(); }
+};
+
+std::shared_ptr<Convex> unitBox()
+{
+    auto cc = convex({});
+    for (int axis = 0; axis < 3; ++axis) {
+        for (Real side : { -1., 1. }) {
+            Vec3 n = { 0, 0, 0 };
+            (axis == 0 ? n.fX : axis == 1 ? n.fY : n.fZ) = side;
+            cc->addSurface(planeSurface(pars::origin = 0.5 * n, pars::direction = n));
+        }
+    }
+    return cc;
+}
+
+// n small spheres in a cube, and a floor
+std::shared_ptr<Engine> sphereScene(int n)
+{
+    auto engine = std::make_shared<Engine>();
+    engine->addDevice(planeSurface(pars::origin = Vec3{ 0, 0, -2 },
+        pars::direction = Vec3{ 0, 0, 1 }));
+    Real r = 0.5 / cbrt(Real(n));
+    for (int i = 0; i < n; ++i) {
+        Vec3 c = { uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+        auto s = quadricSurface(pars::shape = ShapeType::Shpere,
+            pars::origin = c, pars::radius = r);
+        s->setBound(boxBound(c.fX - r, c.fX + r, c.fY - r, c.fY + r, c.fZ - r, c.fZ + r));
+        engine->addDevice(s);
+    }
+    return engine;
+}
+
+Bitmap testBitmap(int w, int h)
+{
+    Bitmap b;
+    b.resize(w, h);
+    for (int i = 0; i < h; ++i) {
+        for (int j = 0; j < w; ++j) {
+            b.at(i, j) = Color(Real(i) / h, Real(j) / w, 0.5, 1.);
+        }
+    }
+    return b;
+}
+
+// the kernels of the sphere, tube and conic quadrics against the general
+// form fQ, fP, fR of the same quadric, also after invert() and shift()
+int checkQuadricKernels()
+{
+    auto close = [](Real x, Real y, Real scale) {
+        return fabs(x - y) <= 1E-9 * scale;
+    };
+    auto randomVec = [](Real r) {
+        return Vec3{ uniform(-r, r), uniform(-r, r), uniform(-r, r) };
+    };
+
+    int failed = 0;
+    auto check = [&](std::string const& name, Quadric const& q) {
+        Quadric g = q;
+        g.fKind = QuadricKind::General;
+        int bad = 0;
+        for (int i = 0; i < 10000; ++i) {
+            // origins up to far away, as the rays of a telescope
+            Vec3 O = randomVec(i % 2 ? 3 : 1000);
+            Vec3 D = normalize(randomVec(1));
+            Vec3 V, gV;
+            Real c, gc;
+            q.originTerms(O, V, c);
+            g.originTerms(O, gV, gc);
+            Real a = q.directionTerm(D);
+            Real ga = g.directionTerm(D);
+            Real b = dot(V, D);
+            Real gb = dot(gV, D);
+            Real disc = q.discriminant(V, D, a, b, c);
+            Real gdisc = g.discriminant(gV, D, ga, gb, gc);
+            Vec3 grad = q.gradient(O);
+            Vec3 ggrad = g.gradient(O);
+
+            Real scale = 1 + norm2(O) + norm2(q.fCenter) + q.fRadius2
+                + Sqr(q.fCurvature) * (1 + fabs(q.fConic));
+            Real lscale = sqrt(scale);
+            bool ok = close(c, gc, scale)
+                && close(V.fX, gV.fX, lscale) && close(V.fY, gV.fY, lscale) && close(V.fZ, gV.fZ, lscale)
+                && close(a, ga, 1 + fabs(q.fConic))
+                && close(disc, gdisc, scale * (1 + fabs(q.fConic)))
+                && close(grad.fX, ggrad.fX, lscale) && close(grad.fY, ggrad.fY, lscale)
+                && close(grad.fZ, ggrad.fZ, lscale);
+            if (!ok && bad++ == 0) {
+                printf("%s: O %s D %s\n    c %g %g a %g %g disc %g %g\n", name.c_str(),
+                    to_string(O).c_str(), to_string(D).c_str(), c, gc, a, ga, disc, gdisc);
+            }
+        }
+        printf("%-40s %s\n", ("check quadric " + name).c_str(), bad ? "FAILED" : "ok");
+        failed += bad != 0;
+    };
+
+    for (int k = 0; k < 8; ++k) {
+        Vec3 o = randomVec(2);
+        Vec3 d = normalize(randomVec(1));
+        Real r = uniform(0.1, 2);
+        Vec3 s = randomVec(5);
+        std::string n = "/" + std::to_string(k);
+
+        Quadric sphere;
+        sphere.setSphere(o, r);
+        Quadric tube;
+        tube.setTube(o, d, r);
+        Quadric conic;
+        // K < -1 hyperboloid, -1 paraboloid, 0 sphere, > 0 oblate
+        conic.setConicSurface(o, d, r, k % 4 == 0 ? -1. : uniform(-3, 3));
+        for (auto [name, q] : { std::pair{ "sphere", sphere },
+            std::pair{ "tube", tube }, std::pair{ "conic", conic } }) {
+            check(name + n, q);
+            Quadric inv = q;
+            inv.invert();
+            check(name + n + "/inverted", inv);
+            Quadric shifted = inv;
+            shifted.shift(s);
+            check(name + n + "/inverted/shifted", shifted);
+        }
+    }
+    return failed;
+}
+
+// a screen hit by a point source records the same rays whether the engine
+// traces them from its origin cache or one by one without it
+int checkScreenOrigin()
+{
+    int failed = 0;
+    auto check = [&](std::string const& name, auto make) {
+        int const N = 1000;
+        std::string const shared_file = "check_screen_shared.srtrays";
+        std::string const single_file = "check_screen_single.srtrays";
+
+        auto shared = make();
+        Engine en;
+        en.addSource(comSource(1, monoSpectrum(500),
+            pointPositionSampler(Vec3{ 0, 0, 0 }, Vec3{ 0, 0, 1 }),
+            cosineDirectionSampler()));
+        en.addDevice(shared);
+        en.emit(N);
+        uint64_t escaped = en.lastStats().fEscaped;
+        shared->save(shared_file);
+
+        RayDumpReader shared_rays(shared_file);
+        auto single = make();
+        Engine en1;
+        en1.addDevice(single);
+        for (auto& chunk : shared_rays.chunks()) {
+            for (size_t i = 0; i < chunk.fRows; ++i) {
+                Ray r = chunk.ray(i);
+                en1.emit(Ray(Vec3{ 0, 0, 0 }, r.fD, 1, r.fLambda, Vec3(), 0));
+            }
+        }
+        single->save(single_file);
+        RayDumpReader single_rays(single_file);
+
+        int bad = shared_rays.rows() + escaped != (uint64_t)N
+            || single_rays.rows() != shared_rays.rows();
+        RayDumpIter a(shared_rays), b(single_rays);
+        for (; !bad && !a.end() && !b.end(); a.next(), b.next()) {
+            Vec3 d = a.get().fO - b.get().fO;
+            bad = norm2(d) > 1E-18;
+        }
+        if (bad) {
+            printf("%s: %d rays, %lld recorded %lld escaped, %lld one by one\n", name.c_str(), N,
+                (long long)shared_rays.rows(), (long long)escaped, (long long)single_rays.rows());
+        }
+        printf("%-40s %s\n", ("check screen origin " + name).c_str(), bad ? "FAILED" : "ok");
+        failed += bad;
+        std::remove(shared_file.c_str());
+        std::remove(single_file.c_str());
+    };
+
+    check("plane", [] {
+        return planeScreen(pars::origin = Vec3{ 0, 0, 1 },
+            pars::direction = Vec3{ 0, 0, 1 },
+            pars::reflectRatio = 0.,
+            pars::refractRatio = 0.);
+        });
+    check("quadric", [] {
+        auto scn = std::make_shared<QuadricScreen>();
+        scn->setSphere(Vec3{ 0, 0, 0.5 }, 2);
+        scn->setReflect(0.);
+        scn->setTrans(0.);
+        return scn;
+        });
+    return failed;
+}
+
+std::vector<Result> readCSV(std::string const& filename)
+{
+    std::vector<Result> results;
+    std::ifstream is(filename);
+    std::string line;
+    std::getline(is, line);
+    while (std::getline(is, line)) {
+        std::stringstream ss(line);
+        Result r;
+        std::string field;
+        std::getline(ss, r.name, ',');
+        std::getline(ss, field, ',');
+        r.median = atof(field.c_str());
+        std::getline(ss, field, ',');
+        r.mad = atof(field.c_str());
+        results.push_back(r);
+    }
+    return results;
+}
+
+void writeCSV(std::string const& filename, std::vector<Result> const& results)
+{
+    std::ofstream os(filename);
+    os << "name,ns_per_op_median,ns_per_op_mad,ns_per_op_min,ns_per_op_mean,ns_per_op_stddev,ops_per_batch,batches\n";
+    for (auto& r : results) {
+        char buf[256];
+        snprintf(buf, sizeof(buf), ",%.4f,%.4f,%.4f,%.4f,%.4f,%lld,%d\n",
+            r.median, r.mad, r.min, r.mean, r.stddev, (long long)r.batch, r.samples);
+        os << r.name << buf;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string out = "benchmarks.csv";
+    std::string baseline;
+    int samples = 15;
+    bool check = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out = argv[++i];
+        } else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (!strcmp(argv[i], "--quick")) {
+            samples = 5;
+        } else if (!strcmp(argv[i], "--check")) {
+            check = true;
+        } else {
+            filter = argv[i];
+        }
+    }
+    if (check) {
+        int failed = checkQuadricKernels();
+        failed += checkScreenOrigin();
+        return failed ? 1 : 0;
+    }
+
+    std::vector<Result> results;
+    auto bench = [&](std::string const& name, auto op) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return;
+        }
+        Result r = measure(name, samples, op);
+        printf("%-40s %12.2f ns/op  mad %8.2f  min %12.2f\n",
+            r.name.c_str(), r.median, r.mad, r.min);
+        fflush(stdout);
+        results.push_back(r);
+    };
+
+    size_t const kPool = 4096;
+    std::vector<Ray> rays = makeRays(kPool);
+    std::vector<Vec3> normals = makeNormals(kPool);
+    auto ray = [&](int64_t i) -> Ray const& { return rays[i & (kPool - 1)]; };
+    auto normal = [&](int64_t i) -> Vec3 const& { return normals[i & (kPool - 1)]; };
+
+    // intersections
+    auto sphere = quadricSurface(pars::shape = ShapeType::Shpere,
+        pars::origin = Vec3{ 0.1, -0.2, 0.3 }, pars::radius = 1.);
+    auto tube = quadricSurface(pars::shape = ShapeType::Tube,
+        pars::origin = Vec3{ 0, 0, 0 }, pars::direction = Vec3{ 0.2, 1, 0.3 }, pars::radius = 0.5);
+    auto plane = planeSurface(pars::origin = Vec3{ 0, 0, 0 }, pars::direction = Vec3{ 0.1, 0.2, 1 });
+    auto box = unitBox();
+
+    auto distance = [&](Device const& dev) {
+        return [&](int64_t i) {
+            DistanceHandler h;
+            dev.process(ray(i), h);
+            return std::isinf(h.fDistance) ? 0. : h.fDistance;
+        };
+    };
+    auto tracing = [&](Device const& dev) {
+        return [&](int64_t i) {
+            TracingHandler h;
+            dev.process(ray(i), h);
+            return h.hit ? h.inter.fX : 0.;
+        };
+    };
+    bench("QuadricSurface::process/sphere/distance", distance(*sphere));
+    bench("QuadricSurface::process/sphere/tracing", tracing(*sphere));
+    bench("QuadricSurface::process/tube/distance", distance(*tube));
+    bench("PlaneSurface::process/distance", distance(*plane));
+    bench("PlaneSurface::process/tracing", tracing(*plane));
+    bench("Convex::process/box/distance", distance(*box));
+    bench("Convex::process/box/tracing", tracing(*box));
+
+    for (int n : { 16, 256, 4096 }) {
+        auto engine = sphereScene(n);
+        DeviceSet devs(engine->getDevices());
+        bench("minSDevice/" + std::to_string(n), [&](int64_t i) {
+            Real s;
+            Device* dev = devs.nearest(ray(i), s);
+            return dev ? s : 0.;
+        });
+    }
+
+    // sampling
+    bench("randomNorm", [&](int64_t i) {
+        return randomNorm(normal(i)).fX;
+    });
+    bench("randomDiffuseRay", [&](int64_t i) {
+        return randomDiffuseRay(normal(i)).fX;
+    });
+    // the ray must come from the side of the normal, n as used by the engine
+    std::vector<Vec3> facing(kPool);
+    for (size_t i = 0; i < kPool; ++i) {
+        facing[i] = dot(rays[i].fD, normals[i]) < 0 ? normals[i] : -normals[i];
+    }
+    bench("randomMetalRay", [&](int64_t i) {
+        return randomMetalRay(ray(i).fD, facing[i & (kPool - 1)], 0.15).fX;
+    });
+    PlankLaw plank(5800);
+    bench("PlankLaw::sample", [&](int64_t) {
+        return plank.sample();
+    });
+    auto stop = planeStop(pars::origin = Vec3{ 0, 0, 5 },
+        pars::n1Min = -0.5, pars::n1Max = 0.5,
+        pars::n2Min = -0.5, pars::n2Max = 0.5);
+    stop->fN1 = Vec3{ 1, 0, 0 };
+    stop->fN2 = Vec3{ 0, 1, 0 };
+    bench("PlaneStop::sample(ref)", [&](int64_t i) {
+        return stop->sample(ray(i).fO).fX;
+    });
+    // a point source, and a round aperture of a tenth of the stop
+    Vec3 pointSource = { 0.2, 0.1, -1 };
+    bench("PlaneStop::sample(ref)/fixed", [&](int64_t) {
+        return stop->sample(pointSource).fX;
+    });
+    auto aperture = planeStop(pars::origin = Vec3{ 0, 0, 5 },
+        pars::n1 = Vec3{ 1, 0, 0 }, pars::n2 = Vec3{ 0, 1, 0 },
+        pars::n1Min = -0.5, pars::n1Max = 0.5,
+        pars::n2Min = -0.5, pars::n2Max = 0.5,
+        pars::bound = quadricBound(pars::shape = ShapeType::Tube,
+            pars::origin = Vec3{ 0.1, 0, 0 }, pars::direction = Vec3{ 0, 0, 1 },
+            pars::radius = 0.18));
+    bench("PlaneStop::sample(ref)/disk", [&](int64_t i) {
+        return aperture->sample(ray(i).fO).fX;
+    });
+    for (int n : { 4, 256, 4096 }) {
+        // powers over 3 decades, as leds next to lamps
+        std::vector<PowerSource> powers;
+        std::vector<Source*> srcs;
+        for (int k = 0; k < n; ++k) {
+            powers.emplace_back(pow(10., uniform(0, 3)));
+        }
+        for (auto& s : powers) {
+            srcs.push_back(&s);
+        }
+        SourceSelecter selecter;
+        selecter.initialize(srcs);
+        bench("SourceSelecter::getSource/" + std::to_string(n), [&](int64_t) {
+            return selecter.getSource()->fAmp;
+        });
+    }
+
+    // color
+    bench("WaveLength2RGB", [&](int64_t i) {
+        double r, g, b;
+        WaveLength2RGB(380. + (i & 511) * (400. / 512), &r, &g, &b);
+        return r + g + b;
+    });
+    Bitmap bitmap = testBitmap(256, 256);
+    for (auto iff : { ImageFileFormat::PNG, ImageFileFormat::PPM, ImageFileFormat::PFM }) {
+        char const* names[] = { "png", "ppm", "pfm", "exr" };
+        bench(std::string("Bitmap::write/256x256/") + names[(int)iff], [&](int64_t) {
+            std::ostringstream os;
+            bitmap.write(os, iff);
+            return double(os.tellp());
+        });
+    }
+
+    writeCSV(out, results);
+    printf("written %s\n", out.c_str());
+
+    if (baseline.empty()) {
+        return 0;
+    }
+    std::map<std::string, Result> base;
+    for (auto& r : readCSV(baseline)) {
+        base[r.name] = r;
+    }
+    int regressions = 0;
+    for (auto& r : results) {
+        auto it = base.find(r.name);
+        if (it == base.end()) {
+            continue;
+        }
+        Result const& b = it->second;
+        double noise = 3 * std::max(r.mad, b.mad);
+        if (r.median > 1.1 * b.median && r.median - b.median > noise) {
+            printf("regression %-40s %12.2f -> %12.2f ns/op (%+.1f%%)\n", r.name.c_str(),
+                b.median, r.median, 100 * (r.median / b.median - 1));
+            ++regressions;
+        }
+    }
+    printf("%d regressions against %s\n", regressions, baseline.c_str());
+    return regressions ? 1 : 0;
+}
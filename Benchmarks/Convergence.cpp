@@ -0,0 +1,174 @@
+#include "../Examples/Scenes.h"
+using namespace srt;
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// error versus time of the sampling strategies of eye().
+//
+// usage: Convergence [scene] [--quality fast|good|best] [--strategy filter]
+//            [--seconds s] [--spp n] [--seed n] [--references dir]
+//            [--reference-mult m] [--out file.csv]
+//
+// a strategy renders the scene in passes of n, 2n, 4n, ... samples per pixel,
+// each with its own seed, and accumulates them until s seconds of rendering
+// are spent. after each pass the relative rmse (see relativeRMSE) of the
+// accumulated image against the reference is written, so two strategies are
+// compared at equal time by reading their curves at the same seconds.
+// the reference is <dir>/<scene>_<quality>.pfm as written by SceneBenchmarks
+// --make-references, if it is missing it's rendered by the default strategy
+// with m (default 64) times the samples of the quality.
+// the random engine is chosen at build time, build with -DSRT_CPPSTD to
+// compare it, the rng column tells which one made the curve.
+
+struct Strategy {
+    std::string name;
+    PictureOpts opts;
+};
+
+std::vector<Strategy> strategies()
+{
+    std::vector<Strategy> ss;
+    ss.push_back({ "default", PictureOpts() });
+    ss.push_back({ "lambda_stratified", PictureOpts(pars::lambdaSampling = WaveLengthSampling::Stratified) });
+    ss.push_back({ "split_4", PictureOpts(pars::firstLevelSplit = 4) });
+    ss.push_back({ "min_amp_1e-3", PictureOpts(pars::minRayAmp = 1E-3) });
+    ss.push_back({ "min_amp_1e-9", PictureOpts(pars::minRayAmp = 1E-9) });
+    return ss;
+}
+
+char const* const kQualityNames[] = { "fast", "good", "best" };
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string strategyFilter;
+    std::string out = "convergence.csv";
+    std::string references = "references";
+    int quality = kFAST;
+    uint32_t seed = 1;
+    double budget = 10;
+    int spp = 4;
+    int refMult = 64;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out = argv[++i];
+        } else if (!strcmp(argv[i], "--references") && i + 1 < argc) {
+            references = argv[++i];
+        } else if (!strcmp(argv[i], "--strategy") && i + 1 < argc) {
+            strategyFilter = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            budget = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--spp") && i + 1 < argc) {
+            spp = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--reference-mult") && i + 1 < argc) {
+            refMult = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--quality") && i + 1 < argc) {
+            ++i;
+            quality = -1;
+            for (int q = kFAST; q <= kBEST; ++q) {
+                if (!strcmp(argv[i], kQualityNames[q])) {
+                    quality = q;
+                }
+            }
+            if (quality < 0) {
+                fprintf(stderr, "unknown quality: %s\n", argv[i]);
+                return 2;
+            }
+        } else {
+            filter = argv[i];
+        }
+    }
+    if (spp < 1 || refMult < 1) {
+        fprintf(stderr, "--spp and --reference-mult must be positive\n");
+        return 2;
+    }
+
+    std::ofstream os(out);
+    os << "scene,quality,rng,strategy,pass,spp,seconds,rays,rmse\n";
+
+    using clock = std::chrono::steady_clock;
+    for (BenchScene const& scene : benchScenes()) {
+        if (!scene.eye
+            || (!filter.empty() && scene.name.find(filter) == std::string::npos)) {
+            continue;
+        }
+        SceneQuality q = scene.quality[quality];
+
+        std::string refPath = references + "/" + scene.name + "_"
+            + kQualityNames[quality] + ".pfm";
+        Bitmap ref;
+        if (std::filesystem::exists(refPath)) {
+            ref.read(refPath);
+        } else {
+            SceneQuality rq = q;
+            rq.samples *= refMult;
+            TraceStats stats;
+            printf("%s: rendering the reference, %d samples\n",
+                scene.name.c_str(), rq.samples);
+            fflush(stdout);
+            ref = scene.render(rq, PictureOpts(pars::seed = ~seed), stats, nullptr);
+            std::filesystem::create_directories(references);
+            ref.write(refPath);
+        }
+
+        for (Strategy const& strategy : strategies()) {
+            if (!strategyFilter.empty()
+                && strategy.name.find(strategyFilter) == std::string::npos) {
+                continue;
+            }
+
+            std::vector<Color> sum;
+            Bitmap mean;
+            int64_t totalSpp = 0;
+            uint64_t rays = 0;
+            double seconds = 0;
+            for (int pass = 0; seconds < budget; ++pass) {
+                SceneQuality pq = q;
+                pq.samples = spp << pass;
+                PictureOpts opts = strategy.opts;
+                opts.Seed = seed + pass;
+                TraceStats stats;
+
+                auto t0 = clock::now();
+                Bitmap bmp = scene.render(pq, opts, stats, nullptr);
+                auto t1 = clock::now();
+                seconds += std::chrono::duration<double>(t1 - t0).count();
+
+                // eye() gives the mean of the pass, weight it by its samples
+                if (sum.empty()) {
+                    sum.assign(bmp.fC.size(), Color::black(0.));
+                    mean = bmp;
+                }
+                for (size_t i = 0; i < sum.size(); ++i) {
+                    sum[i] += bmp.fC[i] * (Real)pq.samples;
+                }
+                totalSpp += pq.samples;
+                rays += stats.fRays;
+                for (size_t i = 0; i < sum.size(); ++i) {
+                    mean.fC[i] = sum[i] * (1. / totalSpp);
+                }
+
+                double rmse = relativeRMSE(mean, ref);
+                printf("%-20s %-18s pass %2d  spp %8lld  %9.3fs  rmse %.5f\n",
+                    scene.name.c_str(), strategy.name.c_str(), pass,
+                    (long long)totalSpp, seconds, rmse);
+                fflush(stdout);
+                os << scene.name << "," << kQualityNames[quality] << ","
+                    << randomEngineName() << "," << strategy.name << ","
+                    << pass << "," << totalSpp << "," << seconds << ","
+                    << rays << "," << rmse << "\n";
+                os.flush();
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "../Examples/Scenes.h"
+using namespace srt;
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// end to end benchmark of the example scenes.
+//
+// usage: SceneBenchmarks [filter] [--quality fast|good|best] [--seed n]
+//            [--references dir] [--make-references [mult]] [--out file.csv]
+//            [--stats] [--profile dir]
+//
+// a scene is rendered with a fixed seed, so two runs of the same build give
+// the same image. the time, rays/s, intersection tests/s and the mean path
+// length are reported. if <dir>/<scene>_<quality>.pfm exists the relative
+// rmse against it is reported too, see relativeRMSE.
+// --make-references renders the references with mult (default 64) times the
+// samples and another seed, and writes them into the references dir.
+// --stats prints the ray levels, the ends of the rays and the time of the
+// reflection branches of each scene (see TraceStats).
+// --profile prints the time spent in each device and the cost of the pixels
+// of the camera scenes, and writes <dir>/<scene>_<quality>_heat.png, the
+// time of the pixels from black (cheap) to white (expensive). the source
+// scenes can't be profiled, a note says so.
+
+struct SceneResult {
+    std::string scene;
+    std::string quality;
+    double seconds = 0;
+    TraceStats stats;
+    double rmse = -1;
+};
+
+char const* const kQualityNames[] = { "fast", "good", "best" };
+char const* const kReflectTypeNames[] = { "diffuse", "metal", "mirror", "optical", "rayleigh" };
+
+void printStats(TraceStats const& s)
+{
+    double rays = s.fRays ? (double)s.fRays : 1.;
+    printf("    tests/ray %.2f  escaped %.3f  died %.3f  cut %.3f  tir %.3f (of rays)\n",
+        s.testsPerRay(), s.fEscaped / rays, s.fDied / rays, s.fCut / rays,
+        s.fTotalInternalReflections / rays);
+    printf("    rays of level:");
+    for (int i = 0; i < TraceStats::kLevels; ++i) {
+        if (s.fRaysOfLevel[i]) {
+            printf(" %d:%llu", i, (unsigned long long)s.fRaysOfLevel[i]);
+        }
+    }
+    printf("\n    paths deeper than 5/10/20: %.3f %.3f %.3f\n",
+        s.pathsDeeperThan(5), s.pathsDeeperThan(10), s.pathsDeeperThan(20));
+    printf("    reflection time:");
+    for (int i = 0; i < TraceStats::kReflectTypes; ++i) {
+        if (s.fReflectHits[i]) {
+            printf(" %s %.1f%% (%llu hits)", kReflectTypeNames[i],
+                100 * s.reflectTimeShare((ReflectType)i),
+                (unsigned long long)s.fReflectHits[i]);
+        }
+    }
+    printf("\n");
+}
+
+void writeCSV(std::string const& path, std::vector<SceneResult> const& results)
+{
+    std::ofstream os(path);
+    os << "scene,quality,seconds,primary_rays,rays,intersection_tests,"
+        "rays_per_s,intersections_per_s,path_length,rmse\n";
+    for (auto const& r : results) {
+        os << r.scene << "," << r.quality << "," << r.seconds << ","
+            << r.stats.fPrimaryRays << "," << r.stats.fRays << ","
+            << r.stats.fIntersectionTests << ","
+            << r.stats.fRays / r.seconds << ","
+            << r.stats.fIntersectionTests / r.seconds << ","
+            << r.stats.pathLength() << ",";
+        if (r.rmse >= 0) {
+            os << r.rmse;
+        }
+        os << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string out = "scene_benchmarks.csv";
+    std::string references = "references";
+    int quality = kFAST;
+    uint32_t seed = 1;
+    int makeReferences = 0;
+    bool stats = false;
+    std::string profileDir;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            out = argv[++i];
+        } else if (!strcmp(argv[i], "--references") && i + 1 < argc) {
+            references = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--quality") && i + 1 < argc) {
+            ++i;
+            quality = -1;
+            for (int q = kFAST; q <= kBEST; ++q) {
+                if (!strcmp(argv[i], kQualityNames[q])) {
+                    quality = q;
+                }
+            }
+            if (quality < 0) {
+                fprintf(stderr, "unknown quality: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (!strcmp(argv[i], "--stats")) {
+            stats = true;
+        } else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+            profileDir = argv[++i];
+        } else if (!strcmp(argv[i], "--make-references")) {
+            makeReferences = 64;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                makeReferences = atoi(argv[++i]);
+            }
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    if (makeReferences) {
+        std::filesystem::create_directories(references);
+    }
+    if (!profileDir.empty()) {
+        std::filesystem::create_directories(profileDir);
+    }
+
+    std::vector<SceneResult> results;
+    for (BenchScene const& scene : benchScenes()) {
+        if (!filter.empty() && scene.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        SceneQuality q = scene.quality[quality];
+        std::string ref = references + "/" + scene.name + "_"
+            + kQualityNames[quality] + ".pfm";
+
+        if (makeReferences) {
+            q.samples *= makeReferences;
+        }
+
+        SceneResult r;
+        r.scene = scene.name;
+        r.quality = kQualityNames[quality];
+        using clock = std::chrono::steady_clock;
+        RenderProfile profile;
+        bool profiling = !profileDir.empty() && scene.eye;
+        auto t0 = clock::now();
+        // the reference must not share the noise of the measured image
+        Bitmap bmp = scene.render(q,
+            PictureOpts(pars::seed = makeReferences ? ~seed : seed), r.stats,
+            profiling ? &profile : nullptr);
+        auto t1 = clock::now();
+        r.seconds = std::chrono::duration<double>(t1 - t0).count();
+
+        if (makeReferences) {
+            bmp.write(ref);
+        } else if (std::filesystem::exists(ref)) {
+            Bitmap refBmp;
+            refBmp.read(ref);
+            r.rmse = relativeRMSE(bmp, refBmp);
+        }
+
+        printf("%-20s %-5s %9.3fs %12.0f rays/s %12.0f tests/s  path %6.3f",
+            r.scene.c_str(), r.quality.c_str(), r.seconds,
+            r.stats.fRays / r.seconds,
+            r.stats.fIntersectionTests / r.seconds,
+            r.stats.pathLength());
+        if (r.rmse >= 0) {
+            printf("  rmse %.5f", r.rmse);
+        }
+        printf("\n");
+        if (stats) {
+            printStats(r.stats);
+        }
+        if (!profileDir.empty() && !scene.eye) {
+            printf("no profile: %s is a source scene, emit() isn't profiled\n",
+                r.scene.c_str());
+        }
+        if (profiling) {
+            printf("%s", profile.report().c_str());
+            RenderProfile::heatmap(profile.fTicks).write(profileDir + "/"
+                + r.scene + "_" + r.quality + "_heat.png");
+        }
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    writeCSV(out, results);
+    return 0;
+}
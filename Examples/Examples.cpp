@@ -1,4 +1,4 @@
-#include "../srt/srt.h"
+#include "Scenes.h"
 using namespace srt;
 
 #include <memory>
@@ -8,29 +8,6 @@ using namespace srt;
 #include <filesystem>
 
 
-int const kFAST = 0;
-int const kGOOD = 1;
-int const kBEST = 2;
-
-// width=height=depth=1
-std::shared_ptr<Surface> boxSurface() {
-    auto cc = convex({});
-    for (Real i = -1; i <= 1; ++i) {
-        for (Real j = -1; j <= 1; ++j) {
-            for (Real k = -1; k <= 1; ++k) {
-                if (fabs(i) + fabs(j) + fabs(k) == 1) {
-                    auto s1 = planeSurface(
-                        pars::origin = Vec3{ 0.5 * i, 0.5 * j, 1. + 0.5 * k },
-                        pars::direction = Vec3{ i,j, k },
-                        pars::pictureColor = Color::white(1.));
-                    cc->addSurface(s1);
-                }
-            }
-        }
-    }
-    return cc;
-}
-
 void testParabola()
 {
 
@@ -158,99 +135,11 @@ void testParabola()
     ));
 }
 
-void addRoom(Engine &en)
-{
-
-	auto light = planeSurface(
-		pars::origin = Vec3{ 0,0,5 - 1E-4 },
-		pars::direction = Vec3{ 0,0,1 },
-		pars::name = "light");
-
-    auto w1 = planeSurface(
-        pars::origin = Vec3{ -2,0,0 },
-        pars::direction = Vec3{ -1,0,0 },
-        pars::name = "back");
-    auto w2 = planeSurface(
-        pars::origin = Vec3{ 0,-5,0 },
-        pars::direction = Vec3{ 0,-1,0 },
-        pars::name = "left");
-    auto w3 = planeSurface(
-        pars::origin = Vec3{ 0,+5,0 },
-        pars::direction = Vec3{ 0,+1,0 },
-        pars::name = "right");
-    auto w4 = planeSurface(
-        pars::origin = Vec3{ 0,0,5 },
-        pars::direction = Vec3{ 0,0,-1 },
-        pars::name = "roof");
-    auto w5 = planeSurface(
-        pars::origin = Vec3{ 0,0,0 },
-        pars::direction = Vec3{ 0,0,1 },
-        pars::name = "floor");
-
-    for (auto& wall : { w1, w2, w3, w4, w5 }) {
-        wall->setTrans(0);
-        wall->setGridTexture(1);
-        wall->setReflectType(ReflectType::Diffuse);
-    }
-
-    {
-        light->setBound(boxBound(
-            pars::x0 = -3,
-            pars::x1 = 3,
-            pars::y0 = -3,
-            pars::y1 = 3));
-    }
-
-    light->setName("light");
-    light->setBrightness(1);
-    light->setTrans(0.);
-    light->setReflect(0.);
-    light->setInnerReflectType(ReflectType::Mirror);
-    light->setOuterReflectType(ReflectType::Mirror);
-
-    en.addDevice(std::move(w1));
-    en.addDevice(std::move(w2));
-    en.addDevice(std::move(w3));
-    en.addDevice(std::move(w4));
-    en.addDevice(std::move(w5));
-    en.addDevice(std::move(light));
-
-}
 
 void Glass(int q)
 {
     Engine en;
-    {
-
-        auto qs3 = quadricSurface(
-            pars::shape = ShapeType::Tube,
-            pars::origin = Vec3{ 0, 0, 0 },
-            pars::direction = Vec3{ 0,0,1 },
-            pars::radius = 1.,
-            pars::name = "barrel",
-            pars::pictureColor = Color::red(0.5),
-            pars::reflectType = ReflectType::Optical,
-            pars::innerIndex = 1.5);
-
-        auto ec1 = planeSurface(
-            pars::origin = Vec3{ 0,0,1.5 },
-            pars::direction = Vec3{ 0,0,1 },
-            pars::name = "top",
-            pars::pictureColor = Color::blue(0.5),
-            pars::reflectType = ReflectType::Optical,
-            pars::innerIndex = 1.5);
-
-        auto ec2 = planeSurface(
-            pars::origin = Vec3{ 0,0,0 },
-            pars::direction = Vec3{ 0,0,-1 },
-            pars::name = "bottom",
-            pars::pictureColor = Color::blue(0.5),
-            pars::reflectType = ReflectType::Optical,
-            pars::innerIndex = 1.5);
-
-        en.addDevice(convex({ ec1, ec2, qs3 }));
-    }
-
+    addGlass(en);
     addRoom(en);
 
     {
@@ -308,6 +197,30 @@ void Glass(int q)
     }
 
 }
+
+// the quality is whatever fits in the seconds
+void GlassInTime(Real seconds)
+{
+    Engine en;
+    addGlass(en);
+    addRoom(en);
+
+    Bitmap bmp = en.eyeProgressive(PictureOpts(
+        pars::mult = true,
+        pars::origin = Vec3{ 10,0, 3 },
+        pars::lookAt = Vec3{ 0,0,2 },
+        pars::fieldOfView = 1.2,
+        pars::width = 500,
+        pars::high = 500,
+        pars::samplePerPixel = 10,
+        pars::timeBudget = seconds,
+        pars::onPass = [](Bitmap const&, int spp) {
+            printf("%d samples per pixel\n", spp);
+        }));
+    bmp.cnormalize();
+    bmp.write("output/tube_raytrace_in_time.png");
+}
+
 void testBoxSurface(int q) {
     Engine en;
     addRoom(en);
@@ -362,55 +275,9 @@ void testBoxSurface(int q) {
 
 void testSphere(int q)
 {
-
-    auto qs1 = quadricSurface(
-        pars::name = "qs1",
-        pars::shape = ShapeType::Shpere,
-        pars::origin = Vec3{ 0, -3.6, 1 },
-        pars::radius = 1.,
-        pars::pictureColor = Color::red(1.),
-        pars::reflectType = ReflectType::Diffuse);
-    qs1->setOuterReflect(gaussSpectrum(1., WaveLengthRed, 25));
-
-    auto qs2 = quadricSurface(
-        pars::name = "qs2",
-        pars::shape = ShapeType::Shpere,
-        pars::origin = Vec3{ 0, -1.2, 1 },
-        pars::radius = 1.,
-        pars::pictureColor = Color::red(1.),
-        pars::reflectType = ReflectType::Mirror,
-        pars::reflectRatio = 1.,
-        pars::refractRatio = 0.
-    );
-
-    auto qs3 = quadricSurface(
-        pars::name = "qs3",
-        pars::shape = ShapeType::Shpere,
-        pars::origin = Vec3{ 0, 1.2, 1 },
-        pars::radius = 1.,
-        pars::pictureColor = Color::red(1.),
-        pars::reflectType = ReflectType::Optical,
-        pars::innerIndex = 1.5
-    );
-
-    auto qs4 = quadricSurface(
-        pars::name = "qs4",
-        pars::shape = ShapeType::Shpere,
-        pars::origin = Vec3{ 0, 3.6, 1 },
-        pars::radius = 1.,
-        pars::pictureColor = Color::red(1.),
-        pars::reflectType = ReflectType::Metal,
-        pars::reflectRatio = 1.,
-        pars::refractRatio = 0.
-    );
-
     Engine en;
     addRoom(en);
-
-    en.addDevice(qs1);
-    en.addDevice(qs2);
-    en.addDevice(qs3);
-    en.addDevice(qs4);
+    addFourSpheres(en);
 
     {
         PictureOpts opts(
@@ -501,179 +368,15 @@ void testSphereRefract()
 
 }
 
-void addTelescopeToEngin(Engine& en)
-{
-    Real trans = 0.5;
-    Real mainMirrorRadius = 1.5;
-    Real shellRadius = 0.2;
-    Real shellLength = 1;
-    Real holdZ = 0.5;
-
-    auto shellBox = boxBound(pars::z0 = 0, pars::z1 = shellLength);
-    auto shellhole = boxBound(
-        pars::x0 = 0, pars::x1 = 1,
-        pars::y0 = -0.05, pars::y1 = 0.05,
-        pars::z0 = holdZ - 0.05, pars::z1 = holdZ + 0.05
-    );
-
-    auto shellBound = all({ shellBox, inverse(shellhole) });
-
-    auto shell = quadricSurface(
-        pars::name = "shell",
-        pars::shape = ShapeType::Tube,
-        pars::origin = Vec3{ 0,0,0 },
-        pars::direction = Vec3{ 0,0,1 },
-        pars::radius = shellRadius,
-        pars::reflectRatio = 0.5,
-        pars::innerReflectType = ReflectType::Diffuse,
-        pars::outerReflectType = ReflectType::Diffuse,
-        pars::bound = shellBound
-        );
-
-    Real zOff = shellRadius * shellRadius / (2 * mainMirrorRadius);
-
-    auto undersea = planeBound(
-        pars::origin = Vec3{ 0,0,0 },
-        pars::direction = Vec3{ 0,0,1 });
-
-    auto mainMirror = quadricSurface(
-        pars::name = "mainMirror",
-        pars::shape = ShapeType::Parabola,
-        pars::direction = Vec3{ 0,0,1 },
-        pars::origin = Vec3{ 0,0, -zOff },
-        pars::radius = mainMirrorRadius,
-        pars::innerReflectType = ReflectType::Mirror,
-        pars::outerReflectType = ReflectType::Diffuse,
-        pars::bound = undersea
-        );
-
-    auto secondMirrorBound = boxBound(pars::x0 = -0.05,
-        pars::x1 = 0.05,
-        pars::y0 = -0.05,
-        pars::y1 = 0.05);
-
-    auto secondMirror = std::make_shared<PlaneSurface>(
-        pars::name = "secondMirror",
-        pars::innerReflectType = ReflectType::Diffuse,
-        pars::innerReflectRatio = 0.0,
-        pars::outerReflectType = ReflectType::Mirror,
-        pars::outerReflectRatio= 1.0,
-        pars::origin = Vec3{ 0,0, 0.5 },
-        pars::direction = Vec3{ 1, 0, -1 },
-        pars::bound = secondMirrorBound
-        );
-
-    auto floor = std::make_shared<PlaneSurface>(
-        pars::origin = Vec3{ 0,0,-1 },
-        pars::direction = Vec3{ 0,0,1 },
-        pars::name = "floor",
-        pars::reflectRatio = 0.5,
-        pars::innerReflectType = ReflectType::Diffuse,
-        pars::outerReflectType = ReflectType::Diffuse);
-
-    Real scnX = mainMirrorRadius / 2 - zOff - holdZ;
-
-    auto scn = std::make_shared<PlaneScreen>(
-        pars::name = "screen",
-        pars::origin = Vec3{ scnX, 0, holdZ },
-        pars::direction = Vec3{ -1, 0, 0 },
-        pars::bound = boxBound(
-            pars::y0 = -0.03,
-            pars::y1 = +0.03,
-            pars::z0 = holdZ - 0.03,
-            pars::z1 = holdZ + 0.03),
-        pars::reflectRatio = 0.,
-        pars::refractRatio = 0.
-        );
-
-
-    mainMirror->setInnerPictureColor(Color::red());
-    mainMirror->setOuterPictureColor(Color::green());
-    secondMirror->setInnerPictureColor(Color::red());
-    secondMirror->setOuterPictureColor(Color::red());
-    shell->setPictureColor(Color::white(trans));
-    scn->setPictureColor(Color::green());
-    secondMirror->setPictureColor(Color::green());
-    secondMirror->setPictureAlpha(1.0);
-    secondMirror->setInnerPictureAlpha(0);
-
-    en.addDevice(std::move(shell));
-    en.addDevice(std::move(floor));
-    en.addDevice(std::move(mainMirror));
-    en.addDevice(std::move(secondMirror));
-    en.addDevice(std::move(scn));
-}
 
 void newtainTelescope(int q)
 {
-
-    auto cirule = quadricBound(
-        pars::shape = ShapeType::Tube,
-        pars::origin = Vec3{ 0,0,0 },
-        pars::direction = Vec3{ 0,0,1 },
-        pars::radius = 0.2);
-
-    auto psStop = planeStop(
-        pars::origin = Vec3{ 0,0,1 },
-        pars::n1 = Vec3{ 1,0,0 },
-        pars::n2 = Vec3{ 0,1,0 },
-        pars::n1Min = -0.2,
-        pars::n1Max = +0.2,
-        pars::n2Min = -0.2,
-        pars::n2Max = +0.2,
-        pars::bound = cirule);
-
-
-    Real objectZ = 1E7;
-    Real w = 100;
-    auto pps = planePositionSampler();
-    {
-
-
-        pps->setNorms({ 1,0,0 }, { 0,1,0 });
-        pps->setNorm1Bounds(-w / sqrt(3) / 2, w / sqrt(3));
-        pps->setNorm2Bounds(-w / 2, w / 2);
-        pps->setOrigin({ 0,0, objectZ });
-
-        Vec3 z{ 0,0,1 };
-        Vec3 p1{ 1 / sqrt(3), 0, 0 };
-        Vec3 p2{ -0.5 / sqrt(3), -0.5, 0 };
-        Vec3 p3{ -0.5 / sqrt(3), +0.5, 0 };
-        p1 = p1 * w;
-        p2 = p2 * w;
-        p3 = p3 * w;
-
-        auto t1 = planeBound();
-        auto t2 = planeBound();
-        auto t3 = planeBound();
-        t1->setOP(p1, cross(z, p2 - p1));
-        t2->setOP(p2, cross(z, p3 - p2));
-        t3->setOP(p3, cross(z, p1 - p3));
-        auto triangle = all({ t1, t2, t3 });
-
-        pps->setBound(triangle);
-    };
-
-    auto src = comSource(1.,
-        monoSpectrum(0),
-        pps,
-        stopDirectionSampler(psStop,
-            cosineDirectionSampler())
-    );
-
-    auto light_scn = planeScreen(
-        pars::origin = Vec3{ 0,0,objectZ - 0.1 },
-        pars::direction = Vec3{ 0,0,1 },
-        pars::name = "light_scn",
-        pars::reflectRatio = 0.,
-        pars::refractRatio = 1.,
-        pars::reflectType = ReflectType::Mirror,
-        pars::recordIn2Out = false);
+    Real objectZ = kTelescopeObjectZ;
+    Real w = kTelescopeObjectSize;
 
     Engine en;
     addTelescopeToEngin(en);
-    en.addSource(src);
-    en.addDevice(light_scn);
+    auto light_scn = addTelescopeObject(en);
     en.emit(1*10000);
     
     {
@@ -692,16 +395,7 @@ void newtainTelescope(int q)
         Bitmap screenPictrue;
         Screen* scn = dynamic_cast<PlaneScreen*>(en.findDevice("screen"));
 
-        scn->raster(screenPictrue,
-            ScreenOpts(
-                pars::gray = true,
-                pars::high = 200,
-                pars::width = 200,
-                pars::n1 = Vec3{ 0,1,0 },
-                pars::n2 = Vec3{ 0,0,1 },
-                pars::origin = Vec3{ 0,0,0.5 },
-                pars::screenSize = w / objectZ
-            ));
+        scn->raster(screenPictrue, telescopeScreenOpts(200, 200));
 
         devicesPictrue.draw(screenPictrue, 0, 200, 400, 600);
         devicesPictrue.draw("screen", 
@@ -997,75 +691,7 @@ void dispersivePrism(int s)
 {
     Real dist = 20;
     Engine en;
-
-    auto build_triangle = [](){
-
-        auto p1 = planeSurface(
-            pars::origin = Vec3{ 0,0,1 },
-            pars::direction = normalize(Vec3{ 0,1,0.1 }),
-            pars::pictureColor = Color::white(0.1));
-
-        auto p2 = planeSurface(
-            pars::origin = Vec3{ 0,0,1 },
-            pars::direction = normalize(Vec3{ 0,-1,0.1 }),
-            pars::reflectType = ReflectType::Mirror,
-            pars::pictureColor = Color::white(0.1));
-
-        auto p3 = planeSurface(
-            pars::origin = Vec3{ 0,0,-1 },
-            pars::direction = normalize(Vec3{ 0,0,-1 }),
-            pars::pictureColor = Color::white(0.1));
-
-        auto p4 = planeSurface(
-            pars::origin = Vec3{ 1,0,0 },
-            pars::direction = normalize(Vec3{ 1,0, 0 }),
-            pars::pictureColor = Color::red(0.9));
-
-        auto p5 = planeSurface(
-            pars::origin = Vec3{ -1,0,0 },
-            pars::direction = normalize(Vec3{ -1,0, 0, }),
-            pars::pictureColor = Color::red(0.9));
-
-        std::vector<std::shared_ptr<PlaneSurface>> planes
-            = { p1,p2,p3,p4,p5 };
-        for (auto& s : planes) {
-            s->set(
-                pars::innerPredefinedSellmeier3 = PredefinedSellmeier3::BK7,
-                pars::reflectType = ReflectType::Mirror,
-                pars::innerReflectRatio = 0,
-                pars::outerReflectRatio = 0,
-                pars::in2OutRefractRatio = 1.,
-                pars::out2InRefractRatio = 1.
-            );
-        }
-        return convex({ p1,p2,p3,p4,p5 });
-    };
-
-    auto tri = build_triangle();
-
-
-    auto scn = planeScreen(
-		pars::origin = Vec3{ 0,dist,0 },
-		pars::direction = Vec3{ 0,1,0 },
-		pars::bound = boxBound(pars::x0 = -1, pars::x1 = 1,
-			pars::z0 = -1, pars::z1 = 1),
-        pars::pictureColor = Color::white()
-    );
-
-    en.addDevice(tri);
-    en.addDevice(scn);
-
-    struct SampleInLine : PositionSampler {
-        Vec3 sample(Vec3& norm) override {
-			norm = Vec3{ 0,+1,0.06 }; // ray direction
-			return Vec3{ uniform(-0.01,0.01),-4,0 };
-        }
-    };
-    en.addSource(comSource(pars::amp = 1,
-		pars::spectrum = plankSpectrum(pars::temperature = 5000),
-		pars::positionSampler = std::make_shared<SampleInLine>(),
-		pars::directionSampler = uniformDirectionSampler(0)
-    ));
+    auto scn = addPrism(en);
 
     if (kFAST == s) {
         en.emit(1000);
@@ -1084,15 +710,7 @@ void dispersivePrism(int s)
         en.emit(10);
     }
     
-	scn->raster("output/prismColorSpectrum.png",
-		ScreenOpts(pars::width = 200,
-			pars::high = 200,
-			pars::n1 = Vec3{ 1,0,0 },
-			pars::n2 = Vec3{ 0,0,1 },
-			pars::n1Min = -0.02,
-			pars::n1Max = 0.02,
-			pars::n2Min = -0.7,
-			pars::n2Max = -0.6));
+	scn->raster("output/prismColorSpectrum.png", prismScreenOpts(200, 200));
 
 	auto bmp = en.devicesPicture(
 		PictureOpts(
@@ -1157,94 +775,12 @@ void source_distribution(int w)
 
 void blueSky(int q)
 {
-
-    constexpr Real atmosphereThick = 1;
-	auto earth = quadricSurface(
-		pars::name = "earth",
-        pars::shape = ShapeType::Shpere,
-		pars::origin = Vec3{ 0,0,-5 },
-		pars::radius = 5,
-		pars::out2InRefractRatio = 0.0,
-		pars::outerReflectRatio = 1.0,
-		pars::outerReflectType = ReflectType::Diffuse);
-
-
-
-    struct Atmosphere : Device
-    {
-
-        Real step = 0.2;
-        Real Length = 0.5;
-        std::shared_ptr<Surface> atmosphereTop;
-        SurfaceProperties scattering_property;
-        SurfaceProperties trans_property;
-
-        Atmosphere()
-        {
-            setName("air");
-            atmosphereTop = quadricSurface(
-                pars::name = "atmoTop",
-                pars::shape = ShapeType::Shpere,
-                pars::origin = Vec3{ 0,0,-5 },
-                pars::radius = 5 + atmosphereThick,
-                pars::in2OutRefractRatio = 1,
-                pars::out2InRefractRatio = 1,
-                pars::innerReflectRatio = 0,
-                pars::outerReflectRatio = 0,
-                pars::innerReflectType = ReflectType::Mirror,
-                pars::outerReflectType = ReflectType::Mirror);
-
-            scattering_property.fIn2OutReflect = 0.5;
-            scattering_property.fIn2OutTrans = 0.5;
-            scattering_property.fInnerReflectType = ReflectType::Rayleigh;
-            trans_property.fIn2OutReflect = 0;
-            trans_property.fIn2OutTrans = 1;
-            trans_property.fInnerReflectType = ReflectType::Mirror;
-        }
-
-        void process(Ray const& in, ProcessHandler& handler) const {
-
-                if (handler.fType == HandlerType::Distance) {
-                    if (atmosphereTop->isInner(in.fO)) {
-                        static_cast<DistanceHandler&>(handler).distance(step, true);
-                    } else {
-                        atmosphereTop->process(in, handler);
-                    }
-                } else if (handler.fType == HandlerType::Tracing) {
-                    if (atmosphereTop->isInner(in.fO)) {
-                        Real len = Length / Sqr(Sqr(500 / in.fLambda));
-                        if (uniform(0, 1) < step / len) {
-                            static_cast<TracingHandler&>(handler).hitSurface(
-                                in.fO + in.fD * step, in.fD,
-                                true, &scattering_property, this);
-                        } else {
-                            static_cast<TracingHandler&>(handler).hitSurface(
-                                in.fO + in.fD * step, in.fD,
-                                true, &trans_property, this);
-                        }
-                    } else {
-                        atmosphereTop->process(in, handler);
-                    }
-                }                       
-        }
-
-    };
-
     Engine en;
-
-	auto sun = quadricSurface(pars::shape = ShapeType::Shpere,
-        pars::outerReflectRatio = 0,
-		pars::origin = Vec3{ 10,0,0 },
-		pars::radius = 1,
-		pars::brightness = 1);
-
-    en.addDevice(earth);
-    en.addDevice(std::make_shared<Atmosphere>());
-    en.addDevice(sun);
+    auto sun = addSky(en);
     //en.addRecorder(logger());
 
 	for (Real l = 0.5; l <= 2; l *= 4) {
-        static_cast<Atmosphere*>(en.findDevice("air"))->Length = l;
+        setAirLength(en, l);
         {
             sun->set(
                 pars::shape = ShapeType::Shpere,
@@ -1361,15 +897,8 @@ void timeUniformNorm() {
 
 
 void testCone(int) {
-    
-    auto qs = quadricSurface(pars::shape = ShapeType::Cone,
-        pars::radius = 1.,
-        pars::direction = Vec3{0,0,1},
-        pars::top_height = 2,
-        pars::top_radius = 0.5);
-
     Engine en;
-    en.addDevice(qs);
+    addCone(en);
     addRoom(en);
 
     PictureOpts opts(
@@ -1425,6 +954,7 @@ void real_main()
     run(source_distribution(1));
     run(dispersivePrism(kFAST));
     run(Glass(kFAST));
+    run(GlassInTime(10));
     run(blueSky(kGOOD));
     run(BoundDiagram());
     run(testSphereRefract());
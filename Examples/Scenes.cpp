@@ -0,0 +1,667 @@
+#include "Scenes.h"
+using namespace srt;
+
+// width=height=depth=1
+std::shared_ptr<Surface> boxSurface() {
+    auto cc = convex({});
+    for (Real i = -1; i <= 1; ++i) {
+        for (Real j = -1; j <= 1; ++j) {
+            for (Real k = -1; k <= 1; ++k) {
+                if (fabs(i) + fabs(j) + fabs(k) == 1) {
+                    auto s1 = planeSurface(
+                        pars::origin = Vec3{ 0.5 * i, 0.5 * j, 1. + 0.5 * k },
+                        pars::direction = Vec3{ i,j, k },
+                        pars::pictureColor = Color::white(1.));
+                    cc->addSurface(s1);
+                }
+            }
+        }
+    }
+    return cc;
+}
+
+void addRoom(Engine &en)
+{
+
+	auto light = planeSurface(
+		pars::origin = Vec3{ 0,0,5 - 1E-4 },
+		pars::direction = Vec3{ 0,0,1 },
+		pars::name = "light");
+
+    auto w1 = planeSurface(
+        pars::origin = Vec3{ -2,0,0 },
+        pars::direction = Vec3{ -1,0,0 },
+        pars::name = "back");
+    auto w2 = planeSurface(
+        pars::origin = Vec3{ 0,-5,0 },
+        pars::direction = Vec3{ 0,-1,0 },
+        pars::name = "left");
+    auto w3 = planeSurface(
+        pars::origin = Vec3{ 0,+5,0 },
+        pars::direction = Vec3{ 0,+1,0 },
+        pars::name = "right");
+    auto w4 = planeSurface(
+        pars::origin = Vec3{ 0,0,5 },
+        pars::direction = Vec3{ 0,0,-1 },
+        pars::name = "roof");
+    auto w5 = planeSurface(
+        pars::origin = Vec3{ 0,0,0 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::name = "floor");
+
+    for (auto& wall : { w1, w2, w3, w4, w5 }) {
+        wall->setTrans(0);
+        wall->setGridTexture(1);
+        wall->setReflectType(ReflectType::Diffuse);
+    }
+
+    {
+        light->setBound(boxBound(
+            pars::x0 = -3,
+            pars::x1 = 3,
+            pars::y0 = -3,
+            pars::y1 = 3));
+    }
+
+    light->setName("light");
+    light->setBrightness(1);
+    light->setTrans(0.);
+    light->setReflect(0.);
+    light->setInnerReflectType(ReflectType::Mirror);
+    light->setOuterReflectType(ReflectType::Mirror);
+
+    en.addDevice(std::move(w1));
+    en.addDevice(std::move(w2));
+    en.addDevice(std::move(w3));
+    en.addDevice(std::move(w4));
+    en.addDevice(std::move(w5));
+    en.addDevice(std::move(light));
+
+}
+
+void addGlass(Engine& en)
+{
+    auto qs3 = quadricSurface(
+        pars::shape = ShapeType::Tube,
+        pars::origin = Vec3{ 0, 0, 0 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::radius = 1.,
+        pars::name = "barrel",
+        pars::pictureColor = Color::red(0.5),
+        pars::reflectType = ReflectType::Optical,
+        pars::innerIndex = 1.5);
+
+    auto ec1 = planeSurface(
+        pars::origin = Vec3{ 0,0,1.5 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::name = "top",
+        pars::pictureColor = Color::blue(0.5),
+        pars::reflectType = ReflectType::Optical,
+        pars::innerIndex = 1.5);
+
+    auto ec2 = planeSurface(
+        pars::origin = Vec3{ 0,0,0 },
+        pars::direction = Vec3{ 0,0,-1 },
+        pars::name = "bottom",
+        pars::pictureColor = Color::blue(0.5),
+        pars::reflectType = ReflectType::Optical,
+        pars::innerIndex = 1.5);
+
+    en.addDevice(convex({ ec1, ec2, qs3 }));
+}
+
+void addFourSpheres(Engine& en)
+{
+    auto qs1 = quadricSurface(
+        pars::name = "qs1",
+        pars::shape = ShapeType::Shpere,
+        pars::origin = Vec3{ 0, -3.6, 1 },
+        pars::radius = 1.,
+        pars::pictureColor = Color::red(1.),
+        pars::reflectType = ReflectType::Diffuse);
+    qs1->setOuterReflect(gaussSpectrum(1., WaveLengthRed, 25));
+
+    auto qs2 = quadricSurface(
+        pars::name = "qs2",
+        pars::shape = ShapeType::Shpere,
+        pars::origin = Vec3{ 0, -1.2, 1 },
+        pars::radius = 1.,
+        pars::pictureColor = Color::red(1.),
+        pars::reflectType = ReflectType::Mirror,
+        pars::reflectRatio = 1.,
+        pars::refractRatio = 0.
+    );
+
+    auto qs3 = quadricSurface(
+        pars::name = "qs3",
+        pars::shape = ShapeType::Shpere,
+        pars::origin = Vec3{ 0, 1.2, 1 },
+        pars::radius = 1.,
+        pars::pictureColor = Color::red(1.),
+        pars::reflectType = ReflectType::Optical,
+        pars::innerIndex = 1.5
+    );
+
+    auto qs4 = quadricSurface(
+        pars::name = "qs4",
+        pars::shape = ShapeType::Shpere,
+        pars::origin = Vec3{ 0, 3.6, 1 },
+        pars::radius = 1.,
+        pars::pictureColor = Color::red(1.),
+        pars::reflectType = ReflectType::Metal,
+        pars::reflectRatio = 1.,
+        pars::refractRatio = 0.
+    );
+
+    en.addDevice(qs1);
+    en.addDevice(qs2);
+    en.addDevice(qs3);
+    en.addDevice(qs4);
+}
+
+void addCone(Engine& en)
+{
+    auto qs = quadricSurface(pars::shape = ShapeType::Cone,
+        pars::radius = 1.,
+        pars::direction = Vec3{0,0,1},
+        pars::top_height = 2,
+        pars::top_radius = 0.5);
+    en.addDevice(qs);
+}
+
+constexpr Real atmosphereThick = 1;
+
+struct Atmosphere : Device
+{
+
+    Real step = 0.2;
+    Real Length = 0.5;
+    std::shared_ptr<Surface> atmosphereTop;
+    SurfaceProperties scattering_property;
+    SurfaceProperties trans_property;
+
+    Atmosphere()
+    {
+        setName("air");
+        atmosphereTop = quadricSurface(
+            pars::name = "atmoTop",
+            pars::shape = ShapeType::Shpere,
+            pars::origin = Vec3{ 0,0,-5 },
+            pars::radius = 5 + atmosphereThick,
+            pars::in2OutRefractRatio = 1,
+            pars::out2InRefractRatio = 1,
+            pars::innerReflectRatio = 0,
+            pars::outerReflectRatio = 0,
+            pars::innerReflectType = ReflectType::Mirror,
+            pars::outerReflectType = ReflectType::Mirror);
+
+        scattering_property.fIn2OutReflect = 0.5;
+        scattering_property.fIn2OutTrans = 0.5;
+        scattering_property.fInnerReflectType = ReflectType::Rayleigh;
+        trans_property.fIn2OutReflect = 0;
+        trans_property.fIn2OutTrans = 1;
+        trans_property.fInnerReflectType = ReflectType::Mirror;
+    }
+
+    void process(Ray const& in, ProcessHandler& handler) const {
+
+            if (handler.fType == HandlerType::Distance) {
+                if (atmosphereTop->isInner(in.fO)) {
+                    static_cast<DistanceHandler&>(handler).distance(step, true);
+                } else {
+                    atmosphereTop->process(in, handler);
+                }
+            } else if (handler.fType == HandlerType::Tracing) {
+                if (atmosphereTop->isInner(in.fO)) {
+                    Real len = Length / Sqr(Sqr(500 / in.fLambda));
+                    if (uniform(0, 1) < step / len) {
+                        static_cast<TracingHandler&>(handler).hitSurface(
+                            in.fO + in.fD * step, in.fD,
+                            true, &scattering_property, this);
+                    } else {
+                        static_cast<TracingHandler&>(handler).hitSurface(
+                            in.fO + in.fD * step, in.fD,
+                            true, &trans_property, this);
+                    }
+                } else {
+                    atmosphereTop->process(in, handler);
+                }
+            }                       
+    }
+
+};
+
+std::shared_ptr<QuadricSurface> addSky(Engine& en)
+{
+	auto earth = quadricSurface(
+		pars::name = "earth",
+        pars::shape = ShapeType::Shpere,
+		pars::origin = Vec3{ 0,0,-5 },
+		pars::radius = 5,
+		pars::out2InRefractRatio = 0.0,
+		pars::outerReflectRatio = 1.0,
+		pars::outerReflectType = ReflectType::Diffuse);
+
+	auto sun = quadricSurface(pars::shape = ShapeType::Shpere,
+        pars::outerReflectRatio = 0,
+		pars::origin = Vec3{ 10,0,0 },
+		pars::radius = 1,
+		pars::brightness = 1);
+
+    en.addDevice(earth);
+    en.addDevice(std::make_shared<Atmosphere>());
+    en.addDevice(sun);
+    return sun;
+}
+
+void setAirLength(Engine& en, Real length)
+{
+    static_cast<Atmosphere*>(en.findDevice("air"))->Length = length;
+}
+
+void addTelescopeToEngin(Engine& en)
+{
+    Real trans = 0.5;
+    Real mainMirrorRadius = 1.5;
+    Real shellRadius = 0.2;
+    Real shellLength = 1;
+    Real holdZ = 0.5;
+
+    auto shellBox = boxBound(pars::z0 = 0, pars::z1 = shellLength);
+    auto shellhole = boxBound(
+        pars::x0 = 0, pars::x1 = 1,
+        pars::y0 = -0.05, pars::y1 = 0.05,
+        pars::z0 = holdZ - 0.05, pars::z1 = holdZ + 0.05
+    );
+
+    auto shellBound = all({ shellBox, inverse(shellhole) });
+
+    auto shell = quadricSurface(
+        pars::name = "shell",
+        pars::shape = ShapeType::Tube,
+        pars::origin = Vec3{ 0,0,0 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::radius = shellRadius,
+        pars::reflectRatio = 0.5,
+        pars::innerReflectType = ReflectType::Diffuse,
+        pars::outerReflectType = ReflectType::Diffuse,
+        pars::bound = shellBound
+        );
+
+    Real zOff = shellRadius * shellRadius / (2 * mainMirrorRadius);
+
+    auto undersea = planeBound(
+        pars::origin = Vec3{ 0,0,0 },
+        pars::direction = Vec3{ 0,0,1 });
+
+    auto mainMirror = quadricSurface(
+        pars::name = "mainMirror",
+        pars::shape = ShapeType::Parabola,
+        pars::direction = Vec3{ 0,0,1 },
+        pars::origin = Vec3{ 0,0, -zOff },
+        pars::radius = mainMirrorRadius,
+        pars::innerReflectType = ReflectType::Mirror,
+        pars::outerReflectType = ReflectType::Diffuse,
+        pars::bound = undersea
+        );
+
+    auto secondMirrorBound = boxBound(pars::x0 = -0.05,
+        pars::x1 = 0.05,
+        pars::y0 = -0.05,
+        pars::y1 = 0.05);
+
+    auto secondMirror = std::make_shared<PlaneSurface>(
+        pars::name = "secondMirror",
+        pars::innerReflectType = ReflectType::Diffuse,
+        pars::innerReflectRatio = 0.0,
+        pars::outerReflectType = ReflectType::Mirror,
+        pars::outerReflectRatio= 1.0,
+        pars::origin = Vec3{ 0,0, 0.5 },
+        pars::direction = Vec3{ 1, 0, -1 },
+        pars::bound = secondMirrorBound
+        );
+
+    auto floor = std::make_shared<PlaneSurface>(
+        pars::origin = Vec3{ 0,0,-1 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::name = "floor",
+        pars::reflectRatio = 0.5,
+        pars::innerReflectType = ReflectType::Diffuse,
+        pars::outerReflectType = ReflectType::Diffuse);
+
+    Real scnX = mainMirrorRadius / 2 - zOff - holdZ;
+
+    auto scn = std::make_shared<PlaneScreen>(
+        pars::name = "screen",
+        pars::origin = Vec3{ scnX, 0, holdZ },
+        pars::direction = Vec3{ -1, 0, 0 },
+        pars::bound = boxBound(
+            pars::y0 = -0.03,
+            pars::y1 = +0.03,
+            pars::z0 = holdZ - 0.03,
+            pars::z1 = holdZ + 0.03),
+        pars::reflectRatio = 0.,
+        pars::refractRatio = 0.
+        );
+
+
+    mainMirror->setInnerPictureColor(Color::red());
+    mainMirror->setOuterPictureColor(Color::green());
+    secondMirror->setInnerPictureColor(Color::red());
+    secondMirror->setOuterPictureColor(Color::red());
+    shell->setPictureColor(Color::white(trans));
+    scn->setPictureColor(Color::green());
+    secondMirror->setPictureColor(Color::green());
+    secondMirror->setPictureAlpha(1.0);
+    secondMirror->setInnerPictureAlpha(0);
+
+    en.addDevice(std::move(shell));
+    en.addDevice(std::move(floor));
+    en.addDevice(std::move(mainMirror));
+    en.addDevice(std::move(secondMirror));
+    en.addDevice(std::move(scn));
+}
+
+std::shared_ptr<PlaneScreen> addTelescopeObject(Engine& en)
+{
+    auto cirule = quadricBound(
+        pars::shape = ShapeType::Tube,
+        pars::origin = Vec3{ 0,0,0 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::radius = 0.2);
+
+    auto psStop = planeStop(
+        pars::origin = Vec3{ 0,0,1 },
+        pars::n1 = Vec3{ 1,0,0 },
+        pars::n2 = Vec3{ 0,1,0 },
+        pars::n1Min = -0.2,
+        pars::n1Max = +0.2,
+        pars::n2Min = -0.2,
+        pars::n2Max = +0.2,
+        pars::bound = cirule);
+
+
+    Real objectZ = kTelescopeObjectZ;
+    Real w = kTelescopeObjectSize;
+    auto pps = planePositionSampler();
+    {
+
+
+        pps->setNorms({ 1,0,0 }, { 0,1,0 });
+        pps->setNorm1Bounds(-w / sqrt(3) / 2, w / sqrt(3));
+        pps->setNorm2Bounds(-w / 2, w / 2);
+        pps->setOrigin({ 0,0, objectZ });
+
+        Vec3 z{ 0,0,1 };
+        Vec3 p1{ 1 / sqrt(3), 0, 0 };
+        Vec3 p2{ -0.5 / sqrt(3), -0.5, 0 };
+        Vec3 p3{ -0.5 / sqrt(3), +0.5, 0 };
+        p1 = p1 * w;
+        p2 = p2 * w;
+        p3 = p3 * w;
+
+        auto t1 = planeBound();
+        auto t2 = planeBound();
+        auto t3 = planeBound();
+        t1->setOP(p1, cross(z, p2 - p1));
+        t2->setOP(p2, cross(z, p3 - p2));
+        t3->setOP(p3, cross(z, p1 - p3));
+        auto triangle = all({ t1, t2, t3 });
+
+        pps->setBound(triangle);
+    };
+
+    auto src = comSource(1.,
+        monoSpectrum(0),
+        pps,
+        stopDirectionSampler(psStop,
+            cosineDirectionSampler())
+    );
+
+    auto light_scn = planeScreen(
+        pars::origin = Vec3{ 0,0,objectZ - 0.1 },
+        pars::direction = Vec3{ 0,0,1 },
+        pars::name = "light_scn",
+        pars::reflectRatio = 0.,
+        pars::refractRatio = 1.,
+        pars::reflectType = ReflectType::Mirror,
+        pars::recordIn2Out = false);
+
+    en.addSource(src);
+    en.addDevice(light_scn);
+    return light_scn;
+}
+
+ScreenOpts telescopeScreenOpts(int width, int high)
+{
+    return ScreenOpts(
+        pars::gray = true,
+        pars::high = high,
+        pars::width = width,
+        pars::n1 = Vec3{ 0,1,0 },
+        pars::n2 = Vec3{ 0,0,1 },
+        pars::origin = Vec3{ 0,0,0.5 },
+        pars::screenSize = kTelescopeObjectSize / kTelescopeObjectZ);
+}
+
+std::shared_ptr<PlaneScreen> addPrism(Engine& en)
+{
+    Real dist = 20;
+
+    auto build_triangle = [](){
+
+        auto p1 = planeSurface(
+            pars::origin = Vec3{ 0,0,1 },
+            pars::direction = normalize(Vec3{ 0,1,0.1 }),
+            pars::pictureColor = Color::white(0.1));
+
+        auto p2 = planeSurface(
+            pars::origin = Vec3{ 0,0,1 },
+            pars::direction = normalize(Vec3{ 0,-1,0.1 }),
+            pars::reflectType = ReflectType::Mirror,
+            pars::pictureColor = Color::white(0.1));
+
+        auto p3 = planeSurface(
+            pars::origin = Vec3{ 0,0,-1 },
+            pars::direction = normalize(Vec3{ 0,0,-1 }),
+            pars::pictureColor = Color::white(0.1));
+
+        auto p4 = planeSurface(
+            pars::origin = Vec3{ 1,0,0 },
+            pars::direction = normalize(Vec3{ 1,0, 0 }),
+            pars::pictureColor = Color::red(0.9));
+
+        auto p5 = planeSurface(
+            pars::origin = Vec3{ -1,0,0 },
+            pars::direction = normalize(Vec3{ -1,0, 0, }),
+            pars::pictureColor = Color::red(0.9));
+
+        std::vector<std::shared_ptr<PlaneSurface>> planes
+            = { p1,p2,p3,p4,p5 };
+        for (auto& s : planes) {
+            s->set(
+                pars::innerPredefinedSellmeier3 = PredefinedSellmeier3::BK7,
+                pars::reflectType = ReflectType::Mirror,
+                pars::innerReflectRatio = 0,
+                pars::outerReflectRatio = 0,
+                pars::in2OutRefractRatio = 1.,
+                pars::out2InRefractRatio = 1.
+            );
+        }
+        return convex({ p1,p2,p3,p4,p5 });
+    };
+
+    auto tri = build_triangle();
+
+
+    auto scn = planeScreen(
+		pars::origin = Vec3{ 0,dist,0 },
+		pars::direction = Vec3{ 0,1,0 },
+		pars::bound = boxBound(pars::x0 = -1, pars::x1 = 1,
+			pars::z0 = -1, pars::z1 = 1),
+        pars::pictureColor = Color::white()
+    );
+
+    en.addDevice(tri);
+    en.addDevice(scn);
+
+    struct SampleInLine : PositionSampler {
+        Vec3 sample(Vec3& norm) override {
+			norm = normalize(Vec3{ 0,+1,0.06 }); // ray direction
+			return Vec3{ uniform(-0.01,0.01),-4,0 };
+        }
+    };
+    en.addSource(comSource(pars::amp = 1,
+		pars::spectrum = plankSpectrum(pars::temperature = 5000),
+		pars::positionSampler = std::make_shared<SampleInLine>(),
+		pars::directionSampler = uniformDirectionSampler(0)
+    ));
+    return scn;
+}
+
+ScreenOpts prismScreenOpts(int width, int high)
+{
+    return ScreenOpts(pars::width = width,
+        pars::high = high,
+        pars::n1 = Vec3{ 1,0,0 },
+        pars::n2 = Vec3{ 0,0,1 },
+        pars::n1Min = -0.02,
+        pars::n1Max = 0.02,
+        pars::n2Min = -0.7,
+        pars::n2Max = -0.6);
+}
+
+// camera scenes are traced by eye() with a seeded picture, the source
+// scenes are emitted from the seeded main thread and rastered. emit() has
+// no profile, the source scenes ignore the one given
+static Bitmap eyeScene(Engine& en, PictureOpts camera,
+    SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile* profile)
+{
+    camera.set(pars::width = q.width,
+        pars::high = q.high,
+        pars::samplePerPixel = q.samples,
+        pars::mult = true,
+        pars::seed = opts.Seed,
+        pars::lambdaSampling = opts.LambdaSampling);
+    camera.Trace = opts.Trace;
+    camera.Profile = profile != nullptr;
+    Bitmap bmp = en.eye(camera);
+    stats = en.lastStats();
+    if (profile) {
+        *profile = en.lastProfile();
+    }
+    return bmp;
+}
+
+static Bitmap emitScene(Engine& en, PlaneScreen& scn, ScreenOpts const& screen,
+    SceneQuality const& q, PictureOpts const& opts, TraceStats& stats)
+{
+    setRandomSeed(opts.Seed);
+    en.emit(q.samples);
+    stats = en.lastStats();
+    Bitmap bmp;
+    scn.raster(bmp, screen);
+    return bmp;
+}
+
+std::vector<BenchScene> benchScenes()
+{
+    std::vector<BenchScene> scenes;
+
+    scenes.push_back({ "blueSky", { { 100, 100, 100 }, { 200, 200, 5000 }, { 200, 200, 50000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile* profile) {
+            Engine en;
+            auto sun = addSky(en);
+            setAirLength(en, 0.5);
+            sun->set(pars::shape = ShapeType::Shpere,
+                pars::origin = Vec3{ 0,0,10 },
+                pars::radius = 1);
+            return eyeScene(en, PictureOpts(
+                pars::origin = Vec3{ 0,0,0.05 },
+                pars::n1 = Vec3{ 0,1,0 },
+                pars::n2 = Vec3{ 1,0,0 },
+                pars::fieldOfView = 2), q, opts, stats, profile);
+        } });
+
+    scenes.push_back({ "newtainTelescope", { { 200, 200, 10000 }, { 200, 200, 100000 }, { 200, 200, 1000000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile*) {
+            Engine en;
+            addTelescopeToEngin(en);
+            addTelescopeObject(en);
+            auto scn = dynamic_cast<PlaneScreen*>(en.findDevice("screen"));
+            return emitScene(en, *scn, telescopeScreenOpts(q.width, q.high), q, opts, stats);
+        }, false });
+
+    scenes.push_back({ "dispersivePrism", { { 200, 200, 1000 }, { 200, 200, 1000000 }, { 200, 200, 10000000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile*) {
+            Engine en;
+            auto scn = addPrism(en);
+            return emitScene(en, *scn, prismScreenOpts(q.width, q.high), q, opts, stats);
+        }, false });
+
+    scenes.push_back({ "testSphere", { { 100, 100, 100 }, { 500, 500, 500 }, { 1000, 1000, 1000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile* profile) {
+            Engine en;
+            addRoom(en);
+            addFourSpheres(en);
+            return eyeScene(en, PictureOpts(
+                pars::origin = Vec3{ 10,0,2.5 },
+                pars::lookAt = Vec3{ 0,0,0 },
+                pars::fieldOfView = 1.2), q, opts, stats, profile);
+        } });
+
+    scenes.push_back({ "Glass", { { 100, 100, 100 }, { 1000, 1000, 1000 }, { 2000, 2000, 10000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile* profile) {
+            Engine en;
+            addGlass(en);
+            addRoom(en);
+            return eyeScene(en, PictureOpts(
+                pars::origin = Vec3{ 10,0, 3 },
+                pars::lookAt = Vec3{ 0,0,2 },
+                pars::fieldOfView = 1.2), q, opts, stats, profile);
+        } });
+
+    // the example only draws the cone, here it is traced in the room
+    scenes.push_back({ "testCone", { { 100, 100, 100 }, { 500, 500, 500 }, { 1000, 1000, 1000 } },
+        [](SceneQuality const& q, PictureOpts const& opts, TraceStats& stats, RenderProfile* profile) {
+            Engine en;
+            addCone(en);
+            addRoom(en);
+            return eyeScene(en, PictureOpts(
+                pars::origin = Vec3{ 10,0,2.5 },
+                pars::lookAt = Vec3{ 0,0,0 },
+                pars::fieldOfView = 1.2), q, opts, stats, profile);
+        } });
+
+    return scenes;
+}
+
+static double meanOf(Bitmap const& bmp)
+{
+    double sum = 0;
+    for (Color const& c : bmp.fC) {
+        sum += c.R() + c.G() + c.B();
+    }
+    return bmp.fC.empty() ? 0 : sum / (3 * bmp.fC.size());
+}
+
+double relativeRMSE(Bitmap const& bmp, Bitmap const& ref)
+{
+    if (bmp.fW != ref.fW || bmp.fH != ref.fH || bmp.fC.empty()) {
+        return -1;
+    }
+    double m1 = meanOf(bmp);
+    double m2 = meanOf(ref);
+    if (m1 <= 0 || m2 <= 0) {
+        return -1;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < bmp.fC.size(); ++i) {
+        Color const& a = bmp.fC[i];
+        Color const& b = ref.fC[i];
+        sum += Sqr(a.R() / m1 - b.R() / m2);
+        sum += Sqr(a.G() / m1 - b.G() / m2);
+        sum += Sqr(a.B() / m1 - b.B() / m2);
+    }
+    return sqrt(sum / (3 * bmp.fC.size()));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../srt/srt.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// the scenes of the examples, shared by Examples.cpp and the scene benchmark
+
+int const kFAST = 0;
+int const kGOOD = 1;
+int const kBEST = 2;
+
+// width=height=depth=1
+std::shared_ptr<srt::Surface> boxSurface();
+// diffuse walls, floor and roof, a light in the roof
+void addRoom(srt::Engine& en);
+// a glass cylinder standing on the floor
+void addGlass(srt::Engine& en);
+// diffusive, mirror, glass and metal spheres in a row
+void addFourSpheres(srt::Engine& en);
+void addCone(srt::Engine& en);
+
+// earth, air and sun. the sun is returned to be moved around
+std::shared_ptr<srt::QuadricSurface> addSky(srt::Engine& en);
+// mean free path of the air at 500nm
+void setAirLength(srt::Engine& en, srt::Real length);
+
+// the telescope and its screen named "screen"
+void addTelescopeToEngin(srt::Engine& en);
+// a triangle of light far away seen by the telescope,
+// returns the screen recording the emitted rays
+std::shared_ptr<srt::PlaneScreen> addTelescopeObject(srt::Engine& en);
+srt::Real const kTelescopeObjectZ = 1E7;
+srt::Real const kTelescopeObjectSize = 100;
+// the view of the telescope screen
+srt::ScreenOpts telescopeScreenOpts(int width, int high);
+
+// a BK7 prism lit by a line of black body light, returns the screen
+std::shared_ptr<srt::PlaneScreen> addPrism(srt::Engine& en);
+// the spectrum on the screen
+srt::ScreenOpts prismScreenOpts(int width, int high);
+
+// resolution and samples of a scene. samples are per pixel for the
+// camera scenes, and emitted rays for the source scenes
+struct SceneQuality {
+    int width;
+    int high;
+    int samples;
+};
+
+// a scene rendered into a linear image. the seed, the trace options and
+// the wavelength sampling of opts are used by the camera scenes, the
+// source scenes only use the seed. a camera scene fills profile if it's
+// not null, a source scene (eye false) ignores it
+struct BenchScene {
+    std::string name;
+    // kFAST, kGOOD and kBEST
+    SceneQuality quality[3];
+    std::function<srt::Bitmap(SceneQuality const& q, srt::PictureOpts const& opts, srt::TraceStats& stats, srt::RenderProfile* profile)> render;
+    // rendered by eye(), false for the source scenes
+    bool eye = true;
+};
+
+std::vector<BenchScene> benchScenes();
+
+// rms of the pixel difference after scaling both images to a mean of 1,
+// -1 if the images can't be compared
+double relativeRMSE(srt::Bitmap const& bmp, srt::Bitmap const& ref);
@@ -0,0 +1,217 @@
+#include "BVH.h"
+#include <cmath>
+#include <limits>
+
+namespace srt {
+
+	// round outward, the float box must contain the double box
+	static float floatDown(Real x)
+	{
+		float f = (float)x;
+		if (f > x) {
+			f = std::nextafter(f, -std::numeric_limits<float>::infinity());
+		}
+		return f;
+	}
+
+	static float floatUp(Real x)
+	{
+		float f = (float)x;
+		if (f < x) {
+			f = std::nextafter(f, std::numeric_limits<float>::infinity());
+		}
+		return f;
+	}
+
+	static Real axis(Vec3 const& v, int a)
+	{
+		return a == 0 ? v.fX : (a == 1 ? v.fY : v.fZ);
+	}
+
+	static void setBox(BVHNode& node, AABB const& b)
+	{
+		node.fMin[0] = floatDown(b.fMin.fX);
+		node.fMin[1] = floatDown(b.fMin.fY);
+		node.fMin[2] = floatDown(b.fMin.fZ);
+		node.fMax[0] = floatUp(b.fMax.fX);
+		node.fMax[1] = floatUp(b.fMax.fY);
+		node.fMax[2] = floatUp(b.fMax.fZ);
+	}
+
+	struct BVHBuilder {
+
+		static constexpr int kBins = 16;
+		// cost of traversing a node relative to a primitive test
+		static constexpr Real kTraversalCost = 1.;
+
+		std::vector<AABB> const& boxes;
+		std::vector<Vec3> centers;
+		std::vector<BVHNode>& nodes;
+		std::vector<uint32_t>& order;
+		int maxLeafSize;
+
+		struct Bin {
+			AABB box;
+			uint32_t count = 0;
+		};
+
+		void build()
+		{
+			size_t n = boxes.size();
+			nodes.clear();
+			order.resize(n);
+			centers.resize(n);
+			for (size_t i = 0; i < n; ++i) {
+				order[i] = (uint32_t)i;
+				centers[i] = boxes[i].center();
+			}
+			if (n == 0) {
+				return;
+			}
+			nodes.reserve(2 * n / maxLeafSize + 1);
+			buildNodes(0, (uint32_t)n);
+		}
+
+		// split [begin, end), return the split position or end if it should be a leaf
+		uint32_t split(uint32_t begin, uint32_t end, AABB const& bounds)
+		{
+			uint32_t count = end - begin;
+			if (count <= 1) {
+				return end;
+			}
+
+			AABB cbounds;
+			for (uint32_t i = begin; i < end; ++i) {
+				cbounds.extend(centers[order[i]]);
+			}
+
+			Real bestCost = kInfity;
+			int bestAxis = -1;
+			int bestBin = 0;
+
+			for (int a = 0; a < 3; ++a) {
+				Real lo = axis(cbounds.fMin, a);
+				Real hi = axis(cbounds.fMax, a);
+				if (!(hi > lo)) {
+					continue;
+				}
+				Real scale = kBins / (hi - lo);
+
+				Bin bins[kBins];
+				for (uint32_t i = begin; i < end; ++i) {
+					uint32_t p = order[i];
+					int b = std::min(kBins - 1, (int)((axis(centers[p], a) - lo) * scale));
+					bins[b].count += 1;
+					bins[b].box.extend(boxes[p]);
+				}
+
+				// sweep from right to left to get the right side areas
+				Real rightArea[kBins];
+				uint32_t rightCount[kBins];
+				AABB acc;
+				uint32_t cnt = 0;
+				for (int b = kBins - 1; b > 0; --b) {
+					acc.extend(bins[b].box);
+					cnt += bins[b].count;
+					rightArea[b] = acc.halfArea();
+					rightCount[b] = cnt;
+				}
+
+				acc = AABB();
+				cnt = 0;
+				for (int b = 0; b < kBins - 1; ++b) {
+					acc.extend(bins[b].box);
+					cnt += bins[b].count;
+					if (cnt == 0 || rightCount[b + 1] == 0) {
+						continue;
+					}
+					Real cost = acc.halfArea() * cnt + rightArea[b + 1] * rightCount[b + 1];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = a;
+						bestBin = b;
+					}
+				}
+			}
+
+			Real area = bounds.halfArea();
+			Real leafCost = (Real)count;
+			if (bestAxis >= 0 && area > 0) {
+				bestCost = kTraversalCost + bestCost / area;
+			}
+
+			if (bestAxis < 0) {
+				// all centers are at the same point
+				if (count <= (uint32_t)maxLeafSize) {
+					return end;
+				}
+				return begin + count / 2;
+			}
+
+			if (count <= (uint32_t)maxLeafSize && bestCost >= leafCost) {
+				return end;
+			}
+
+			Real lo = axis(cbounds.fMin, bestAxis);
+			Real scale = kBins / (axis(cbounds.fMax, bestAxis) - lo);
+			uint32_t* mid = std::partition(order.data() + begin, order.data() + end,
+				[&](uint32_t p) {
+					int b = std::min(kBins - 1, (int)((axis(centers[p], bestAxis) - lo) * scale));
+					return b <= bestBin;
+				});
+			return (uint32_t)(mid - order.data());
+		}
+
+		void buildNodes(uint32_t begin, uint32_t end)
+		{
+			// explicit stack, deep trees are possible for bad inputs.
+			// nodes are allocated when they are popped, so that the first child
+			// (pushed last) always directly follows its parent.
+			struct Task {
+				uint32_t parent;
+				bool second;
+				uint32_t begin;
+				uint32_t end;
+			};
+			std::vector<Task> tasks;
+			tasks.push_back({ 0, false, begin, end });
+
+			while (!tasks.empty()) {
+				Task t = tasks.back();
+				tasks.pop_back();
+
+				uint32_t idx = (uint32_t)nodes.size();
+				nodes.emplace_back();
+				if (t.second) {
+					nodes[t.parent].fIndex = idx;
+				}
+
+				AABB bounds;
+				for (uint32_t i = t.begin; i < t.end; ++i) {
+					bounds.extend(boxes[order[i]]);
+				}
+				setBox(nodes[idx], bounds);
+
+				uint32_t mid = split(t.begin, t.end, bounds);
+				if (mid == t.end || mid == t.begin) {
+					nodes[idx].fIndex = t.begin;
+					nodes[idx].fCount = t.end - t.begin;
+				} else {
+					nodes[idx].fCount = 0;
+					tasks.push_back({ idx, true, mid, t.end });
+					tasks.push_back({ idx, false, t.begin, mid });
+				}
+			}
+		}
+	};
+
+	void buildBVH(std::vector<AABB> const& boxes,
+		std::vector<BVHNode>& nodes,
+		std::vector<uint32_t>& order,
+		int maxLeafSize)
+	{
+		BVHBuilder builder{ boxes, {}, nodes, order, std::max(1, maxLeafSize) };
+		builder.build();
+	}
+
+}
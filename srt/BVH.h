@@ -0,0 +1,187 @@
+#ifndef SRT_BVH_H
+#define SRT_BVH_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "Real.h"
+#include "Vec3.h"
+
+namespace srt {
+
+	// axis aligned bounding box
+	struct AABB {
+		Vec3 fMin = { kInfity, kInfity, kInfity };
+		Vec3 fMax = { -kInfity, -kInfity, -kInfity };
+
+		void extend(Vec3 const& p);
+		void extend(AABB const& b);
+		void intersect(AABB const& b);
+		Vec3 center() const;
+		// half of the surface area
+		Real halfArea() const;
+		bool empty() const;
+		// not empty and not extending to infinity
+		bool bounded() const;
+
+		// the whole space
+		static AABB infinite();
+	};
+
+	// 32 bytes per node, boxes are stored in float and rounded outward.
+	// inner node: the first child is the next node, the second child is fIndex.
+	// leaf node: primitives [fIndex, fIndex + fCount)
+	struct BVHNode {
+		float fMin[3];
+		float fMax[3];
+		uint32_t fIndex;
+		uint32_t fCount;
+
+		bool isLeaf() const { return fCount != 0; }
+	};
+
+	// build a binned SAH BVH over the boxes.
+	// order[i] is the index (into boxes) of i-th primitive referred by the leaves,
+	// the caller is expected to reorder its primitives by order.
+	void buildBVH(std::vector<AABB> const& boxes,
+		std::vector<BVHNode>& nodes,
+		std::vector<uint32_t>& order,
+		int maxLeafSize = 4);
+
+	// ray-box slab test, return the entry distance or kInfity if missed
+	inline Real intersectBox(BVHNode const& node,
+		Vec3 const& o, Vec3 const& invD, Real smax)
+	{
+		Real tx0 = (node.fMin[0] - o.fX) * invD.fX;
+		Real tx1 = (node.fMax[0] - o.fX) * invD.fX;
+		Real ty0 = (node.fMin[1] - o.fY) * invD.fY;
+		Real ty1 = (node.fMax[1] - o.fY) * invD.fY;
+		Real tz0 = (node.fMin[2] - o.fZ) * invD.fZ;
+		Real tz1 = (node.fMax[2] - o.fZ) * invD.fZ;
+
+		Real tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+			std::max(std::min(tz0, tz1), Real(0)));
+		Real tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+			std::min(std::max(tz0, tz1), smax));
+		return tmin <= tmax ? tmin : kInfity;
+	}
+
+	// zero components are mapped to a huge finite value
+	// to avoid 0 * inf = nan in the slab test
+	inline Vec3 inverseDirection(Vec3 const& d)
+	{
+		auto inv = [](Real x) {
+			return x != 0 ? 1. / x : copysign(Real(1E300), x);
+		};
+		return { inv(d.fX), inv(d.fY), inv(d.fZ) };
+	}
+
+	// visit the leaves hit by the ray, near leaves first.
+	// leaf(first, count, smax) tests primitives and shrinks smax when it finds a hit.
+	template<class Leaf>
+	void traverseBVH(BVHNode const* nodes, size_t nodeCount,
+		Vec3 const& o, Vec3 const& d,
+		Real& smax, Leaf&& leaf)
+	{
+		if (nodeCount == 0) {
+			return;
+		}
+		Vec3 invD = inverseDirection(d);
+
+		uint32_t stack[64];
+		int top = 0;
+		uint32_t cur = 0;
+		if (std::isinf(intersectBox(nodes[0], o, invD, smax))) {
+			return;
+		}
+
+		for (;;) {
+			BVHNode const& node = nodes[cur];
+			if (node.isLeaf()) {
+				leaf(node.fIndex, node.fCount, smax);
+			} else {
+				uint32_t c1 = cur + 1;
+				uint32_t c2 = node.fIndex;
+				Real s1 = intersectBox(nodes[c1], o, invD, smax);
+				Real s2 = intersectBox(nodes[c2], o, invD, smax);
+				if (s2 < s1) {
+					std::swap(s1, s2);
+					std::swap(c1, c2);
+				}
+				if (!std::isinf(s1)) {
+					if (!std::isinf(s2)) {
+						stack[top++] = c2;
+					}
+					cur = c1;
+					continue;
+				}
+			}
+
+			if (top == 0) {
+				break;
+			}
+			cur = stack[--top];
+		}
+	}
+
+}
+
+// implementation
+namespace srt {
+
+	inline void AABB::extend(Vec3 const& p)
+	{
+		fMin = { std::min(fMin.fX, p.fX), std::min(fMin.fY, p.fY), std::min(fMin.fZ, p.fZ) };
+		fMax = { std::max(fMax.fX, p.fX), std::max(fMax.fY, p.fY), std::max(fMax.fZ, p.fZ) };
+	}
+
+	inline void AABB::extend(AABB const& b)
+	{
+		extend(b.fMin);
+		extend(b.fMax);
+	}
+
+	inline void AABB::intersect(AABB const& b)
+	{
+		fMin = { std::max(fMin.fX, b.fMin.fX), std::max(fMin.fY, b.fMin.fY), std::max(fMin.fZ, b.fMin.fZ) };
+		fMax = { std::min(fMax.fX, b.fMax.fX), std::min(fMax.fY, b.fMax.fY), std::min(fMax.fZ, b.fMax.fZ) };
+	}
+
+	inline Vec3 AABB::center() const
+	{
+		return 0.5 * (fMin + fMax);
+	}
+
+	inline Real AABB::halfArea() const
+	{
+		if (empty()) {
+			return 0;
+		}
+		Vec3 e = fMax - fMin;
+		return e.fX * e.fY + e.fY * e.fZ + e.fZ * e.fX;
+	}
+
+	inline bool AABB::empty() const
+	{
+		return fMin.fX > fMax.fX || fMin.fY > fMax.fY || fMin.fZ > fMax.fZ;
+	}
+
+	inline bool AABB::bounded() const
+	{
+		return !empty()
+			&& std::isfinite(fMin.fX) && std::isfinite(fMin.fY) && std::isfinite(fMin.fZ)
+			&& std::isfinite(fMax.fX) && std::isfinite(fMax.fY) && std::isfinite(fMax.fZ);
+	}
+
+	inline AABB AABB::infinite()
+	{
+		AABB b;
+		b.fMin = { -kInfity, -kInfity, -kInfity };
+		b.fMax = { kInfity, kInfity, kInfity };
+		return b;
+	}
+
+}
+
+#endif
@@ -2,9 +2,15 @@
 #include "Bitmap.h"
 #include "stb_image_write.h"
 #include "TrueType.h"
+#include "Deflate.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string.h>
+#include <limits>
 
 namespace srt {
 
@@ -20,51 +26,306 @@ namespace srt {
 		os.close();
 	}
 
-	static void file_callback(void* ctx, void* data, int size)
+	// linear [0, 1] to 8 bits sRGB, same as round(255 * RGB2sRGB(Clip(c)))
+	struct SRGBQuantizer {
+
+		static constexpr int kBuckets = 4096;
+
+		// fThreshold[k] is the smallest c giving k + 1
+		double fThreshold[256];
+		// the value at the start of each bucket of [0, 1]
+		uint8_t fStart[kBuckets + 1];
+
+		static int slow(double c)
+		{
+			return (int)round(srt::RGB2sRGB(Clip(c)) * 255);
+		}
+
+		SRGBQuantizer()
+		{
+			for (int k = 0; k < 255; ++k) {
+				// invert the sRGB curve at the rounding point, then fix it up
+				double s = (k + 0.5) / 255;
+				double c = s <= 0.04045 ? s / 12.92 : pow((s + 0.055) / 1.055, 2.4);
+				while (slow(c) > k) {
+					c = std::nextafter(c, -1.);
+				}
+				while (slow(c) <= k) {
+					c = std::nextafter(c, 2.);
+				}
+				fThreshold[k] = c;
+			}
+			// sentinel
+			fThreshold[255] = std::numeric_limits<double>::infinity();
+
+			for (int i = 0; i <= kBuckets; ++i) {
+				double c = (double)i / kBuckets;
+				fStart[i] = (uint8_t)(std::upper_bound(fThreshold, fThreshold + 255, c) - fThreshold);
+			}
+		}
+
+		uint8_t operator()(double c) const
+		{
+			// nan goes to 0 as Clip does
+			if (!(c > 0)) {
+				return 0;
+			}
+			if (c >= 1) {
+				return 255;
+			}
+			// at most about one level per bucket
+			int k = fStart[(int)(c * kBuckets)];
+			while (c >= fThreshold[k]) {
+				++k;
+			}
+			return (uint8_t)k;
+		}
+	};
+
+	static uint8_t quantizeAlpha(double a)
 	{
-		std::ostream* os = (std::ostream*)ctx;
-		os->write((char*)data, size);
+		return (uint8_t)round(Clip(a) * 255);
+	}
 
+	// one row to sRGB bytes, channels is 3 (RGB) or 4 (RGBA)
+	static void quantizeRow(Bitmap const& bitmap, int row, int channels, uint8_t* out)
+	{
+		static const SRGBQuantizer quantize;
+		Color const* c = &bitmap.fC[(size_t)row * bitmap.fW];
+		for (int j = 0; j < bitmap.fW; ++j) {
+			out[0] = quantize(c[j].R());
+			out[1] = quantize(c[j].G());
+			out[2] = quantize(c[j].B());
+			if (channels == 4) {
+				out[3] = quantizeAlpha(c[j].A());
+			}
+			out += channels;
+		}
 	}
 
-	void Bitmap::write(std::ostream& os, ImageFileFormat iff)
+	static void writePPM(Bitmap const& bitmap, std::ostream& os)
 	{
-		Bitmap bitmap;
-		bitmap.resize(fW, fH);
-		bitmap.fC = fC;
-		bitmap.regularize();
-		bitmap.RGB2sRGB();
+		os << "P6\n";
+		os << bitmap.fW << " " << bitmap.fH << "\n";
+		os << 255 << "\n";
 
-		if (iff == ImageFileFormat::PPM) {
-			os << "P3\n";
-			os << fW << " " << fH << "\n";
-			os << 255 << "\n";
-
-			for (int i = 0; i < fH; ++i) {
-				for (int j = 0; j < fW; ++j) {
-					Color color = bitmap.at(i, j);
-					os << (int)round(color.R() * 255) << " "
-						<< (int)round(color.G() * 255) << " "
-						<< (int)round(color.B() * 255) << "\n";
+		std::vector<uint8_t> row(3 * (size_t)bitmap.fW);
+		for (int i = 0; i < bitmap.fH; ++i) {
+			quantizeRow(bitmap, i, 3, row.data());
+			os.write((char const*)row.data(), row.size());
+		}
+	}
+
+	static uint8_t paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
+		if (pa <= pb && pa <= pc) {
+			return (uint8_t)a;
+		}
+		return (uint8_t)(pb <= pc ? b : c);
+	}
+
+	// filter a row with the type of the smallest sum of abs (as signed bytes)
+	static void filterRow(uint8_t const* cur, uint8_t const* up, size_t n, int bpp,
+		uint8_t* out, std::vector<uint8_t>& tmp)
+	{
+		tmp.resize(n);
+		int bestSum = -1;
+		for (int type = 0; type < 5; ++type) {
+			int sum = 0;
+			for (size_t i = 0; i < n; ++i) {
+				int a = i >= (size_t)bpp ? cur[i - bpp] : 0;
+				int b = up ? up[i] : 0;
+				int c = up && i >= (size_t)bpp ? up[i - bpp] : 0;
+				uint8_t v;
+				switch (type) {
+				case 0: v = cur[i]; break;
+				case 1: v = (uint8_t)(cur[i] - a); break;
+				case 2: v = (uint8_t)(cur[i] - b); break;
+				case 3: v = (uint8_t)(cur[i] - ((a + b) >> 1)); break;
+				default: v = (uint8_t)(cur[i] - paeth(a, b, c)); break;
 				}
+				tmp[i] = v;
+				sum += abs((int8_t)v);
+			}
+			if (bestSum < 0 || sum < bestSum) {
+				bestSum = sum;
+				out[0] = (uint8_t)type;
+				memcpy(out + 1, tmp.data(), n);
 			}
 		}
-		else if (iff == ImageFileFormat::PNG) {
-			std::vector<uint8_t> data;
-			data.reserve(4 * fH * fW);
-			for (int i = 0; i < fH; ++i) {
-				for (int j = 0; j < fW; ++j) {
-					Color color = bitmap.at(i, j);
-					data.push_back((int)round(color.R() * 255));
-					data.push_back((int)round(color.G() * 255));
-					data.push_back((int)round(color.B() * 255));
-					data.push_back((int)round(color.A() * 255));
+	}
+
+	static void writeU32(std::ostream& os, uint32_t v)
+	{
+		uint8_t b[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+		os.write((char const*)b, 4);
+	}
+
+	static void writeChunk(std::ostream& os, char const* type,
+		uint8_t const* data, size_t size)
+	{
+		writeU32(os, (uint32_t)size);
+		os.write(type, 4);
+		os.write((char const*)data, size);
+		uint32_t crc = crc32(0, (uint8_t const*)type, 4);
+		crc = crc32(crc, data, size);
+		writeU32(os, crc);
+	}
+
+	// the rows are split into bands compressed by threads into
+	// concatenable deflate blocks, the bands are written in order as IDAT
+	static void writePNG(Bitmap const& bitmap, std::ostream& os)
+	{
+		int const w = bitmap.fW;
+		int const h = bitmap.fH;
+		int const bpp = 4;
+		size_t const stride = (size_t)w * bpp;
+
+		static uint8_t const signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		os.write((char const*)signature, 8);
+
+		uint8_t ihdr[13];
+		for (int i = 0; i < 4; ++i) {
+			ihdr[i] = uint8_t(w >> (24 - 8 * i));
+			ihdr[4 + i] = uint8_t(h >> (24 - 8 * i));
+		}
+		ihdr[8] = 8; // bit depth
+		ihdr[9] = 6; // RGBA
+		ihdr[10] = 0;
+		ihdr[11] = 0;
+		ihdr[12] = 0;
+		writeChunk(os, "IHDR", ihdr, sizeof(ihdr));
+
+		// about 1MB of raw data per band
+		int const bandRows = std::max(1, (int)((1 << 20) / (stride + 1)));
+		int const nBands = std::max(1, (h + bandRows - 1) / bandRows);
+		int const nThreads = std::max(1, std::min(nBands, (int)std::thread::hardware_concurrency()));
+
+		struct Band {
+			std::vector<uint8_t> fData;
+			uint32_t fAdler = 1;
+			size_t fRawSize = 0;
+			bool fDone = false;
+		};
+		std::vector<Band> bands(nBands);
+		std::mutex mutex;
+		std::condition_variable cv;
+		int nextBand = 0;
+		int written = 0;
+
+		auto work = [&]() {
+			std::vector<uint8_t> up(stride), cur(stride), tmp, raw;
+			for (;;) {
+				int b;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					// bound the compressed bands waiting for the writer
+					cv.wait(lock, [&]() { return nextBand >= nBands || nextBand < written + 2 * nThreads; });
+					if (nextBand >= nBands) {
+						return;
+					}
+					b = nextBand++;
 				}
+
+				int r0 = b * bandRows;
+				int r1 = std::min(h, r0 + bandRows);
+				raw.resize((size_t)(r1 - r0) * (stride + 1));
+				if (r0 > 0) {
+					quantizeRow(bitmap, r0 - 1, bpp, up.data());
+				}
+				for (int r = r0; r < r1; ++r) {
+					quantizeRow(bitmap, r, bpp, cur.data());
+					filterRow(cur.data(), r > 0 ? up.data() : nullptr, stride, bpp,
+						&raw[(size_t)(r - r0) * (stride + 1)], tmp);
+					std::swap(up, cur);
+				}
+
+				Band& band = bands[b];
+				band.fRawSize = raw.size();
+				band.fAdler = adler32(1, raw.data(), raw.size());
+				deflateBlock(raw.data(), raw.size(), b + 1 == nBands, band.fData);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					band.fDone = true;
+				}
+				cv.notify_all();
 			}
-			stbi_write_png_to_func(file_callback, &os,
-				(int)fW, (int)fH, 4, data.data(), 4 * (int)fW);
+		};
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < nThreads; ++t) {
+			threads.emplace_back(work);
+		}
+
+		// zlib header: deflate, 32K window, no dictionary
+		uint8_t const zhead[2] = { 0x78, 0x01 };
+		writeChunk(os, "IDAT", zhead, 2);
+		uint32_t adler = 1;
+		for (int b = 0; b < nBands; ++b) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&]() { return bands[b].fDone; });
+			}
+			Band& band = bands[b];
+			writeChunk(os, "IDAT", band.fData.data(), band.fData.size());
+			adler = adler32Combine(adler, band.fAdler, band.fRawSize);
+			std::vector<uint8_t>().swap(band.fData);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				written = b + 1;
+			}
+			cv.notify_all();
+		}
+		for (auto& t : threads) {
+			t.join();
 		}
 
+		uint8_t ztail[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+		writeChunk(os, "IDAT", ztail, 4);
+		writeChunk(os, "IEND", nullptr, 0);
+	}
+
+	void Bitmap::write(std::ostream& os, ImageFileFormat iff)
+	{
+		if (iff == ImageFileFormat::PPM) {
+			writePPM(*this, os);
+		}
+		else if (iff == ImageFileFormat::PNG) {
+			writePNG(*this, os);
+		}
+		else if (iff == ImageFileFormat::PFM) {
+			writePFM(*this, os);
+		}
+		else if (iff == ImageFileFormat::EXR) {
+			writeEXR(*this, os);
+		}
+	}
+
+	void Bitmap::read(std::string const& filename)
+	{
+		ImageFileFormat fmt = getImageFileFormat(tolower(filenameExtension(filename)));
+		std::ifstream is(filename, std::ios_base::binary);
+		if (!is.is_open()) {
+			throw std::runtime_error("can't open " + filename);
+		}
+		read(is, fmt);
+	}
+
+	void Bitmap::read(std::istream& is, ImageFileFormat iff)
+	{
+		if (iff == ImageFileFormat::PFM) {
+			readPFM(*this, is);
+		}
+		else if (iff == ImageFileFormat::EXR) {
+			readEXR(*this, is);
+		}
+		else {
+			throw std::logic_error("only PFM and EXR can be read");
+		}
 	}
 
 	struct BitmapBlit : Blit
@@ -104,7 +365,7 @@ namespace srt {
 #ifdef _MSC_VER
 			return std::string("C:\\Windows\\Fonts");
 #else
-			return "/usr/share/fonts";
+			return std::string("/usr/share/fonts");
 #endif
 		};
 		static TrueType tt(get_font_folder() + "/times.ttf");
@@ -288,6 +549,12 @@ namespace srt {
 		else if (ext == "ppm") {
 			return ImageFileFormat::PPM;
 		}
+		else if (ext == "pfm") {
+			return ImageFileFormat::PFM;
+		}
+		else if (ext == "exr") {
+			return ImageFileFormat::EXR;
+		}
 		else {
 			throw "unknown file ext";
 		}
@@ -41,6 +41,10 @@ namespace srt {
 	enum class ImageFileFormat {
 		PNG,
 		PPM,
+		// linear float, no clipping or sRGB conversion
+		PFM,
+		// half float RGBA OpenEXR, uncompressed scanlines
+		EXR,
 	};
 
 	ImageFileFormat getImageFileFormat(std::string const& ext);
@@ -88,6 +92,10 @@ namespace srt {
 		void write(std::ostream& os, ImageFileFormat iff);
 		void write(std::string const& filename);
 
+		// only PFM and EXR (as written by write) can be read
+		void read(std::istream& is, ImageFileFormat iff);
+		void read(std::string const& filename);
+
 		Color average(int xi, Real y0, Real y1) const;
 		Color average(Real x0, Real x1, Real y0, Real y1) const;
 
@@ -105,6 +113,11 @@ namespace srt {
 		void setBlack(Real alpha = 1.);
 	};
 
+	void writePFM(Bitmap const& bitmap, std::ostream& os);
+	void readPFM(Bitmap& bitmap, std::istream& is);
+	void writeEXR(Bitmap const& bitmap, std::ostream& os);
+	void readEXR(Bitmap& bitmap, std::istream& is);
+
 	inline Color& Bitmap::at(int i, int j) {
 		assert(i < fH);
 		assert(j < fW);
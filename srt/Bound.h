@@ -3,12 +3,15 @@
 
 #include "Real.h"
 #include "Vec3.h"
+#include "BVH.h"
 
 namespace srt {
 
     struct Bound {
 
         virtual bool onInBound(Vec3 const& p) const = 0;
+        // a box containing the bound
+        virtual AABB boundingBox() const;
         virtual ~Bound() {}
         bool inBound(Vec3 const& p) const;
     };
@@ -17,6 +20,10 @@ namespace srt {
         return onInBound(p);
     }
 
+    inline AABB Bound::boundingBox() const {
+        return AABB::infinite();
+    }
+
     inline bool inBound(Bound const* b, Vec3 const& p)
     {
         return !b || b->inBound(p);
@@ -0,0 +1,234 @@
+#include "BoundProgram.h"
+#include "Bounds.h"
+#include <typeinfo>
+
+namespace srt {
+
+	void BoundProgram::compile(Bound const* bound)
+	{
+		*this = BoundProgram();
+		if (bound) {
+			compile(bound, kTrue, kFalse);
+			buildTable();
+		}
+	}
+
+	bool BoundProgram::same(Bound const* bound) const
+	{
+		if (!bound) {
+			return fTree.empty();
+		}
+		Cursor at;
+		return same(bound, at) && at.fNode == fTree.size();
+	}
+
+	// walks the tree as compile() does
+	bool BoundProgram::same(Bound const* bound, Cursor& at) const
+	{
+		if (at.fNode == fTree.size() || fTree[at.fNode].first != bound) {
+			return false;
+		}
+		size_t children = fTree[at.fNode++].second;
+		auto const& type = typeid(*bound);
+		if (type == typeid(BoxBound)) {
+			auto b = static_cast<BoxBound const*>(bound);
+			size_t i = at.fBox++;
+			return b->fX0 == fX0[i] && b->fX1 == fX1[i]
+				&& b->fY0 == fY0[i] && b->fY1 == fY1[i]
+				&& b->fZ0 == fZ0[i] && b->fZ1 == fZ1[i];
+		} else if (type == typeid(PlaneBound)) {
+			auto b = static_cast<PlaneBound const*>(bound);
+			size_t i = at.fPlane++;
+			return b->fP.fX == fPX[i] && b->fP.fY == fPY[i]
+				&& b->fP.fZ == fPZ[i] && b->fR == fPR[i];
+		} else if (type == typeid(QuadricBound)) {
+			auto b = static_cast<QuadricBound const*>(bound);
+			size_t i = at.fQuadric++;
+			return b->fQ.fM11 == fQ11[i] && b->fQ.fM12 == fQ12[i]
+				&& b->fQ.fM13 == fQ13[i] && b->fQ.fM22 == fQ22[i]
+				&& b->fQ.fM23 == fQ23[i] && b->fQ.fM33 == fQ33[i]
+				&& b->fP.fX == fQX[i] && b->fP.fY == fQY[i]
+				&& b->fP.fZ == fQZ[i] && b->fR == fQR[i];
+		} else if (type == typeid(AllBound) || type == typeid(AnyBound)) {
+			auto& bounds = type == typeid(AllBound)
+				? static_cast<AllBound const*>(bound)->fBounds
+				: static_cast<AnyBound const*>(bound)->fBounds;
+			if (bounds.size() != children) {
+				return false;
+			}
+			for (auto& b : bounds) {
+				if (!same(b.get(), at)) {
+					return false;
+				}
+			}
+			return true;
+		} else if (type == typeid(InverseBound)) {
+			auto b = static_cast<InverseBound const*>(bound);
+			if ((b->fBound ? 1 : 0) != children) {
+				return false;
+			}
+			return !b->fBound || same(b->fBound.get(), at);
+		}
+		return true;
+	}
+
+	bool BoundProgram::run(uint32_t mask) const
+	{
+		int32_t pc = 0;
+		do {
+			Instruction const& ins = fCode[pc];
+			pc = (mask >> pc) & 1 ? ins.fOnTrue : ins.fOnFalse;
+		} while (pc >= 0);
+		return pc == kTrue;
+	}
+
+	void BoundProgram::buildTable()
+	{
+		if (fCode.size() > kTableTests || !fCalls.empty()) {
+			return;
+		}
+		uint32_t n = 1u << fCode.size();
+		fTable.assign((n + 63) / 64, 0);
+		for (uint32_t m = 0; m < n; ++m) {
+			if (run(m)) {
+				fTable[m >> 6] |= uint64_t(1) << (m & 63);
+			}
+		}
+	}
+
+	void BoundProgram::emit(Op op, uint32_t index, int32_t onTrue, int32_t onFalse)
+	{
+		fCode.push_back({ op, index, onTrue, onFalse });
+	}
+
+	void BoundProgram::patch(size_t from, int32_t label)
+	{
+		int32_t end = (int32_t)fCode.size();
+		for (size_t i = from; i < fCode.size(); ++i) {
+			if (fCode[i].fOnTrue == label) {
+				fCode[i].fOnTrue = end;
+			}
+			if (fCode[i].fOnFalse == label) {
+				fCode[i].fOnFalse = end;
+			}
+		}
+	}
+
+	void BoundProgram::compile(Bound const* bound, int32_t onTrue, int32_t onFalse)
+	{
+		// exact types only, a derived bound may override onInBound
+		auto const& type = typeid(*bound);
+		fTree.emplace_back(bound, 0);
+		if (type == typeid(BoxBound)) {
+			auto b = static_cast<BoxBound const*>(bound);
+			emit(Op::Box, (uint32_t)fX0.size(), onTrue, onFalse);
+			fX0.push_back(b->fX0);
+			fX1.push_back(b->fX1);
+			fY0.push_back(b->fY0);
+			fY1.push_back(b->fY1);
+			fZ0.push_back(b->fZ0);
+			fZ1.push_back(b->fZ1);
+		} else if (type == typeid(PlaneBound)) {
+			auto b = static_cast<PlaneBound const*>(bound);
+			emit(Op::Plane, (uint32_t)fPX.size(), onTrue, onFalse);
+			fPX.push_back(b->fP.fX);
+			fPY.push_back(b->fP.fY);
+			fPZ.push_back(b->fP.fZ);
+			fPR.push_back(b->fR);
+		} else if (type == typeid(QuadricBound)) {
+			auto b = static_cast<QuadricBound const*>(bound);
+			emit(Op::Quadric, (uint32_t)fQ11.size(), onTrue, onFalse);
+			fQ11.push_back(b->fQ.fM11);
+			fQ12.push_back(b->fQ.fM12);
+			fQ13.push_back(b->fQ.fM13);
+			fQ22.push_back(b->fQ.fM22);
+			fQ23.push_back(b->fQ.fM23);
+			fQ33.push_back(b->fQ.fM33);
+			fQX.push_back(b->fP.fX);
+			fQY.push_back(b->fP.fY);
+			fQZ.push_back(b->fP.fZ);
+			fQR.push_back(b->fR);
+		} else if (type == typeid(AllBound)) {
+			auto& bounds = static_cast<AllBound const*>(bound)->fBounds;
+			fTree.back().second = bounds.size();
+			if (bounds.empty()) {
+				emit(Op::Const, 1, onTrue, onFalse);
+			}
+			// false at the first failed, the next one if passed
+			for (size_t i = 0; i < bounds.size(); ++i) {
+				if (i + 1 == bounds.size()) {
+					compile(bounds[i].get(), onTrue, onFalse);
+				} else {
+					size_t from = fCode.size();
+					int32_t next = kLabel - fLabels++;
+					compile(bounds[i].get(), next, onFalse);
+					patch(from, next);
+				}
+			}
+		} else if (type == typeid(AnyBound)) {
+			auto& bounds = static_cast<AnyBound const*>(bound)->fBounds;
+			fTree.back().second = bounds.size();
+			if (bounds.empty()) {
+				emit(Op::Const, 0, onTrue, onFalse);
+			}
+			for (size_t i = 0; i < bounds.size(); ++i) {
+				if (i + 1 == bounds.size()) {
+					compile(bounds[i].get(), onTrue, onFalse);
+				} else {
+					size_t from = fCode.size();
+					int32_t next = kLabel - fLabels++;
+					compile(bounds[i].get(), onTrue, next);
+					patch(from, next);
+				}
+			}
+		} else if (type == typeid(InverseBound)) {
+			auto b = static_cast<InverseBound const*>(bound);
+			if (!b->fBound) {
+				emit(Op::Const, 1, onTrue, onFalse);
+			} else {
+				fTree.back().second = 1;
+				compile(b->fBound.get(), onFalse, onTrue);
+			}
+		} else {
+			emit(Op::Call, (uint32_t)fCalls.size(), onTrue, onFalse);
+			fCalls.push_back(bound);
+		}
+	}
+
+	void BoundProgram::inBound(Vec3 const& p1, Vec3 const& p2, bool& in1, bool& in2) const
+	{
+		if (fCode.empty()) {
+			in1 = in2 = true;
+			return;
+		}
+		if (!fTable.empty()) {
+			uint32_t mask1 = 0;
+			uint32_t mask2 = 0;
+			for (size_t k = 0; k < fCode.size(); ++k) {
+				mask1 |= (uint32_t)test(fCode[k], p1) << k;
+				mask2 |= (uint32_t)test(fCode[k], p2) << k;
+			}
+			in1 = (fTable[mask1 >> 6] >> (mask1 & 63)) & 1;
+			in2 = (fTable[mask2 >> 6] >> (mask2 & 63)) & 1;
+			return;
+		}
+		int32_t pc1 = 0;
+		int32_t pc2 = 0;
+		while (pc1 >= 0 && pc1 == pc2) {
+			Instruction const& ins = fCode[pc1];
+			pc1 = test(ins, p1) ? ins.fOnTrue : ins.fOnFalse;
+			pc2 = test(ins, p2) ? ins.fOnTrue : ins.fOnFalse;
+		}
+		while (pc1 >= 0) {
+			Instruction const& ins = fCode[pc1];
+			pc1 = test(ins, p1) ? ins.fOnTrue : ins.fOnFalse;
+		}
+		while (pc2 >= 0) {
+			Instruction const& ins = fCode[pc2];
+			pc2 = test(ins, p2) ? ins.fOnTrue : ins.fOnFalse;
+		}
+		in1 = pc1 == kTrue;
+		in2 = pc2 == kTrue;
+	}
+
+}
@@ -0,0 +1,158 @@
+#ifndef SRT_BOUNDPROGRAM_H
+#define SRT_BOUNDPROGRAM_H
+
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include "Real.h"
+#include "Vec3.h"
+#include "Bound.h"
+#include "Quadric.h"
+
+namespace srt {
+
+	// a bound tree compiled into a flat program, evaluated without virtual calls.
+	// box, plane and quadric bounds are kept in arrays by kind, all/any/inverse
+	// become jumps (short circuit), other bounds are called through inBound().
+	// a small tree without calls is evaluated without jumps: all the tests
+	// are done, and the bits of the results index a truth table.
+	// the tree is read when compiled, compile again after changing it.
+	// same() tells whether it was changed.
+	struct BoundProgram {
+
+		BoundProgram() = default;
+		explicit BoundProgram(Bound const* bound);
+
+		// nullptr: no bound
+		void compile(Bound const* bound);
+		bool empty() const;
+		// compiling bound as it is now gives this program
+		bool same(Bound const* bound) const;
+
+		bool inBound(Vec3 const& p) const;
+		// two points (e.g. the roots of a quadric) at once,
+		// an instruction is decoded once while both take the same path
+		void inBound(Vec3 const& p1, Vec3 const& p2, bool& in1, bool& in2) const;
+
+	private:
+		enum class Op : uint8_t {
+			Const,
+			Box,
+			Plane,
+			Quadric,
+			Call,
+		};
+
+		// jump targets: >= 0 is an instruction, then the results,
+		// <= kLabel are labels while compiling
+		static constexpr int32_t kTrue = -1;
+		static constexpr int32_t kFalse = -2;
+		static constexpr int32_t kLabel = -3;
+		// at most 2^kTableTests bits in the truth table
+		static constexpr size_t kTableTests = 10;
+
+		struct Instruction {
+			Op fOp;
+			// into the arrays of fOp, the value of a Const
+			uint32_t fIndex;
+			int32_t fOnTrue;
+			int32_t fOnFalse;
+		};
+
+		// where same() is in the tree and in the arrays
+		struct Cursor {
+			size_t fNode = 0;
+			size_t fBox = 0;
+			size_t fPlane = 0;
+			size_t fQuadric = 0;
+		};
+
+		void compile(Bound const* bound, int32_t onTrue, int32_t onFalse);
+		bool same(Bound const* bound, Cursor& at) const;
+		void emit(Op op, uint32_t index, int32_t onTrue, int32_t onFalse);
+		// jumps to label in [from, end) go to the end
+		void patch(size_t from, int32_t label);
+		void buildTable();
+		bool test(Instruction const& ins, Vec3 const& p) const;
+		// run the jumps, with the results of the tests in mask bits
+		bool run(uint32_t mask) const;
+
+		std::vector<Instruction> fCode;
+		int32_t fLabels = 0;
+		// bit m: the result for test results m, empty if not used
+		std::vector<uint64_t> fTable;
+
+		// boxes, x0 < x < x1 ...
+		std::vector<Real> fX0, fX1, fY0, fY1, fZ0, fZ1;
+		// planes, <P,x> + R < 0
+		std::vector<Real> fPX, fPY, fPZ, fPR;
+		// quadrics, <Qx,x> + <P,x> + R < 0
+		std::vector<Real> fQ11, fQ12, fQ13, fQ22, fQ23, fQ33;
+		std::vector<Real> fQX, fQY, fQZ, fQR;
+		std::vector<Bound const*> fCalls;
+		// the nodes of the tree in compile order, with their number of children
+		std::vector<std::pair<Bound const*, size_t>> fTree;
+	};
+
+}
+
+// implementation
+namespace srt {
+
+	inline BoundProgram::BoundProgram(Bound const* bound)
+	{
+		compile(bound);
+	}
+
+	inline bool BoundProgram::empty() const
+	{
+		return fCode.empty();
+	}
+
+	inline bool BoundProgram::test(Instruction const& ins, Vec3 const& p) const
+	{
+		uint32_t i = ins.fIndex;
+		switch (ins.fOp) {
+		case Op::Box:
+			// no short circuit, the compares are cheaper than mispredictions
+			return (p.fX > fX0[i]) & (p.fX < fX1[i]) &
+				(p.fY > fY0[i]) & (p.fY < fY1[i]) &
+				(p.fZ > fZ0[i]) & (p.fZ < fZ1[i]);
+		case Op::Plane:
+			// same arithmetic as Plane::inner
+			return dot(Vec3{ fPX[i], fPY[i], fPZ[i] }, p) + fPR[i] < 0;
+		case Op::Quadric:
+		{
+			SymMatrix3X3 q(fQ11[i], fQ12[i], fQ13[i], fQ22[i], fQ23[i], fQ33[i]);
+			return dot(dot(q, p), p) + dot(Vec3{ fQX[i], fQY[i], fQZ[i] }, p) + fQR[i] < 0.;
+		}
+		case Op::Call:
+			return fCalls[i]->inBound(p);
+		default:
+			return i != 0;
+		}
+	}
+
+	inline bool BoundProgram::inBound(Vec3 const& p) const
+	{
+		if (fCode.empty()) {
+			return true;
+		}
+		if (!fTable.empty()) {
+			uint32_t mask = 0;
+			for (size_t k = 0; k < fCode.size(); ++k) {
+				mask |= (uint32_t)test(fCode[k], p) << k;
+			}
+			return (fTable[mask >> 6] >> (mask & 63)) & 1;
+		}
+		int32_t pc = 0;
+		do {
+			Instruction const& ins = fCode[pc];
+			pc = test(ins, p) ? ins.fOnTrue : ins.fOnFalse;
+		} while (pc >= 0);
+		return pc == kTrue;
+	}
+
+}
+
+#endif
@@ -15,6 +15,15 @@ namespace srt {
 		return true;
 	}
 
+	AABB AllBound::boundingBox() const
+	{
+		AABB box = AABB::infinite();
+		for (auto& b : fBounds) {
+			box.intersect(b->boundingBox());
+		}
+		return box;
+	}
+
 	void AnyBound::addBound(std::shared_ptr<Bound> b)
 	{
 		fBounds.push_back(std::move(b));
@@ -28,6 +37,15 @@ namespace srt {
 		return false;
 	}
 
+	AABB AnyBound::boundingBox() const
+	{
+		AABB box;
+		for (auto& b : fBounds) {
+			box.extend(b->boundingBox());
+		}
+		return box;
+	}
+
 	InverseBound::InverseBound(std::shared_ptr<Bound> b) :
 		fBound(std::move(b)) {
 	}
@@ -39,6 +39,14 @@ namespace srt {
 				p.fY > fY0 && p.fY < fY1&&
 				p.fZ > fZ0 && p.fZ < fZ1;
 		}
+
+		AABB boundingBox() const override
+		{
+			AABB b;
+			b.fMin = { fX0, fY0, fZ0 };
+			b.fMax = { fX1, fY1, fZ1 };
+			return b;
+		}
 	};
 
 	inline std::shared_ptr<Bound> boxBound(Real x0, Real x1, Real y0, Real y1, Real z0, Real z1)
@@ -67,6 +75,7 @@ namespace srt {
 	struct AllBound : Bound {
 
 		bool onInBound(Vec3 const& p) const override;
+		AABB boundingBox() const override;
 		void addBound(std::shared_ptr<Bound> b);
 
 		std::vector<std::shared_ptr<Bound>> fBounds;
@@ -76,6 +85,7 @@ namespace srt {
 
 		void addBound(std::shared_ptr<Bound> b);
 		bool onInBound(Vec3 const& p) const override;
+		AABB boundingBox() const override;
 
 		std::vector<std::shared_ptr<Bound>> fBounds;
 	};
@@ -0,0 +1,200 @@
+#include "CSG.h"
+#include "Surfaces.h"
+#include <algorithm>
+
+namespace srt {
+
+	void CSG::addSurface(std::shared_ptr<Surface> surf)
+	{
+		fSurfaces.push_back(std::move(surf));
+	}
+
+	void CSG::refresh() const
+	{
+		Surface::refresh();
+		for (auto& s : fSurfaces) {
+			s->refresh();
+		}
+	}
+
+	// first: the first member is inner, rest: number of other inner members
+	static bool combineStates(CSGOp op, size_t members, bool first, size_t rest)
+	{
+		if (op == CSGOp::Intersection) {
+			return first && rest + 1 == members;
+		} else if (op == CSGOp::Union) {
+			return first || rest > 0;
+		} else {
+			return first && rest == 0;
+		}
+	}
+
+	bool CSG::isInner(Vec3 const& p) const
+	{
+		if (fSurfaces.empty()) {
+			return false;
+		}
+		bool first = fSurfaces[0]->isInner(p);
+		size_t rest = 0;
+		for (size_t i = 1; i < fSurfaces.size(); ++i) {
+			rest += fSurfaces[i]->isInner(p);
+		}
+		return combineStates(fOp, fSurfaces.size(), first, rest);
+	}
+
+	// walk the crossings of the combined solid along the ray,
+	// f(crossing) returns false to stop
+	template<class F>
+	static void walkCrossings(CSGOp op,
+		std::vector<std::shared_ptr<Surface>> const& surfaces,
+		Ray const& ray, F&& f)
+	{
+		constexpr int K = Surface::kMaxCrossings;
+		constexpr size_t kInlineMembers = 16;
+
+		struct Event {
+			Real fS;
+			uint32_t fIndex;
+		};
+
+		size_t m = surfaces.size();
+		if (m == 0) {
+			return;
+		}
+
+		Crossing inlineCrossings[kInlineMembers * K];
+		Event inlineEvents[kInlineMembers * K];
+		bool inlineInner[kInlineMembers];
+		std::vector<Crossing> heapCrossings;
+		std::vector<Event> heapEvents;
+		std::vector<char> heapInner;
+		Crossing* crossings = inlineCrossings;
+		Event* events = inlineEvents;
+		bool* inner = inlineInner;
+		if (m > kInlineMembers) {
+			heapCrossings.resize(m * K);
+			heapEvents.resize(m * K);
+			heapInner.resize(m);
+			crossings = heapCrossings.data();
+			events = heapEvents.data();
+			inner = (bool*)heapInner.data();
+		}
+
+		size_t nEvents = 0;
+		size_t rest = 0;
+		for (size_t i = 0; i < m; ++i) {
+			Crossing* c = crossings + i * K;
+			int n = surfaces[i]->crossings(ray, c, K);
+			for (int k = 0; k < n; ++k) {
+				events[nEvents++] = { c[k].fS, (uint32_t)(i * K + k) };
+			}
+			// before its first crossing, the ray is inner if it goes out there
+			inner[i] = n > 0 ? c[0].fOut : surfaces[i]->isInner(ray.fO);
+			if (i > 0) {
+				rest += inner[i];
+			}
+		}
+		if (nEvents == 0) {
+			return;
+		}
+		std::sort(events, events + nEvents, [](Event const& a, Event const& b) {
+			return a.fS < b.fS;
+		});
+
+		// crossings at the same distance (e.g. shared planes) are applied
+		// together, the solid is crossed only if the state changes over all
+		bool state = combineStates(op, m, inner[0], rest);
+		for (size_t e = 0; e < nEvents; ) {
+			Real s = events[e].fS;
+			Crossing hit{};
+			bool changed = false;
+			for (; e < nEvents && events[e].fS == s; ++e) {
+				Crossing const& c = crossings[events[e].fIndex];
+				size_t i = events[e].fIndex / K;
+				bool now = !c.fOut;
+				if (now == inner[i]) {
+					continue;
+				}
+				inner[i] = now;
+				if (i > 0) {
+					rest += now ? 1 : -1;
+				}
+				if (!changed && combineStates(op, m, inner[0], rest) != state) {
+					hit = c;
+					changed = true;
+				}
+			}
+			bool newState = combineStates(op, m, inner[0], rest);
+			if (changed && newState != state) {
+				hit.fOut = state;
+				state = newState;
+				if (!f(hit)) {
+					return;
+				}
+			}
+		}
+	}
+
+	int CSG::crossings(Ray const& ray, Crossing* out, int max) const
+	{
+		int n = 0;
+		if (max <= 0) {
+			return 0;
+		}
+		walkCrossings(fOp, fSurfaces, ray, [&](Crossing const& c) {
+			out[n++] = c;
+			return n < max;
+		});
+		return n;
+	}
+
+	void CSG::process(Ray const& ray,
+		ProcessHandler& handler) const
+	{
+		walkCrossings(fOp, fSurfaces, ray, [&](Crossing const& c) {
+			Vec3 inter = ray.fO + ray.fD * c.fS;
+			if (!getBoundProgram().inBound(inter)) {
+				return true;
+			}
+			if (handler.fType == HandlerType::Distance) {
+				static_cast<DistanceHandler&>(handler).distance(c.fS, c.fIn2out);
+			} else if (handler.fType == HandlerType::Tracing) {
+				static_cast<TracingHandler&>(handler).hitSurface(inter,
+					normalize(c.fN), c.fIn2out, c.fSurface, c.fSurface);
+			}
+			return false;
+		});
+	}
+
+	static std::shared_ptr<CSG> makeCSG(CSGOp op,
+		std::initializer_list<std::shared_ptr<Surface>> surfaces)
+	{
+		auto c = std::make_shared<CSG>(op);
+		for (auto& s : surfaces) {
+			c->addSurface(s);
+		}
+		return c;
+	}
+
+	std::shared_ptr<CSG> csgIntersection(std::initializer_list<std::shared_ptr<Surface>> surfaces)
+	{
+		return makeCSG(CSGOp::Intersection, surfaces);
+	}
+
+	std::shared_ptr<CSG> csgUnion(std::initializer_list<std::shared_ptr<Surface>> surfaces)
+	{
+		return makeCSG(CSGOp::Union, surfaces);
+	}
+
+	std::shared_ptr<CSG> csgDifference(std::shared_ptr<Surface> a,
+		std::initializer_list<std::shared_ptr<Surface>> surfaces)
+	{
+		auto c = std::make_shared<CSG>(CSGOp::Difference);
+		c->addSurface(std::move(a));
+		for (auto& s : surfaces) {
+			c->addSurface(s);
+		}
+		return c;
+	}
+
+}
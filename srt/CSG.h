@@ -0,0 +1,54 @@
+#ifndef SRT_CSG_H
+#define SRT_CSG_H
+
+#include <memory>
+#include <vector>
+#include "Vec3.h"
+#include "Surface.h"
+
+namespace srt {
+
+	enum class CSGOp {
+		// inner to all the surfaces
+		Intersection,
+		// inner to any of the surfaces
+		Union,
+		// inner to the first surface, but not to any of the others
+		Difference,
+	};
+
+	// constructive solid geometry over the inner sides of surfaces.
+	// every member is asked for its crossings once per ray, the
+	// crossings are merged along the ray and the op is applied to the
+	// inner/outer states. a hit reports the member surface (with its
+	// properties, normal and side), as if the member was hit alone.
+	// bounds of members are ignored, set the bound of the CSG instead.
+	// (a member relying on the default Surface::crossings keeps the
+	// bound its process() applies)
+	struct CSG : Surface
+	{
+		CSG(CSGOp op) : fOp(op) {}
+
+		void addSurface(std::shared_ptr<Surface> surf);
+		CSGOp op() const { return fOp; }
+
+		bool isInner(Vec3 const& p) const override;
+		void process(Ray const& ray,
+			ProcessHandler& handler) const override;
+		int crossings(Ray const& ray, Crossing* out, int max) const override;
+		void refresh() const override;
+
+	private:
+		CSGOp fOp;
+		std::vector<std::shared_ptr<Surface>> fSurfaces;
+	};
+
+	std::shared_ptr<CSG> csgIntersection(std::initializer_list<std::shared_ptr<Surface>> surfaces);
+	std::shared_ptr<CSG> csgUnion(std::initializer_list<std::shared_ptr<Surface>> surfaces);
+	// a minus all the others
+	std::shared_ptr<CSG> csgDifference(std::shared_ptr<Surface> a,
+		std::initializer_list<std::shared_ptr<Surface>> surfaces);
+
+}
+
+#endif
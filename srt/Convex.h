@@ -1,19 +1,14 @@
 #pragma once
 
 #include "Vec3.h"
-#include "Surface.h"
+#include "CSG.h"
 
 namespace srt {
 
-	struct Convex : Surface
+	// intersection of the inner sides of the surfaces
+	struct Convex : CSG
 	{
-		void addSurface(std::shared_ptr<Surface> surf);
-		bool isInner(Vec3 const& p) const override;
-		void process(Ray const& ray,
-			ProcessHandler& handler) const override;
-
-	private:
-		std::vector<std::shared_ptr<Surface>> fSurfaces;
+		Convex() : CSG(CSGOp::Intersection) {}
 	};
 
 	std::shared_ptr<Convex> convex(std::initializer_list<std::shared_ptr<Surface>> surfaces);
@@ -0,0 +1,244 @@
+#include "Deflate.h"
+#include <string.h>
+#include <algorithm>
+
+namespace srt {
+
+	// writes bits lsb first
+	struct BitWriter {
+		std::vector<uint8_t>& out;
+		uint32_t bits = 0;
+		int count = 0;
+
+		void put(uint32_t v, int n)
+		{
+			bits |= v << count;
+			count += n;
+			while (count >= 8) {
+				out.push_back((uint8_t)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		// huffman codes are defined msb first
+		void putCode(uint32_t code, int n)
+		{
+			uint32_t r = 0;
+			for (int i = 0; i < n; ++i) {
+				r = (r << 1) | ((code >> i) & 1);
+			}
+			put(r, n);
+		}
+
+		void align()
+		{
+			if (count > 0) {
+				put(0, 8 - count);
+			}
+		}
+	};
+
+	static constexpr int kLengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+	};
+	static constexpr int kLengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+	};
+	static constexpr int kDistBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+	};
+	static constexpr int kDistExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+	};
+
+	// fixed huffman code of a literal/length symbol
+	static void putSymbol(BitWriter& bw, int sym)
+	{
+		if (sym < 144) {
+			bw.putCode(0x30 + sym, 8);
+		} else if (sym < 256) {
+			bw.putCode(0x190 + sym - 144, 9);
+		} else if (sym < 280) {
+			bw.putCode(sym - 256, 7);
+		} else {
+			bw.putCode(0xC0 + sym - 280, 8);
+		}
+	}
+
+	static void putMatch(BitWriter& bw, int len, int dist)
+	{
+		int l = 28;
+		while (kLengthBase[l] > len) {
+			--l;
+		}
+		putSymbol(bw, 257 + l);
+		if (kLengthExtra[l]) {
+			bw.put(len - kLengthBase[l], kLengthExtra[l]);
+		}
+
+		int d = 29;
+		while (kDistBase[d] > dist) {
+			--d;
+		}
+		bw.putCode(d, 5);
+		if (kDistExtra[d]) {
+			bw.put(dist - kDistBase[d], kDistExtra[d]);
+		}
+	}
+
+	void deflateBlock(uint8_t const* data, size_t size, bool final,
+		std::vector<uint8_t>& out)
+	{
+		constexpr int kWindow = 1 << 15;
+		constexpr int kHashBits = 15;
+		constexpr int kMaxChain = 32;
+		constexpr int kMinMatch = 3;
+		constexpr int kMaxMatch = 258;
+		// "good enough" match, stop searching
+		constexpr int kNiceMatch = 128;
+
+		BitWriter bw{ out };
+		// header: BFINAL, BTYPE = 01 (fixed huffman)
+		bw.put(final ? 1 : 0, 1);
+		bw.put(1, 2);
+
+		std::vector<int32_t> head(1 << kHashBits, -1);
+		std::vector<int32_t> prev(kWindow, -1);
+		auto hash = [&](size_t i) {
+			uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+			return (v * 2654435761u) >> (32 - kHashBits);
+		};
+		auto insert = [&](size_t i) {
+			uint32_t h = hash(i);
+			prev[i & (kWindow - 1)] = head[h];
+			head[h] = (int32_t)i;
+		};
+
+		size_t i = 0;
+		while (i < size) {
+			int bestLen = 0;
+			int bestDist = 0;
+			if (i + kMinMatch <= size) {
+				int maxLen = (int)std::min<size_t>(kMaxMatch, size - i);
+				int32_t cand = head[hash(i)];
+				for (int chain = 0; cand >= 0 && chain < kMaxChain; ++chain) {
+					size_t dist = i - cand;
+					if (dist > kWindow - 1 || dist == 0) {
+						break;
+					}
+					uint8_t const* a = data + cand;
+					uint8_t const* b = data + i;
+					if (a[bestLen] == b[bestLen]) {
+						int len = 0;
+						while (len < maxLen && a[len] == b[len]) {
+							++len;
+						}
+						if (len > bestLen) {
+							bestLen = len;
+							bestDist = (int)dist;
+							if (len >= kNiceMatch || len == maxLen) {
+								break;
+							}
+						}
+					}
+					int32_t next = prev[cand & (kWindow - 1)];
+					// the slot was reused by a newer position
+					if (next >= cand) {
+						break;
+					}
+					cand = next;
+				}
+				insert(i);
+			}
+
+			if (bestLen >= kMinMatch) {
+				putMatch(bw, bestLen, bestDist);
+				for (size_t k = i + 1; k < i + bestLen && k + kMinMatch <= size; ++k) {
+					insert(k);
+				}
+				i += bestLen;
+			} else {
+				putSymbol(bw, data[i]);
+				i += 1;
+			}
+		}
+		// end of block
+		putSymbol(bw, 256);
+
+		if (final) {
+			bw.align();
+		} else {
+			// empty stored block
+			bw.put(0, 3);
+			bw.align();
+			out.push_back(0x00);
+			out.push_back(0x00);
+			out.push_back(0xFF);
+			out.push_back(0xFF);
+		}
+	}
+
+	static constexpr uint32_t kAdlerBase = 65521;
+
+	uint32_t adler32(uint32_t adler, uint8_t const* data, size_t size)
+	{
+		uint32_t s1 = adler & 0xFFFF;
+		uint32_t s2 = adler >> 16;
+		while (size > 0) {
+			// the largest n such that s2 can't overflow
+			size_t n = std::min<size_t>(size, 5552);
+			size -= n;
+			for (size_t k = 0; k < n; ++k) {
+				s1 += data[k];
+				s2 += s1;
+			}
+			data += n;
+			s1 %= kAdlerBase;
+			s2 %= kAdlerBase;
+		}
+		return (s2 << 16) | s1;
+	}
+
+	uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+	{
+		uint32_t rem = (uint32_t)(len2 % kAdlerBase);
+		uint32_t sum1 = adler1 & 0xFFFF;
+		uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % kAdlerBase);
+		sum1 += (adler2 & 0xFFFF) + kAdlerBase - 1;
+		sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - rem;
+		sum1 %= kAdlerBase;
+		sum2 %= kAdlerBase;
+		return (sum2 << 16) | sum1;
+	}
+
+	struct CRCTable {
+		uint32_t fTable[256];
+
+		CRCTable()
+		{
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				fTable[n] = c;
+			}
+		}
+	};
+
+	uint32_t crc32(uint32_t crc, uint8_t const* data, size_t size)
+	{
+		static const CRCTable table;
+		uint32_t c = crc ^ 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; ++i) {
+			c = table.fTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+		}
+		return c ^ 0xFFFFFFFFu;
+	}
+
+}
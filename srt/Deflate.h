@@ -0,0 +1,26 @@
+#ifndef SRT_DEFLATE_H
+#define SRT_DEFLATE_H
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace srt {
+
+	// raw deflate (rfc1951) of data as one block with fixed huffman codes.
+	// the output is byte aligned, unless final it ends with an empty stored
+	// block (sync flush), so independently compressed parts can be concatenated.
+	void deflateBlock(uint8_t const* data, size_t size, bool final,
+		std::vector<uint8_t>& out);
+
+	// adler32 of zlib, start with adler = 1
+	uint32_t adler32(uint32_t adler, uint8_t const* data, size_t size);
+	// adler32 of the concatenation, len2 is the length of the second part
+	uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2);
+
+	// crc32 of png/zlib, start with crc = 0
+	uint32_t crc32(uint32_t crc, uint8_t const* data, size_t size);
+
+}
+
+#endif
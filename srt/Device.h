@@ -6,6 +6,7 @@
 #include "Vec3.h"
 #include "Ray.h"
 #include "SurfaceProperties.h"
+#include "BVH.h"
 
 namespace srt {
 	struct Device;
@@ -72,6 +73,14 @@ namespace srt {
 		}
 	};
 	
+	// terms of a device depending only on the ray origin, computed once
+	// for many rays from the same origin
+	struct OriginTerms {
+		Vec3 fO;
+		Vec3 fV;
+		Real fC;
+	};
+
 	struct Device
 	{
 		std::string const& getName() const;
@@ -91,6 +100,22 @@ namespace srt {
 		}
 
 		virtual void process(Ray const& in, ProcessHandler& handler) const = 0;
+
+		// a box containing all the hits, the engine puts bounded devices
+		// in a BVH and tests the others for every ray
+		virtual AABB boundingBox() const;
+
+		// fill the terms for rays from o, false if the device has none.
+		// opt-in: a device overriding process() overrides both or
+		// returns false here
+		virtual bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const;
+		// same as process(), for a ray from terms.fO
+		virtual void processFrom(Ray const& in, OriginTerms const& terms,
+			ProcessHandler& handler) const;
+
+		// called by the engine before tracing, from one thread: redo what
+		// was derived from parts that may have been edited in place
+		virtual void refresh() const;
 	private:
 		// not used
 		std::string fName;
@@ -107,5 +132,25 @@ namespace srt {
 		return fName;
 	}
 
+	inline AABB Device::boundingBox() const
+	{
+		return AABB::infinite();
+	}
+
+	inline bool Device::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		return false;
+	}
+
+	inline void Device::processFrom(Ray const& in, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		process(in, handler);
+	}
+
+	inline void Device::refresh() const
+	{
+	}
+
 }
 #endif
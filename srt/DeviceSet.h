@@ -0,0 +1,57 @@
+#ifndef SRT_DEVICESET_H
+#define SRT_DEVICESET_H
+
+#include <stdint.h>
+#include <vector>
+#include "BVH.h"
+#include "Device.h"
+#include "Ray.h"
+
+namespace srt {
+
+	// devices with a bounded box are kept in a BVH,
+	// the others are tested for every ray.
+	// the engine keeps one for its devices, it's rebuilt after they changed
+	struct DeviceSet {
+		std::vector<Device*> unbounded;
+		// ordered as the leaves of nodes
+		std::vector<Device*> bounded;
+		std::vector<BVHNode> nodes;
+		// the index of the device in the devices given, indexed as at()
+		std::vector<uint32_t> order;
+		// the devices given and their boxes, see matches()
+		std::vector<Device*> devices;
+		std::vector<AABB> boxes;
+
+		explicit DeviceSet(std::vector<Device*> const& devs);
+
+		// built from these devices, and none of them moved out of its box.
+		// the BVH only depends on the boxes
+		bool matches(std::vector<Device*> const& devs) const;
+
+		// unbounded devices first, then the bounded
+		size_t size() const;
+		Device* at(size_t i) const;
+
+		// the device hit first by the ray and the distance s, nullptr if none
+		Device* nearest(Ray const& ray, Real& s) const;
+	};
+
+}
+
+// implementation
+namespace srt {
+
+	inline size_t DeviceSet::size() const
+	{
+		return unbounded.size() + bounded.size();
+	}
+
+	inline Device* DeviceSet::at(size_t i) const
+	{
+		return i < unbounded.size() ? unbounded[i] : bounded[i - unbounded.size()];
+	}
+
+}
+
+#endif
@@ -7,15 +7,27 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <mutex>
+#include <chrono>
+#include <map>
+#include <format>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "Pars.h"
 #include "Device.h"
 #include "Random.h"
 #include "Engine.h"
 #include "Recorder.h"
+#include "RecorderQueue.h"
 #include "Source.h"
 #include "Scaler.h"
 #include "MirrorReflect.h"
+#include "BVH.h"
+#include "DeviceSet.h"
 
 namespace srt {
 
@@ -45,51 +57,302 @@ namespace srt {
 		Ray ray;
 	};
 
-	static Device* minSDevice(std::vector<Device*>& devs,
+	// a cycle counter read still costs some ns, so only every
+	// kTimedHit-th hit is timed, its time is counted kTimedHit times
+	constexpr uint32_t kTimedHit = 64;
+
+	static inline uint64_t traceTicks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static bool sameBox(AABB const& a, AABB const& b)
+	{
+		return a.fMin.fX == b.fMin.fX && a.fMin.fY == b.fMin.fY && a.fMin.fZ == b.fMin.fZ
+			&& a.fMax.fX == b.fMax.fX && a.fMax.fY == b.fMax.fY && a.fMax.fZ == b.fMax.fZ;
+	}
+
+	DeviceSet::DeviceSet(std::vector<Device*> const& devs) : devices(devs)
+	{
+		std::vector<uint32_t> inBox;
+		std::vector<AABB> inBoxes;
+		for (uint32_t i = 0; i < devs.size(); ++i) {
+			AABB box = devs[i]->boundingBox();
+			boxes.push_back(box);
+			if (box.bounded()) {
+				inBox.push_back(i);
+				inBoxes.push_back(box);
+			} else if (!box.empty()) {
+				unbounded.push_back(devs[i]);
+				order.push_back(i);
+			}
+		}
+		if (!inBox.empty()) {
+			std::vector<uint32_t> leaves;
+			buildBVH(inBoxes, nodes, leaves);
+			bounded.resize(leaves.size());
+			for (size_t i = 0; i < leaves.size(); ++i) {
+				bounded[i] = devs[inBox[leaves[i]]];
+				order.push_back(inBox[leaves[i]]);
+			}
+		}
+	}
+
+	bool DeviceSet::matches(std::vector<Device*> const& devs) const
+	{
+		if (devs != devices) {
+			return false;
+		}
+		for (size_t i = 0; i < devs.size(); ++i) {
+			if (!sameBox(devs[i]->boundingBox(), boxes[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// calls the progress callback of a run at most every interval seconds,
+	// and checks its cancel token
+	struct ProgressMeter {
+		using clock = std::chrono::steady_clock;
+
+		std::function<void(Progress const&)> const& onProgress;
+		CancelToken const* cancel;
+		Real interval;
+		clock::time_point start = clock::now();
+		double last = -kInfity;
+		Progress progress;
+
+		ProgressMeter(std::function<void(Progress const&)> const& onProgress,
+			CancelToken const* cancel, Real interval, uint64_t total)
+			: onProgress(onProgress), cancel(cancel), interval(interval) {
+			progress.fTotal = total;
+		}
+
+		bool cancelled() const {
+			return cancel && cancel->cancelled();
+		}
+
+		// the end (force) is always reported, once
+		void update(uint64_t done, uint64_t rays, bool force = false) {
+			if (!onProgress) {
+				return;
+			}
+			double t = std::chrono::duration<double>(clock::now() - start).count();
+			if (force ? last >= 0 && done == progress.fDone : t - last < interval) {
+				return;
+			}
+			last = t;
+			progress.fDone = done;
+			progress.fRays = rays;
+			progress.fSeconds = t;
+			onProgress(progress);
+		}
+	};
+
+	// Device::process calls and ticks of a thread, indexed as DeviceSet::at
+	struct DeviceCounters {
+		std::vector<uint64_t> calls;
+		std::vector<uint64_t> ticks;
+
+		void reset(size_t n) {
+			calls.assign(n, 0);
+			ticks.assign(n, 0);
+		}
+
+		void add(size_t i, uint64_t t) {
+			calls[i] += 1;
+			ticks[i] += t;
+		}
+
+		DeviceCounters& operator+=(DeviceCounters const& r) {
+			for (size_t i = 0; i < calls.size(); ++i) {
+				calls[i] += r.calls[i];
+				ticks[i] += r.ticks[i];
+			}
+			return *this;
+		}
+	};
+
+	// origin dependent terms of the devices (indexed as DeviceSet::at),
+	// built when rays in a row come from the same origin, e.g. a pinhole
+	// camera or a point source
+	struct OriginCache {
+		std::vector<OriginTerms> terms;
+		std::vector<char> valid;
+		Vec3 origin{};
+		bool built = false;
+		Vec3 last{};
+		bool hasLast = false;
+
+		static bool same(Vec3 const& a, Vec3 const& b) {
+			return a.fX == b.fX && a.fY == b.fY && a.fZ == b.fZ;
+		}
+
+		// the ray from o is about to be traced
+		void observe(DeviceSet const& devs, Vec3 const& o) {
+			if (hasLast && same(o, last) && !(built && same(o, origin))) {
+				terms.resize(devs.size());
+				valid.resize(devs.size());
+				for (size_t i = 0; i < devs.size(); ++i) {
+					valid[i] = devs.at(i)->precomputeOrigin(o, terms[i]);
+				}
+				origin = o;
+				built = true;
+			}
+			last = o;
+			hasLast = true;
+		}
+
+		bool covers(Vec3 const& o) const {
+			return built && same(o, origin);
+		}
+
+		void process(Device const* dev, size_t i, Ray const& ray,
+			ProcessHandler& handler) const {
+			if (valid[i]) {
+				dev->processFrom(ray, terms[i], handler);
+			} else {
+				dev->process(ray, handler);
+			}
+		}
+	};
+
+	// cache: nullptr or covering the origin of the ray.
+	// the devices are tested in BVH order, the hits near the nearest one are
+	// then taken in the order the devices were added, so near ties (e.g. a
+	// screen on a lens face) go as when all the devices are tested in that
+	// order. hits beyond 2 gSmin of the nearest are left out, they could
+	// only win through a chain of near ties
+	static Device* minSDevice(DeviceSet const& devs,
 		Ray const& ray,
-		Real& ref_smin) {
-		Real smin = std::numeric_limits<Real>::infinity();
-		Device* smin_dev = nullptr;
-		bool smin_in2out = false;
+		Real& ref_smin,
+		OriginCache const* cache = nullptr,
+		size_t* ref_index = nullptr,
+		TraceStats* stats = nullptr,
+		DeviceCounters* prof = nullptr) {
+		struct Hit {
+			Real s;
+			bool in2out;
+			uint32_t order;
+			size_t index;
+		};
+		// the hits within 2 gSmin of the nearest so far
+		constexpr int kMaxHits = 32;
+		Hit hits[kMaxHits];
+		int nHits = 0;
+		Real nearest = kInfity;
 
 		DistanceHandler handler;
 
-		for (size_t dev_idx = 0; dev_idx < devs.size(); ++dev_idx) {
-			Device* dev = devs[dev_idx];
-
+		auto test = [&](Device* dev, size_t index) {
 			handler.fDistance = kInfity;
-			dev->process(ray, handler);
+			uint64_t t0 = prof ? traceTicks() : 0;
+			if (cache) {
+				cache->process(dev, index, ray, handler);
+			} else {
+				dev->process(ray, handler);
+			}
+			if (prof) {
+				prof->add(index, traceTicks() - t0);
+			}
 			Real s = handler.fDistance;
+			if (!(s < nearest + 2 * gSmin)) {
+				return;
+			}
+			if (s < nearest) {
+				nearest = s;
+				int k = 0;
+				for (int j = 0; j < nHits; ++j) {
+					if (hits[j].s < nearest + 2 * gSmin) {
+						hits[k++] = hits[j];
+					}
+				}
+				nHits = k;
+			}
+			// more than kMaxHits coincident devices: the farthest is dropped
+			if (nHits == kMaxHits) {
+				int far = 0;
+				for (int j = 1; j < nHits; ++j) {
+					if (hits[j].s > hits[far].s) {
+						far = j;
+					}
+				}
+				if (!(s < hits[far].s)) {
+					return;
+				}
+				hits[far] = hits[--nHits];
+			}
+			hits[nHits++] = { s, handler.fIn2out, devs.order[index], index };
+		};
 
-			if (!std::isinf(s)) {
-				if (s < smin - gSmin) {
-					smin = s;
-					smin_dev = dev;
-					smin_in2out = handler.fIn2out;
-				} else if (s < smin + gSmin
-					&& !handler.fIn2out
-					&& smin_in2out) {
-					smin = s;
-					smin_dev = dev;
-					smin_in2out = handler.fIn2out;
-				} else if (s < smin) {
-					smin = s;
-					smin_dev = dev;
-					smin_in2out = handler.fIn2out;
+		size_t tests = devs.unbounded.size();
+		for (size_t i = 0; i < devs.unbounded.size(); ++i) {
+			test(devs.unbounded[i], i);
+		}
+		Real limit = nearest + 2 * gSmin;
+		traverseBVH(devs.nodes.data(), devs.nodes.size(), ray.fO, ray.fD, limit,
+			[&](uint32_t first, uint32_t count, Real& smax) {
+				for (uint32_t i = first; i < first + count; ++i) {
+					test(devs.bounded[i], devs.unbounded.size() + i);
 				}
+				tests += count;
+				smax = nearest + 2 * gSmin;
+			});
+		if (stats) {
+			stats->fIntersectionTests += tests;
+		}
+
+		if (nHits > 1) {
+			std::sort(hits, hits + nHits, [](Hit const& a, Hit const& b) {
+				return a.order < b.order;
+			});
+		}
+		Real smin = kInfity;
+		Device* smin_dev = nullptr;
+		size_t smin_index = 0;
+		bool smin_in2out = false;
+		for (int j = 0; j < nHits; ++j) {
+			Hit const& h = hits[j];
+			if (h.s < smin - gSmin
+				|| (h.s < smin + gSmin && !h.in2out && smin_in2out)
+				|| h.s < smin) {
+				smin = h.s;
+				smin_dev = devs.at(h.index);
+				smin_index = h.index;
+				smin_in2out = h.in2out;
 			}
 		}
 		ref_smin = smin;
+		if (ref_index) {
+			*ref_index = smin_index;
+		}
 		return smin_dev;
 	}
 
-	static bool emitRay(std::vector<Device*>& devs,
+	static bool emitRay(DeviceSet const& devs,
 		Ray const& ray,
-		ProcessHandler& handler) {
+		ProcessHandler& handler,
+		OriginCache const* cache = nullptr,
+		TraceStats* stats = nullptr,
+		DeviceCounters* prof = nullptr) {
 		Real smin = kInfity;
-		Device* smin_dev = minSDevice(devs, ray, smin);
+		size_t index = 0;
+		Device* smin_dev = minSDevice(devs, ray, smin, cache, &index, stats, prof);
 		if (smin_dev) {
-			smin_dev->process(ray, handler);
+			uint64_t t0 = prof ? traceTicks() : 0;
+			if (cache) {
+				cache->process(smin_dev, index, ray, handler);
+			} else {
+				smin_dev->process(ray, handler);
+			}
+			if (prof) {
+				prof->add(index, traceTicks() - t0);
+			}
 			return true;
 		} else {
 			return false;
@@ -153,12 +416,6 @@ namespace srt {
 		}
 	};
 
-	struct TraceOpts {
-		int max_level = 100;
-		Real min_ray_amp = 1E-6;
-		int first_level_split = 1;
-	};
-
 	struct Frame {
 		Ray ray;
 		int level;
@@ -170,22 +427,53 @@ namespace srt {
 		TraceOpts opts;
 		TracingHandler handler;
 		Real pixelAmp;
-		std::vector<Device*>& devs;
-
-		void init_recorder(std::vector<Recorder*> const& recorders) {
-			if (recorders.size()) {
-				recorder = [&](Event e, Ray const& ray, int level, TracingHandler& th) {
-					for (auto r : recorders) {
-						r->record(e, ray, level, th);
-					}
-				};
+		TraceStats stats;
+		// hits so far, to time every kTimedHit-th one
+		uint32_t hits = 0;
+		DeviceSet const& devs;
+		// for a profiled picture, see RenderProfile
+		bool profiling = false;
+		DeviceCounters profile;
+		OriginCache origins;
+
+		RecorderQueue* queue = nullptr;
+		EventRingLease ring;
+		// recorders sampling the current ray, 0 if none
+		uint32_t recording = 0;
+		bool pushed = false;
+
+		RayTracing(DeviceSet const& devs,
+			RecorderQueue* queue) :devs(devs), queue(queue) {
+			if (queue) {
+				ring = queue->acquire();
 			}
 		}
-		std::function<void(Event e, Ray const& ray, int level, TracingHandler& th)> recorder;
 
-		RayTracing(std::vector<Device*>& devs,
-			std::vector<Recorder*>& recorders) :devs(devs) {
-			init_recorder(recorders);
+		void beginRecord() {
+			recording = queue ? queue->sampleRay() : 0;
+			pushed = false;
+		}
+
+		void record(Event e, Ray const& ray, int level) {
+			uint32_t m = recording & queue->recordersOf(e);
+			// the end is always pushed, so the consumer knows the ray is done
+			if (m == 0 && !(e == Event::End && pushed)) {
+				return;
+			}
+			RecordedEvent ev;
+			ev.fRay = ray;
+			ev.fInter = handler.inter;
+			ev.fN = handler.N;
+			ev.fProperty = handler.property;
+			ev.fDevice = handler.device;
+			ev.fRecorders = m;
+			ev.fLevel = level;
+			ev.fEvent = e;
+			ev.fHit = handler.hit;
+			ev.fInner = handler.inner;
+			ev.fPictrue = handler.pictrue;
+			ring.push(ev);
+			pushed = true;
 		}
 
 		void traceRay(Ray const& ray);
@@ -216,8 +504,8 @@ namespace srt {
 
 		void newRay(Ray const& nr, Event event) {
 			rt.frames.emplace_back(nr, the_level + 1);
-			if (rt.recorder) {
-				rt.recorder(event, nr, the_level + 1, rt.handler);
+			if (rt.recording) {
+				rt.record(event, nr, the_level + 1);
 			}
 			die = false;
 		}
@@ -230,6 +518,12 @@ namespace srt {
 			this->newRay(newRay, Event::Reflect);
 		}
 
+		void totalInternalReflection() {
+#if SRT_TRACE_STATS
+			rt.stats.fTotalInternalReflections += 1;
+#endif
+		}
+
 		void doMirrorTrans(Real trans,
 			Vec3 const& p) {
 			Vec3 td;
@@ -238,6 +532,8 @@ namespace srt {
 				Ray newRay(inter, td, trans * ray.fAmp, ray);
 				newRay.fP = p;
 				this->newRay(newRay, Event::Refract);
+			} else {
+				totalInternalReflection();
 			}
 		}
 
@@ -255,6 +551,8 @@ namespace srt {
 				Ray newRay(inter, td, trans * ray.fAmp, ray);
 				newRay.fP = randomNorm(td);
 				this->newRay(newRay, Event::Refract);
+			} else {
+				totalInternalReflection();
 			}
 		}
 
@@ -287,6 +585,8 @@ namespace srt {
 				Ray newRay(inter, rd, trans * ray.fAmp, ray);
 				newRay.fP = randomNorm(rd);
 				this->newRay(newRay, Event::Refract);
+			} else {
+				totalInternalReflection();
 			}
 		};
 
@@ -358,6 +658,11 @@ namespace srt {
 				}
 			}
 
+#if SRT_TRACE_STATS
+			bool timed = ++rt.hits % kTimedHit == 0;
+			uint64_t t0 = timed ? traceTicks() : 0;
+#endif
+
 			if (reflectType == ReflectType::Optical) {
 
 				Vec3 pr;
@@ -405,6 +710,7 @@ namespace srt {
 					reflect = R;
 					refract = T;
 				} else {
+					totalInternalReflection();
 					reflect = 1;
 					refract = 0;
 					pr = A_s * ns + A_p * cross(ns, reflectDirection(N, ray.fD));
@@ -499,9 +805,19 @@ namespace srt {
 
 			}
 
-			if (rt.recorder) {
+#if SRT_TRACE_STATS
+			rt.stats.fReflectHits[(int)reflectType] += 1;
+			if (timed) {
+				rt.stats.fReflectTicks[(int)reflectType] += (traceTicks() - t0) * kTimedHit;
+			}
+			if (die) {
+				rt.stats.fDied += 1;
+			}
+#endif
+
+			if (rt.recording) {
 				if (die) {
-					rt.recorder(Event::Die, ray, the_level + 1, handler);
+					rt.record(Event::Die, ray, the_level + 1);
 				}
 			}
 
@@ -514,9 +830,13 @@ namespace srt {
 
 	void RayTracing::traceRay(Ray const& ray) {
 		pixelAmp = 0.;
+		stats.fPrimaryRays += 1;
+		origins.observe(devs, ray.fO);
 		frames.emplace_back(ray, 0);
-		if (recorder)
-			recorder(Event::Generate, ray, 0, handler);
+		int depth = 0;
+		beginRecord();
+		if (recording)
+			record(Event::Generate, ray, 0);
 
 		for (; !frames.empty();) {
 
@@ -527,15 +847,29 @@ namespace srt {
 			int ray_level = frame.level;
 
 			if (!(ray_level <= opts.max_level && ray.fAmp >= opts.min_ray_amp)) {
+#if SRT_TRACE_STATS
+				stats.fCut += 1;
+#endif
 				continue;
 			} else {
 				handler.hit = false;
+				stats.fRays += 1;
+#if SRT_TRACE_STATS
+				depth = std::max(depth, ray_level);
+				stats.fRaysOfLevel[std::min(ray_level, TraceStats::kLevels - 1)] += 1;
+#endif
 
-				(void)emitRay(devs, ray, handler);
+				OriginCache const* cache = ray_level == 0
+					&& origins.covers(ray.fO) ? &origins : nullptr;
+				(void)emitRay(devs, ray, handler, cache, &stats,
+					profiling ? &profile : nullptr);
 
 				if (!handler.hit) {
-					if (recorder)
-						recorder(Event::Escape, ray, ray_level + 1, handler);
+#if SRT_TRACE_STATS
+					stats.fEscaped += 1;
+#endif
+					if (recording)
+						record(Event::Escape, ray, ray_level + 1);
 					continue;
 				}
 
@@ -546,53 +880,52 @@ namespace srt {
 
 		}
 
-		if (recorder)
-			recorder(Event::End, ray, 0, handler);
+#if SRT_TRACE_STATS
+		stats.fPathsOfDepth[std::min(depth, TraceStats::kLevels - 1)] += 1;
+#endif
+		(void)depth;
+		if (recording)
+			record(Event::End, ray, 0);
 
 	}
 
-	struct SourceSelecter : Source {
-
-		std::vector<Real> as;
-		std::vector<Source*>* srcs = nullptr;
-
-		SourceSelecter() : Source(0) {}
-
-		void initialize(std::vector<Source*>& src) {
-			srcs = &src;
-			as.resize(src.size());
-			fAmp = 0;
-			for (int i = 0; i < (int)src.size(); ++i) {
-				fAmp += src[i]->fAmp;
-				as[i] = fAmp;
-			}
-		}
-
-		Ray generate() override {
-			return getSource()->generate();
-		}
-
-		// get a source with prob prop to light power
-		Source* getSource() {
-			Real t = uniform(0, 1) * fAmp;
-			auto p = std::lower_bound(as.begin(), as.end(), t);
-			if (p == as.end()) {
-				p = std::prev(p);
+	void Engine::doEmit(int N, Source& src, EmitOpts const& opts) {
+		DeviceSet const& devs = deviceSet();
+		RayTracing rt(devs, recorderQueue());
+		ProgressMeter meter(opts.OnProgress, opts.Cancel, opts.ProgressInterval, N);
+		// rays between two checks of the progress
+		constexpr int kBatch = 1024;
+
+		fLastStatus = RunStatus::Completed;
+		int n = 0;
+		for (; n < N; ++n) {
+			if (n % kBatch == 0 && n) {
+				if (meter.cancelled()) {
+					fLastStatus = RunStatus::Cancelled;
+					break;
+				}
+				meter.update(n, rt.stats.fRays);
 			}
-			size_t idx = p - as.begin();
-			return (*srcs)[idx];
-		}
-	};
-
-	void Engine::doEmit(int N, Source& src) {
-		RayTracing rt(fDevices, fRecorders);
-
-		for (int n = 0; n < N; ++n) {
 			Ray ray = src.generate();
 			ray.fID = n;
 			rt.handler.record = true;
 			rt.traceRay(ray);
 		}
+		meter.update(n, rt.stats.fRays, true);
+		fLastStats = rt.stats;
+		if (fQueue) {
+			fQueue->drain();
+		}
+	}
+
+	RecorderQueue* Engine::recorderQueue() {
+		if (fRecorders.empty()) {
+			return nullptr;
+		}
+		if (!fQueue) {
+			fQueue = std::make_shared<RecorderQueue>(fRecorders);
+		}
+		return fQueue.get();
 	}
 
 	struct SingleRaySource : Source {
@@ -608,16 +941,20 @@ namespace srt {
 
 	void Engine::emit(Ray const& ray) {
 		SingleRaySource srs(ray);
-		doEmit(1, srs);
+		doEmit(1, srs, EmitOpts());
 	}
 
 	void Engine::emit(int N) {
+		emit(N, EmitOpts());
+	}
+
+	void Engine::emit(int N, EmitOpts const& opts) {
 		if (fSources.size() == 0) {
 			throw std::logic_error("want to emit however we have no source!");
 		}
 		SourceSelecter selecter;
 		selecter.initialize(fSources);
-		doEmit(N, selecter);
+		doEmit(N, selecter, opts);
 	}
 
 	Real transprent(Vec3 rayDirection,
@@ -657,7 +994,7 @@ namespace srt {
 	}
 
 
-	double lighting(std::vector<Device*>& fDevices,
+	double lighting(DeviceSet const& fDevices,
 		Vec3 inter,
 		Vec3 const& light,
 		Ray const& ray) {
@@ -741,14 +1078,16 @@ namespace srt {
 	}
 
 	Color pictureColor(Ray& ray,
-		std::vector<Device*>& fDevices,
+		DeviceSet const& fDevices,
 		TracingHandler& ph,
-		PictureOpts const& opts) {
+		PictureOpts const& opts,
+		TraceStats* stats = nullptr,
+		DeviceCounters* prof = nullptr) {
 		Color color = { 0,0,0,0 };
 		for (int i = 0; i < 999; ++i) {
 
 			ph.hit = false;
-			(void)emitRay(fDevices, ray, ph);
+			(void)emitRay(fDevices, ray, ph, nullptr, stats, prof);
 
 			if (ph.hit) {
 				ph.hit = false;
@@ -808,6 +1147,89 @@ namespace srt {
 	}
 
 
+	static void setPixelCost(RenderProfile& prof, int j, int i,
+		uint64_t ticks, uint64_t tests) {
+		Real t = (Real)ticks;
+		Real n = (Real)tests;
+		prof.fTicks.at(j, i) = Color(t, t, t, 1);
+		prof.fTests.at(j, i) = Color(n, n, n, 1);
+	}
+
+	static void collectDeviceCosts(RenderProfile& prof,
+		DeviceSet const& devs, DeviceCounters const& counters) {
+		std::map<std::string, RenderProfile::DeviceCost> byName;
+		for (size_t i = 0; i < devs.size(); ++i) {
+			std::string name = devs.at(i)->getName();
+			if (name.empty()) {
+				name = "(unnamed)";
+			}
+			auto& cost = byName[name];
+			cost.fName = name;
+			cost.fCalls += counters.calls[i];
+			cost.fTicks += counters.ticks[i];
+		}
+		prof.fDevices.clear();
+		for (auto& kv : byName) {
+			prof.fDevices.push_back(kv.second);
+		}
+		std::stable_sort(prof.fDevices.begin(), prof.fDevices.end(),
+			[](auto const& a, auto const& b) { return a.fTicks > b.fTicks; });
+	}
+
+	Bitmap RenderProfile::heatmap(Bitmap const& cost) {
+		Bitmap bmp;
+		bmp.resize(cost.fW, cost.fH);
+		Real m = cost.cmax();
+		for (size_t i = 0; i < cost.fC.size(); ++i) {
+			Real t = m > 0 ? 3 * cost.fC[i].R() / m : 0;
+			bmp.fC[i] = Color(std::clamp<Real>(t, 0, 1),
+				std::clamp<Real>(t - 1, 0, 1),
+				std::clamp<Real>(t - 2, 0, 1), 1);
+		}
+		return bmp;
+	}
+
+	std::string RenderProfile::report(size_t topDevices) const {
+		std::string s;
+		uint64_t total = 0;
+		for (auto const& d : fDevices) {
+			total += d.fTicks;
+		}
+		s += std::format("{:<30} {:>12} {:>8} {:>12}\n",
+			"device", "calls", "ticks%", "ticks/call");
+		for (size_t i = 0; i < fDevices.size() && i < topDevices; ++i) {
+			auto const& d = fDevices[i];
+			s += std::format("{:<30} {:>12} {:>7.1f}% {:>12.1f}\n",
+				d.fName, d.fCalls,
+				total ? 100. * d.fTicks / total : 0.,
+				d.fCalls ? double(d.fTicks) / d.fCalls : 0.);
+		}
+
+		// how uneven the pixels are
+		std::vector<Real> ticks;
+		for (auto const& c : fTicks.fC) {
+			ticks.push_back(c.R());
+		}
+		if (!ticks.empty()) {
+			std::sort(ticks.begin(), ticks.end());
+			double sum = 0;
+			for (Real t : ticks) {
+				sum += t;
+			}
+			double mean = sum / ticks.size();
+			Real p99 = ticks[std::min(ticks.size() - 1, ticks.size() * 99 / 100)];
+			// share of the time in the 1% most costly pixels
+			double top = 0;
+			for (size_t i = ticks.size() * 99 / 100; i < ticks.size(); ++i) {
+				top += ticks[i];
+			}
+			s += std::format("pixel ticks: mean {:.0f}, p99 {:.0f}, max {:.0f}, "
+				"{:.1f}% of the time in the top 1% pixels\n",
+				mean, p99, ticks.back(), sum > 0 ? 100 * top / sum : 0.);
+		}
+		return s;
+	}
+
 	void Engine::devicesPicture(Bitmap& bmp,
 		PictureOpts const& opts) {
 		bmp.resize(opts.Width, opts.High);
@@ -826,12 +1248,31 @@ namespace srt {
 		s.h = opts.High;
 
 		TracingHandler ph;
+		DeviceSet const& devs = deviceSet();
+
+		RenderProfile* prof = opts.Profile ? &fLastProfile : nullptr;
+		TraceStats stats;
+		DeviceCounters counters;
+		if (prof) {
+			prof->fTicks.resize(w, h);
+			prof->fTests.resize(w, h);
+			counters.reset(devs.size());
+		}
+		ProgressMeter meter(opts.OnProgress, opts.Cancel, opts.ProgressInterval, h);
+		int n = opts.AntiAliasLevel + 1;
 
+		fLastStatus = RunStatus::Completed;
 		for (int j = 0; j < h; ++j) {
+			if (meter.cancelled()) {
+				fLastStatus = RunStatus::Cancelled;
+				meter.update(j, uint64_t(j) * w * Sqr(n), true);
+				break;
+			}
 			for (int i = 0; i < w; ++i) {
 
+				uint64_t t0 = prof ? traceTicks() : 0;
+				uint64_t tests0 = stats.fIntersectionTests;
 				Color color = Color::black(0.);
-				int n = opts.AntiAliasLevel + 1;
 
 				for (int ii = 0; ii < n; ++ii) {
 					for (int jj = 0; jj < n; ++jj) {
@@ -844,16 +1285,26 @@ namespace srt {
 						ray.fLambda = 500;
 						ray.fP = Vec3{};
 
-						color += pictureColor(ray, fDevices, ph, opts);
+						color += pictureColor(ray, devs, ph, opts,
+							prof ? &stats : nullptr, prof ? &counters : nullptr);
 					}
 				}
 
 				color /= Sqr(n);
 				bmp.at(j, i) = color;
+				if (prof) {
+					setPixelCost(*prof, j, i, traceTicks() - t0,
+						stats.fIntersectionTests - tests0);
+				}
 
 			}
+			// the rays from the camera, their reflections are not traced
+			meter.update(j + 1, uint64_t(j + 1) * w * Sqr(n), j + 1 == h);
 		}
 
+		if (prof) {
+			collectDeviceCosts(*prof, devs, counters);
+		}
 	}
 
 	Bitmap Engine::devicesPicture(PictureOpts const& opts) {
@@ -872,7 +1323,8 @@ namespace srt {
 		void allocate_threads(Bitmap& bmp,
 			std::function<T(int jobID)> constructor,
 			std::function<void(T& rt, int hstart, int hend, int jobID)> callback,
-			bool print_new_line = false)
+			bool print_new_line = false,
+			CancelToken const* cancel = nullptr)
 		{
 			int total = std::thread::hardware_concurrency();
 			size_t w = bmp.fW;
@@ -881,11 +1333,14 @@ namespace srt {
 			for (int jobID = 0; jobID < total; ++jobID) {
 
 				std::thread t = std::thread(
-					[rt = constructor(jobID), w, h, jobID, total, callback, this, print_new_line]()
+					[rt = constructor(jobID), w, h, jobID, total, callback, this, print_new_line, cancel]()
 					mutable {
 
 
 					for (;;) {
+						if (cancel && cancel->cancelled()) {
+							break;
+						}
 						int32_t hstart = line.fetch_add(1);
 						if (hstart >= h) {
 							break;
@@ -919,7 +1374,8 @@ namespace srt {
 		RayTracing& rt,
 		int hstart,
 		int hend,
-		PictureOpts const& opts) {
+		PictureOpts const& opts,
+		RenderProfile* prof) {
 		int PPP = opts.SamplePoints;
 		size_t w = (size_t)opts.Width, h = (size_t)opts.High;
 
@@ -939,9 +1395,13 @@ namespace srt {
 
 
 		for (int j = hstart; j < hend; ++j) {
+			if (opts.Seed) {
+				setRandomSeed(opts.Seed * 2654435761u + (uint32_t)j);
+			}
 			for (int i = 0; i < w; ++i) {
 
-
+				uint64_t t0 = prof ? traceTicks() : 0;
+				uint64_t tests0 = rt.stats.fIntersectionTests;
 				Color total = Color::black(0.);
 				for (int ppp = 0; ppp < PPP; ++ppp) {
 
@@ -983,7 +1443,12 @@ namespace srt {
 					ray.fD = rayD;
 					ray.fP = randomNorm(rayD);
 					ray.fO = pc;
-					ray.fLambda = uniform(LEN_MIN, LEN_MAX);
+					if (opts.LambdaSampling == WaveLengthSampling::Stratified) {
+						Real u = (ppp + uniform(0, 1)) / PPP;
+						ray.fLambda = LEN_MIN + u * (LEN_MAX - LEN_MIN);
+					} else {
+						ray.fLambda = uniform(LEN_MIN, LEN_MAX);
+					}
 
 					rt.traceRay(ray);
 
@@ -996,6 +1461,10 @@ namespace srt {
 				}
 				total.A() = 1.;
 				bmp.at(j, i) = total;
+				if (prof) {
+					setPixelCost(*prof, j, i, traceTicks() - t0,
+						rt.stats.fIntersectionTests - tests0);
+				}
 			}
 		}
 	}
@@ -1006,22 +1475,142 @@ namespace srt {
 		Bitmap bmp;
 		bmp.resize(opts.Width, opts.High);
 
+		RecorderQueue* queue = recorderQueue();
+		DeviceSet const& devs = deviceSet();
+		fLastStats = TraceStats();
+		RenderProfile* prof = opts.Profile ? &fLastProfile : nullptr;
+		DeviceCounters counters;
+		if (prof) {
+			prof->fTicks.resize(opts.Width, opts.High);
+			prof->fTests.resize(opts.Width, opts.High);
+			counters.reset(devs.size());
+		}
+		ProgressMeter meter(opts.OnProgress, opts.Cancel, opts.ProgressInterval, opts.High);
+		int lines = 0;
+		auto start = [&](RayTracing& rt) {
+			rt.opts = opts.Trace;
+			if (prof) {
+				rt.profiling = true;
+				rt.profile.reset(devs.size());
+			}
+		};
+
 		if (!opts.Mult) {
-			RayTracing rt(fDevices, fRecorders);
-			eye2(bmp, rt, 0, opts.High, opts);
+			RayTracing rt(devs, queue);
+			start(rt);
+			for (; lines < opts.High && !meter.cancelled(); ++lines) {
+				eye2(bmp, rt, lines, lines + 1, opts, prof);
+				meter.update(lines + 1, rt.stats.fRays);
+			}
+			fLastStats = rt.stats;
+			counters = rt.profile;
 		} else {
 			PictrueJob pj;
+			std::mutex statsMutex;
 
-			auto constructor = [this](int) {
-				return RayTracing(fDevices, fRecorders);
+			auto constructor = [&devs, &start, queue](int) {
+				RayTracing rt(devs, queue);
+				start(rt);
+				return rt;
 			};
-			auto job = [&bmp, &opts, this](RayTracing& rt, int hstart, int hend, int index) {
-				eye2(bmp, rt, hstart, hend, opts);
+			auto job = [&](RayTracing& rt, int hstart, int hend, int index) {
+				eye2(bmp, rt, hstart, hend, opts, prof);
+				std::lock_guard<std::mutex> lock(statsMutex);
+				fLastStats += rt.stats;
+				rt.stats = TraceStats();
+				if (prof) {
+					counters += rt.profile;
+					rt.profile.reset(devs.size());
+				}
+				lines += hend - hstart;
+				meter.update(lines, fLastStats.fRays);
 			};
-			pj.allocate_threads<RayTracing>(bmp, constructor, job, opts.stdoutProgress);
+			pj.allocate_threads<RayTracing>(bmp, constructor, job, opts.stdoutProgress, opts.Cancel);
 			pj.join();
 		}
+		fLastStatus = lines < opts.High ? RunStatus::Cancelled : RunStatus::Completed;
+		meter.update(lines, fLastStats.fRays, true);
+		if (prof) {
+			collectDeviceCosts(*prof, devs, counters);
+		}
+		if (queue) {
+			queue->drain();
+		}
+
+		return bmp;
+	}
+
+	Bitmap Engine::eyeProgressive(PictureOpts const& opts) {
+		if (!(opts.TimeBudget > 0)) {
+			throw std::logic_error("eyeProgressive needs a positive time budget");
+		}
+		using clock = std::chrono::steady_clock;
+		auto start = clock::now();
+		auto elapsed = [start]() {
+			return std::chrono::duration<double>(clock::now() - start).count();
+		};
 
+		int passes = 0;
+		// stops the pass at the deadline or when opts.Cancel is cancelled
+		CancelToken stop;
+		PictureOpts pass = opts;
+		pass.Profile = false;
+		pass.Cancel = &stop;
+		pass.ProgressInterval = 0;
+		pass.OnProgress = [&](Progress const&) {
+			if ((opts.Cancel && opts.Cancel->cancelled())
+				|| (passes > 0 && elapsed() > opts.TimeBudget)) {
+				stop.cancel();
+			}
+		};
+
+		Bitmap bmp;
+		bmp.resize(opts.Width, opts.High);
+		std::vector<Color> sum(bmp.fC.size(), Color::black(0.));
+		TraceStats stats;
+		double last = 0;
+		for (;;) {
+			double t0 = elapsed();
+			if (passes > 0 && t0 + last > opts.TimeBudget) {
+				break;
+			}
+			if (opts.Seed) {
+				pass.Seed = opts.Seed + passes;
+			}
+			Bitmap img = eye(pass);
+			if (fLastStatus == RunStatus::Cancelled) {
+				// the partial first pass is still the best there is,
+				// the stats are of the passes in the image
+				if (passes == 0) {
+					bmp = std::move(img);
+					stats += fLastStats;
+				}
+				break;
+			}
+			stats += fLastStats;
+			last = elapsed() - t0;
+			++passes;
+
+			for (size_t i = 0; i < sum.size(); ++i) {
+				sum[i] += img.fC[i];
+				bmp.fC[i] = sum[i] * (1. / passes);
+			}
+			if (opts.OnPass) {
+				opts.OnPass(bmp, passes * opts.SamplePoints);
+			}
+			if (opts.OnProgress) {
+				Progress p;
+				p.fDone = passes;
+				p.fTotal = std::max<uint64_t>(passes,
+					uint64_t(passes * opts.TimeBudget / elapsed()));
+				p.fRays = stats.fRays;
+				p.fSeconds = elapsed();
+				opts.OnProgress(p);
+			}
+		}
+		fLastStats = stats;
+		fLastStatus = opts.Cancel && opts.Cancel->cancelled()
+			? RunStatus::Cancelled : RunStatus::Completed;
 		return bmp;
 	}
 
@@ -1037,5 +1626,19 @@ namespace srt {
 
 	}
 
+	DeviceSet const& Engine::deviceSet() {
+		for (Device* dev : fDevices) {
+			dev->refresh();
+		}
+		if (!fDeviceSet || !fDeviceSet->matches(fDevices)) {
+			fDeviceSet = std::make_shared<DeviceSet>(fDevices);
+		}
+		return *fDeviceSet;
+	}
+
+	Device* DeviceSet::nearest(Ray const& ray, Real& s) const {
+		return minSDevice(*this, ray, s);
+	}
+
 }
 
@@ -6,6 +6,7 @@
 #include "Recorder.h"
 #include "Source.h"
 #include "Pars.h"
+#include "ReflectType.h"
 #include <string>
 #include <memory>
 #include <functional>
@@ -15,11 +16,62 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <atomic>
 
 namespace srt {
 
 	extern Real gSmin;
 
+	struct RecorderQueue;
+	struct DeviceSet;
+
+	struct TraceOpts {
+		// rays deeper than max_level or weaker than min_ray_amp are dropped
+		int max_level = 100;
+		Real min_ray_amp = 1E-6;
+		// a diffuse or metal hit of a primary ray is split into this many rays
+		int first_level_split = 1;
+	};
+
+	// how far a running eye(), devicesPicture() or emit() is, given to the
+	// progress callback. done and total are lines of a picture or emitted rays
+	struct Progress {
+		uint64_t fDone = 0;
+		uint64_t fTotal = 0;
+		// traced rays of all levels so far
+		uint64_t fRays = 0;
+		double fSeconds = 0;
+
+		double fraction() const {
+			return fTotal ? double(fDone) / fTotal : 1.;
+		}
+
+		double raysPerSecond() const {
+			return fSeconds > 0 ? fRays / fSeconds : 0.;
+		}
+
+		// seconds to go if the rest runs as fast as the done part
+		double eta() const {
+			return fDone ? fSeconds * (fTotal - fDone) / fDone : kInfity;
+		}
+	};
+
+	// cancel() from any thread stops a running eye(), devicesPicture() or
+	// emit() after the lines or the batch of rays at hand.
+	// what is done so far is kept, see Engine::lastStatus()
+	struct CancelToken {
+		void cancel() { fCancelled.store(true, std::memory_order_relaxed); }
+		void reset() { fCancelled.store(false, std::memory_order_relaxed); }
+		bool cancelled() const { return fCancelled.load(std::memory_order_relaxed); }
+	private:
+		std::atomic<bool> fCancelled{ false };
+	};
+
+	enum class RunStatus {
+		Completed,
+		Cancelled,
+	};
+
 	struct PictureOpts
 	{
 
@@ -42,7 +94,18 @@ namespace srt {
 			pars::n2Max_,
 			pars::lightOrigin_,
 			pars::mult_,
-			pars::stdoutProgress_>;
+			pars::stdoutProgress_,
+			pars::seed_,
+			pars::lambdaSampling_,
+			pars::maxLevel_,
+			pars::minRayAmp_,
+			pars::firstLevelSplit_,
+			pars::profile_,
+			pars::onProgress_,
+			pars::cancel_,
+			pars::progressInterval_,
+			pars::timeBudget_,
+			pars::onPass_>;
 
 		int Width = 500;
 		int High = 500;
@@ -73,6 +136,31 @@ namespace srt {
 
 		bool stdoutProgress = false;
 
+		// 0: not seeded. else each line is seeded from Seed and its index,
+		// the picture is the same for any number of threads
+		uint32_t Seed = 0;
+
+		WaveLengthSampling LambdaSampling = WaveLengthSampling::Uniform;
+		// used by eye()
+		TraceOpts Trace;
+
+		// eye() and devicesPicture() fill Engine::lastProfile(), slower
+		bool Profile = false;
+
+		// called every ProgressInterval seconds and at the end, one call
+		// at a time but from the rendering threads if Mult
+		std::function<void(Progress const&)> OnProgress;
+		Real ProgressInterval = 0.5;
+		// a cancelled picture has the lines done so far, the other lines
+		// are black with alpha 0
+		CancelToken const* Cancel = nullptr;
+
+		// used by eyeProgressive(), which renders passes of SamplePoints
+		// samples until TimeBudget seconds are spent. OnPass is given the
+		// mean of the passes so far and its samples per pixel
+		Real TimeBudget = 0;
+		std::function<void(Bitmap const&, int)> OnPass;
+
 		PictureOpts(pars::argument auto const &... args)
 		{
 			pars::check< Pars>(args...);
@@ -103,6 +191,17 @@ namespace srt {
 			pars::set(N2Max, pars::n2Max, args...);
 			pars::set(LightOrigin, pars::lightOrigin, args...);
 			pars::set(stdoutProgress, pars::stdoutProgress, args...);
+			pars::set(Seed, pars::seed, args...);
+			pars::set(LambdaSampling, pars::lambdaSampling, args...);
+			pars::set(Trace.max_level, pars::maxLevel, args...);
+			pars::set(Trace.min_ray_amp, pars::minRayAmp, args...);
+			pars::set(Trace.first_level_split, pars::firstLevelSplit, args...);
+			pars::set(Profile, pars::profile, args...);
+			pars::set(OnProgress, pars::onProgress, args...);
+			pars::set(Cancel, pars::cancel, args...);
+			pars::set(ProgressInterval, pars::progressInterval, args...);
+			pars::set(TimeBudget, pars::timeBudget, args...);
+			pars::set(OnPass, pars::onPass, args...);
 			pars::set(ApertureDiameter, pars::apertureDiameter, args...);
 			if constexpr (pars::has<decltype(args)...>(pars::lookAt)) {
 				lookAt(pars::get(pars::lookAt, args...));
@@ -149,10 +248,145 @@ namespace srt {
 
 	};
 
+	// the detailed counters of TraceStats, build with SRT_TRACE_STATS=0
+	// to leave them zero
+#ifndef SRT_TRACE_STATS
+#define SRT_TRACE_STATS 1
+#endif
+
+	// what the engine did in the last eye() or emit().
+	// each tracing thread counts into its own, they are summed at the end
+	struct TraceStats {
+		// deeper levels are counted in the last
+		static constexpr int kLevels = 32;
+		static constexpr int kReflectTypes = (int)ReflectType::Rayleigh + 1;
+
+		// rays from the camera or the sources
+		uint64_t fPrimaryRays = 0;
+		// rays of all levels
+		uint64_t fRays = 0;
+		// Device::process calls to find the nearest device
+		uint64_t fIntersectionTests = 0;
+
+		// traced rays of each level, level 0 is the primary ray
+		uint64_t fRaysOfLevel[kLevels] = {};
+		// primary rays by the deepest level of their path
+		uint64_t fPathsOfDepth[kLevels] = {};
+		// rays hitting nothing
+		uint64_t fEscaped = 0;
+		// rays hitting a surface without making a new ray, i.e. absorbed
+		uint64_t fDied = 0;
+		// rays dropped by TraceOpts::max_level or min_ray_amp
+		uint64_t fCut = 0;
+		uint64_t fTotalInternalReflections = 0;
+		// hits and time of each branch of the reflection, by ReflectType.
+		// ticks are cpu cycles where a cycle counter is available, else ns.
+		// they are estimated from a sample of the hits, compare them by
+		// reflectTimeShare
+		uint64_t fReflectHits[kReflectTypes] = {};
+		uint64_t fReflectTicks[kReflectTypes] = {};
+
+		// rays per primary ray
+		double pathLength() const {
+			return fPrimaryRays ? double(fRays) / fPrimaryRays : 0.;
+		}
+
+		double testsPerRay() const {
+			return fRays ? double(fIntersectionTests) / fRays : 0.;
+		}
+
+		// fraction of the paths going deeper than level
+		double pathsDeeperThan(int level) const {
+			uint64_t n = 0;
+			for (int i = level + 1; i < kLevels; ++i) {
+				n += fPathsOfDepth[i];
+			}
+			return fPrimaryRays ? double(n) / fPrimaryRays : 0.;
+		}
+
+		// fraction of the reflection time spent in the branch of t
+		double reflectTimeShare(ReflectType t) const {
+			uint64_t total = 0;
+			for (int i = 0; i < kReflectTypes; ++i) {
+				total += fReflectTicks[i];
+			}
+			return total ? double(fReflectTicks[(int)t]) / total : 0.;
+		}
+
+		TraceStats& operator+=(TraceStats const& r) {
+			fPrimaryRays += r.fPrimaryRays;
+			fRays += r.fRays;
+			fIntersectionTests += r.fIntersectionTests;
+			for (int i = 0; i < kLevels; ++i) {
+				fRaysOfLevel[i] += r.fRaysOfLevel[i];
+				fPathsOfDepth[i] += r.fPathsOfDepth[i];
+			}
+			fEscaped += r.fEscaped;
+			fDied += r.fDied;
+			fCut += r.fCut;
+			fTotalInternalReflections += r.fTotalInternalReflections;
+			for (int i = 0; i < kReflectTypes; ++i) {
+				fReflectHits[i] += r.fReflectHits[i];
+				fReflectTicks[i] += r.fReflectTicks[i];
+			}
+			return *this;
+		}
+	};
+
+	// where the time of a profiled eye() or devicesPicture() went
+	struct RenderProfile {
+		struct DeviceCost {
+			std::string fName;
+			uint64_t fCalls = 0;
+			// see TraceStats::fReflectTicks, every call is timed here
+			uint64_t fTicks = 0;
+		};
+
+		// gray images of the ticks and the intersection tests of each pixel
+		Bitmap fTicks;
+		Bitmap fTests;
+		// Device::process calls, devices of the same name are summed.
+		// the most costly first
+		std::vector<DeviceCost> fDevices;
+
+		// black-red-yellow-white image of fTicks or fTests, white is the max
+		static Bitmap heatmap(Bitmap const& cost);
+		// the costly devices and the spread of the pixel cost, as text
+		std::string report(size_t topDevices = 20) const;
+	};
+
+	struct EmitOpts
+	{
+		using Pars = pars::Pars<
+			pars::onProgress_,
+			pars::cancel_,
+			pars::progressInterval_>;
+
+		// see PictureOpts. a cancelled emit() has recorded the rays emitted
+		// so far, lastStats().fPrimaryRays of them
+		std::function<void(Progress const&)> OnProgress;
+		Real ProgressInterval = 0.5;
+		CancelToken const* Cancel = nullptr;
+
+		EmitOpts(pars::argument auto const &... args)
+		{
+			pars::check< Pars>(args...);
+			set(args...);
+		}
+
+		void set(pars::argument auto const &... args)
+		{
+			pars::set(OnProgress, pars::onProgress, args...);
+			pars::set(Cancel, pars::cancel, args...);
+			pars::set(ProgressInterval, pars::progressInterval, args...);
+		}
+	};
+
 	 struct Engine {
 
 		void emit(Ray const& ray);
 		void emit(int N);
+		void emit(int N, EmitOpts const& opts);
 		virtual void devicesPicture(std::string const& filename,
 			PictureOpts const& opts);
 
@@ -160,10 +394,12 @@ namespace srt {
 			PictureOpts const& opts);
 		virtual Bitmap devicesPicture(PictureOpts const& opts);
 
+		// recorders are called from a background thread, see Recorder
 		void addRecorder(std::shared_ptr<Recorder> recorder)
 		{
 			fRecorders.push_back(recorder.get());
 			fRecorders_.push_back(recorder);
+			fQueue.reset();
 		}
 		void addSource(std::shared_ptr<Source> src)
 		{
@@ -180,19 +416,39 @@ namespace srt {
 		Device* findDevice(std::string_view name);
 
 		Bitmap eye(PictureOpts const& opts);
-
-		std::vector<Device*>& getDevices() { return fDevices; }
+		// eye() in passes until opts.TimeBudget, the mean of the passes.
+		// a pass is only started if it's expected to end in time, the one
+		// running at the deadline is dropped, except the first pass.
+		// Seed is increased by one for each pass. OnProgress is called
+		// after each pass with the passes done and the passes expected.
+		// lastStats() counts the passes in the image, not the dropped one
+		Bitmap eyeProgressive(PictureOpts const& opts);
+
+		std::vector<Device*> const& getDevices() const { return fDevices; }
+		TraceStats const& lastStats() const { return fLastStats; }
+		// of the last eye() or devicesPicture() with PictureOpts::Profile
+		RenderProfile const& lastProfile() const { return fLastProfile; }
+		// whether the last eye(), devicesPicture() or emit() was cancelled
+		RunStatus lastStatus() const { return fLastStatus; }
 	private:
-		void doEmit(int N, Source& src);
+		void doEmit(int N, Source& src, EmitOpts const& opts);
+		RecorderQueue* recorderQueue();
+		// refresh the devices, the set is rebuilt if they changed
+		DeviceSet const& deviceSet();
 
 		bool fSourceEqualChance = false;
 		std::vector<Device*> fDevices;
 		std::vector<std::shared_ptr<Device>> fDevices_;
 		std::vector<Recorder*> fRecorders;
 		std::vector<std::shared_ptr<Recorder>> fRecorders_;
+		std::shared_ptr<RecorderQueue> fQueue;
+		std::shared_ptr<DeviceSet> fDeviceSet;
 		std::vector<Source*> fSources;
 		std::vector<std::shared_ptr<Source>> fSources_;
 
+		TraceStats fLastStats;
+		RenderProfile fLastProfile;
+		RunStatus fLastStatus = RunStatus::Completed;
 		Source* fEye = nullptr;
 		int fMaxLevel = 1000;
 		double fMinAmp = 0.;
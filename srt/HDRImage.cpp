@@ -0,0 +1,413 @@
+#include "Bitmap.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <stdint.h>
+
+namespace srt {
+
+	// all the multi byte values of PFM (scale < 0) and EXR are little endian
+	static bool hostLittleEndian()
+	{
+		uint16_t v = 1;
+		uint8_t b;
+		memcpy(&b, &v, 1);
+		return b == 1;
+	}
+
+	template<class T>
+	static void putLE(std::vector<uint8_t>& out, T v)
+	{
+		uint8_t b[sizeof(T)];
+		memcpy(b, &v, sizeof(T));
+		if (!hostLittleEndian()) {
+			std::reverse(b, b + sizeof(T));
+		}
+		out.insert(out.end(), b, b + sizeof(T));
+	}
+
+	template<class T>
+	static T getLE(uint8_t const* p)
+	{
+		uint8_t b[sizeof(T)];
+		memcpy(b, p, sizeof(T));
+		if (!hostLittleEndian()) {
+			std::reverse(b, b + sizeof(T));
+		}
+		T v;
+		memcpy(&v, b, sizeof(T));
+		return v;
+	}
+
+	// float to IEEE half, round to nearest even, overflow to inf
+	static uint16_t floatToHalf(float f)
+	{
+		uint32_t x;
+		memcpy(&x, &f, 4);
+		uint32_t sign = (x >> 16) & 0x8000;
+		uint32_t absx = x & 0x7FFFFFFF;
+
+		if (absx >= 0x7F800000) {
+			// inf or nan, keep nan a nan
+			return (uint16_t)(sign | 0x7C00 | (absx > 0x7F800000 ? 0x200 : 0));
+		}
+		if (absx >= 0x477FF000) {
+			// rounds to >= 65520
+			return (uint16_t)(sign | 0x7C00);
+		}
+		if (absx < 0x38800000) {
+			// subnormal half, or zero
+			if (absx < 0x33000000) {
+				return (uint16_t)sign;
+			}
+			uint32_t m = (absx & 0x7FFFFF) | 0x800000;
+			int shift = 126 - (int)(absx >> 23);
+			uint32_t h = m >> shift;
+			uint32_t rem = m & ((1u << shift) - 1);
+			uint32_t half = 1u << (shift - 1);
+			if (rem > half || (rem == half && (h & 1))) {
+				++h;
+			}
+			return (uint16_t)(sign | h);
+		}
+		uint32_t h = ((absx - 0x38000000) >> 13);
+		uint32_t rem = absx & 0x1FFF;
+		if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+			++h;
+		}
+		return (uint16_t)(sign | h);
+	}
+
+	static float halfToFloat(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+		uint32_t e = (h >> 10) & 0x1F;
+		uint32_t m = h & 0x3FF;
+		uint32_t x;
+		if (e == 0) {
+			if (m == 0) {
+				x = sign;
+			} else {
+				// normalize the subnormal
+				int s = 0;
+				while (!(m & 0x400)) {
+					m <<= 1;
+					++s;
+				}
+				x = sign | ((uint32_t)(113 - s) << 23) | ((m & 0x3FF) << 13);
+			}
+		} else if (e == 31) {
+			x = sign | 0x7F800000 | (m << 13);
+		} else {
+			x = sign | ((e + 112) << 23) | (m << 13);
+		}
+		float f;
+		memcpy(&f, &x, 4);
+		return f;
+	}
+
+	static void readAll(std::istream& is, std::vector<uint8_t>& data)
+	{
+		std::ostringstream ss;
+		ss << is.rdbuf();
+		std::string s = ss.str();
+		data.assign(s.begin(), s.end());
+	}
+
+	void writePFM(Bitmap const& bitmap, std::ostream& os)
+	{
+		os << "PF\n";
+		os << bitmap.fW << " " << bitmap.fH << "\n";
+		// negative scale: little endian
+		os << "-1.0\n";
+
+		std::vector<uint8_t> row;
+		row.reserve(12 * (size_t)bitmap.fW);
+		// pfm rows go from bottom to top
+		for (int i = bitmap.fH - 1; i >= 0; --i) {
+			row.clear();
+			for (int j = 0; j < bitmap.fW; ++j) {
+				Color const& c = bitmap.at(i, j);
+				putLE(row, (float)c.R());
+				putLE(row, (float)c.G());
+				putLE(row, (float)c.B());
+			}
+			os.write((char const*)row.data(), row.size());
+		}
+	}
+
+	void readPFM(Bitmap& bitmap, std::istream& is)
+	{
+		std::string magic;
+		int w = 0, h = 0;
+		double scale = 0;
+		is >> magic >> w >> h >> scale;
+		// exactly one white space after the scale
+		is.get();
+		if (!is || (magic != "PF" && magic != "Pf") || w <= 0 || h <= 0 || scale == 0) {
+			throw std::runtime_error("not a PFM file");
+		}
+		int channels = magic == "PF" ? 3 : 1;
+		bool little = scale < 0;
+
+		bitmap.resize(w, h);
+		std::vector<uint8_t> row(4 * channels * (size_t)w);
+		for (int i = h - 1; i >= 0; --i) {
+			is.read((char*)row.data(), row.size());
+			if (!is) {
+				throw std::runtime_error("truncated PFM file");
+			}
+			if (little != hostLittleEndian()) {
+				for (size_t k = 0; k < row.size(); k += 4) {
+					std::reverse(row.data() + k, row.data() + k + 4);
+				}
+			}
+			float const* v = (float const*)row.data();
+			for (int j = 0; j < w; ++j) {
+				float const* p = v + (size_t)channels * j;
+				bitmap.at(i, j) = channels == 3 ? Color(p[0], p[1], p[2], 1) : Color(p[0], p[0], p[0], 1);
+			}
+		}
+	}
+
+	static constexpr uint32_t kEXRMagic = 20000630;
+	// version 2, scanline, short names
+	static constexpr uint32_t kEXRVersion = 2;
+
+	enum EXRPixelType {
+		kEXRUint = 0,
+		kEXRHalf = 1,
+		kEXRFloat = 2,
+	};
+
+	static void putString(std::vector<uint8_t>& out, char const* s)
+	{
+		out.insert(out.end(), s, s + strlen(s) + 1);
+	}
+
+	static void putAttribute(std::vector<uint8_t>& out, char const* name, char const* type,
+		std::vector<uint8_t> const& value)
+	{
+		putString(out, name);
+		putString(out, type);
+		putLE(out, (int32_t)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	// channels are sorted by name, as the format requires
+	static constexpr char const* kEXRChannels[4] = { "A", "B", "G", "R" };
+
+	void writeEXR(Bitmap const& bitmap, std::ostream& os)
+	{
+		std::vector<uint8_t> header;
+		putLE(header, kEXRMagic);
+		putLE(header, kEXRVersion);
+
+		std::vector<uint8_t> v;
+		for (char const* ch : kEXRChannels) {
+			putString(v, ch);
+			putLE(v, (int32_t)kEXRHalf);
+			// pLinear and reserved
+			putLE(v, (uint32_t)0);
+			putLE(v, (int32_t)1);
+			putLE(v, (int32_t)1);
+		}
+		v.push_back(0);
+		putAttribute(header, "channels", "chlist", v);
+
+		v = { 0 };
+		putAttribute(header, "compression", "compression", v);
+
+		v.clear();
+		putLE(v, (int32_t)0);
+		putLE(v, (int32_t)0);
+		putLE(v, (int32_t)bitmap.fW - 1);
+		putLE(v, (int32_t)bitmap.fH - 1);
+		putAttribute(header, "dataWindow", "box2i", v);
+		putAttribute(header, "displayWindow", "box2i", v);
+
+		// increasing y
+		v = { 0 };
+		putAttribute(header, "lineOrder", "lineOrder", v);
+
+		v.clear();
+		putLE(v, 1.0f);
+		putAttribute(header, "pixelAspectRatio", "float", v);
+
+		v.clear();
+		putLE(v, 0.0f);
+		putLE(v, 0.0f);
+		putAttribute(header, "screenWindowCenter", "v2f", v);
+
+		v.clear();
+		putLE(v, 1.0f);
+		putAttribute(header, "screenWindowWidth", "float", v);
+
+		header.push_back(0);
+
+		// one scan line per chunk: y, size, then each channel for the line
+		size_t lineBytes = 4 * 2 * (size_t)bitmap.fW;
+		uint64_t offset = header.size() + 8 * (size_t)bitmap.fH;
+		for (int i = 0; i < bitmap.fH; ++i) {
+			putLE(header, offset);
+			offset += 8 + lineBytes;
+		}
+		os.write((char const*)header.data(), header.size());
+
+		std::vector<uint8_t> line;
+		line.reserve(8 + lineBytes);
+		for (int i = 0; i < bitmap.fH; ++i) {
+			line.clear();
+			putLE(line, (int32_t)i);
+			putLE(line, (int32_t)lineBytes);
+			for (int ch = 0; ch < 4; ++ch) {
+				for (int j = 0; j < bitmap.fW; ++j) {
+					Color const& c = bitmap.at(i, j);
+					Real x = ch == 0 ? c.A() : ch == 1 ? c.B() : ch == 2 ? c.G() : c.R();
+					putLE(line, floatToHalf((float)x));
+				}
+			}
+			os.write((char const*)line.data(), line.size());
+		}
+	}
+
+	// reads uncompressed scanline files, with any subset of R, G, B, A
+	// in half or float. missing colors are 0, a missing alpha is 1.
+	void readEXR(Bitmap& bitmap, std::istream& is)
+	{
+		std::vector<uint8_t> data;
+		readAll(is, data);
+		size_t size = data.size();
+		size_t pos = 0;
+		auto need = [&](size_t n) {
+			if (size - pos < n) {
+				throw std::runtime_error("truncated EXR file");
+			}
+		};
+		auto getString = [&]() {
+			size_t end = pos;
+			while (end < size && data[end] != 0) {
+				++end;
+			}
+			need(end - pos + 1);
+			std::string s((char const*)data.data() + pos, end - pos);
+			pos = end + 1;
+			return s;
+		};
+
+		need(8);
+		if (getLE<uint32_t>(data.data()) != kEXRMagic) {
+			throw std::runtime_error("not an EXR file");
+		}
+		uint32_t version = getLE<uint32_t>(data.data() + 4);
+		// tiles, deep data and multi part
+		if ((version & 0xFF) != 2 || (version & 0x1A00)) {
+			throw std::runtime_error("only scanline EXR files are supported");
+		}
+		pos = 8;
+
+		struct Channel {
+			std::string fName;
+			int fType;
+		};
+		std::vector<Channel> channels;
+		int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+		int compression = -1;
+		for (;;) {
+			std::string name = getString();
+			if (name.empty()) {
+				break;
+			}
+			std::string type = getString();
+			need(4);
+			int32_t n = getLE<int32_t>(data.data() + pos);
+			pos += 4;
+			if (n < 0) {
+				throw std::runtime_error("bad EXR attribute " + name);
+			}
+			need((size_t)n);
+			uint8_t const* p = data.data() + pos;
+			size_t end = pos + n;
+			if (name == "channels" && type == "chlist") {
+				while (pos < end && data[pos] != 0) {
+					Channel c;
+					c.fName = getString();
+					need(16);
+					c.fType = getLE<int32_t>(data.data() + pos);
+					if (getLE<int32_t>(data.data() + pos + 8) != 1
+						|| getLE<int32_t>(data.data() + pos + 12) != 1) {
+						throw std::runtime_error("subsampled EXR channels are not supported");
+					}
+					pos += 16;
+					channels.push_back(c);
+				}
+			} else if (name == "compression" && n == 1) {
+				compression = p[0];
+			} else if (name == "dataWindow" && n == 16) {
+				x0 = getLE<int32_t>(p);
+				y0 = getLE<int32_t>(p + 4);
+				x1 = getLE<int32_t>(p + 8);
+				y1 = getLE<int32_t>(p + 12);
+			}
+			pos = end;
+		}
+		if (compression != 0) {
+			throw std::runtime_error("only uncompressed EXR files are supported");
+		}
+		if (x1 < x0 || y1 < y0 || channels.empty()) {
+			throw std::runtime_error("empty EXR file");
+		}
+
+		int w = x1 - x0 + 1;
+		int h = y1 - y0 + 1;
+		size_t lineBytes = 0;
+		for (auto& c : channels) {
+			if (c.fType != kEXRHalf && c.fType != kEXRFloat) {
+				throw std::runtime_error("unsupported EXR pixel type");
+			}
+			lineBytes += (c.fType == kEXRHalf ? 2 : 4) * (size_t)w;
+		}
+
+		bitmap.resize(w, h);
+		for (auto& c : bitmap.fC) {
+			c = Color(0, 0, 0, 1);
+		}
+
+		need(8 * (size_t)h);
+		uint8_t const* table = data.data() + pos;
+		for (int k = 0; k < h; ++k) {
+			pos = (size_t)getLE<uint64_t>(table + 8 * k);
+			if (pos > size) {
+				throw std::runtime_error("truncated EXR file");
+			}
+			need(8);
+			int y = getLE<int32_t>(data.data() + pos) - y0;
+			size_t n = (size_t)getLE<int32_t>(data.data() + pos + 4);
+			pos += 8;
+			if (y < 0 || y >= h || n != lineBytes) {
+				throw std::runtime_error("bad EXR scan line");
+			}
+			need(n);
+			uint8_t const* p = data.data() + pos;
+			for (auto& c : channels) {
+				for (int j = 0; j < w; ++j) {
+					float x;
+					if (c.fType == kEXRHalf) {
+						x = halfToFloat(getLE<uint16_t>(p));
+						p += 2;
+					} else {
+						x = getLE<float>(p);
+						p += 4;
+					}
+					Color& color = bitmap.at(y, j);
+					if (c.fName == "R") color.R() = x;
+					else if (c.fName == "G") color.G() = x;
+					else if (c.fName == "B") color.B() = x;
+					else if (c.fName == "A") color.A() = x;
+				}
+			}
+		}
+	}
+
+}
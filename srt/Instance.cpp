@@ -0,0 +1,106 @@
+#include "Instance.h"
+#include <stdexcept>
+#include <typeinfo>
+
+namespace srt {
+
+	Instance::Instance(std::shared_ptr<Device const> geometry, Transform const& toWorld) :
+		fGeometry(std::move(geometry))
+	{
+		if (!fGeometry) {
+			throw std::logic_error("instance of nothing");
+		}
+		setTransform(toWorld);
+	}
+
+	void Instance::setTransform(Transform const& toWorld)
+	{
+		fToObject = toWorld.inverse();
+		fToWorld = toWorld;
+	}
+
+	template<class Process>
+	void Instance::process(Ray const& ray, ProcessHandler& handler, Process&& process) const
+	{
+		// the direction is kept normalized, s is scaled back to world
+		Vec3 d = fToObject.vector(ray.fD);
+		Real len = sqrt(norm2(d));
+		Ray local = ray;
+		local.fO = fToObject.point(ray.fO);
+		local.fD = d / len;
+		if (norm2(ray.fP) > 0) {
+			local.fP = normalize(fToObject.vector(ray.fP));
+		}
+
+		if (handler.fType == HandlerType::Distance) {
+			DistanceHandler& h = static_cast<DistanceHandler&>(handler);
+			Real s = h.fDistance;
+			h.fDistance = kInfity;
+			process(local);
+			if (std::isinf(h.fDistance)) {
+				h.fDistance = s;
+			} else {
+				h.fDistance /= len;
+			}
+		} else {
+			TracingHandler& h = static_cast<TracingHandler&>(handler);
+			bool hit = h.hit;
+			h.hit = false;
+			process(local);
+			if (h.hit) {
+				h.inter = fToWorld.point(h.inter);
+				h.N = normalize(fToObject.transposed(h.N));
+				h.device = this;
+			} else {
+				h.hit = hit;
+			}
+		}
+	}
+
+	void Instance::process(Ray const& ray, ProcessHandler& handler) const
+	{
+		process(ray, handler, [&](Ray const& local) {
+			fGeometry->process(local, handler);
+			});
+	}
+
+	bool Instance::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		// a subclass may override process(), it opts in itself
+		if (typeid(*this) != typeid(Instance))
+			return false;
+		return fGeometry->precomputeOrigin(fToObject.point(o), terms);
+	}
+
+	void Instance::processFrom(Ray const& ray, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		process(ray, handler, [&](Ray const& local) {
+			fGeometry->processFrom(local, terms, handler);
+			});
+	}
+
+	void Instance::refresh() const
+	{
+		fGeometry->refresh();
+	}
+
+	AABB Instance::boundingBox() const
+	{
+		AABB box = fGeometry->boundingBox();
+		if (!box.bounded()) {
+			return box;
+		}
+		AABB world;
+		for (int i = 0; i < 8; ++i) {
+			Vec3 corner = {
+				i & 1 ? box.fMax.fX : box.fMin.fX,
+				i & 2 ? box.fMax.fY : box.fMin.fY,
+				i & 4 ? box.fMax.fZ : box.fMin.fZ,
+			};
+			world.extend(fToWorld.point(corner));
+		}
+		return world;
+	}
+
+}
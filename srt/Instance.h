@@ -0,0 +1,65 @@
+#ifndef SRT_INSTANCE_H
+#define SRT_INSTANCE_H
+
+#include <memory>
+#include "Device.h"
+#include "Transform.h"
+
+namespace srt {
+
+	// a geometry placed by an affine transform, many instances can share
+	// one geometry (with its properties). rays are mapped into the space
+	// of the geometry, hit points and normals are mapped back.
+	struct Instance : Device
+	{
+		Instance(std::shared_ptr<Device const> geometry, Transform const& toWorld);
+
+		Device const& geometry() const;
+		Transform const& getTransform() const;
+		void setTransform(Transform const& toWorld);
+
+		void process(Ray const& ray, ProcessHandler& handler) const override;
+		AABB boundingBox() const override;
+		void refresh() const override;
+		// the terms of the geometry for the mapped origin
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& ray, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
+
+	private:
+		template<class Process>
+		void process(Ray const& ray, ProcessHandler& handler, Process&& process) const;
+
+		std::shared_ptr<Device const> fGeometry;
+		Transform fToWorld;
+		Transform fToObject;
+	};
+
+	std::shared_ptr<Instance> instance(std::shared_ptr<Device const> geometry,
+		Transform const& toWorld,
+		pars::argument auto const &... args)
+	{
+		pars::check(Device::pars_, args...);
+		auto inst = std::make_shared<Instance>(std::move(geometry), toWorld);
+		inst->set(pars::uncheck, args...);
+		return inst;
+	}
+
+}
+
+// implementation
+namespace srt {
+
+	inline Device const& Instance::geometry() const
+	{
+		return *fGeometry;
+	}
+
+	inline Transform const& Instance::getTransform() const
+	{
+		return fToWorld;
+	}
+
+}
+
+#endif
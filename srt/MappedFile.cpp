@@ -0,0 +1,100 @@
+#include "MappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace srt {
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(std::string const& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("can't open " + path);
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			throw std::runtime_error("can't get size of " + path);
+		}
+		fFile = file;
+		fSize = (size_t)size.QuadPart;
+		if (fSize == 0) {
+			// empty file can't be mapped
+			return;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CloseHandle(file);
+			throw std::runtime_error("can't map " + path);
+		}
+		fMapping = mapping;
+		fData = (char const*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!fData) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("can't map " + path);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (fData) {
+			UnmapViewOfFile(fData);
+		}
+		if (fMapping) {
+			CloseHandle(fMapping);
+		}
+		if (fFile) {
+			CloseHandle(fFile);
+		}
+	}
+
+#else
+
+	MappedFile::MappedFile(std::string const& path)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("can't open " + path);
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			throw std::runtime_error("can't get size of " + path);
+		}
+		fSize = (size_t)st.st_size;
+		if (fSize == 0) {
+			close(fd);
+			return;
+		}
+		void* p = mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping stays valid after the descriptor is closed
+		close(fd);
+		if (p == MAP_FAILED) {
+			throw std::runtime_error("can't map " + path);
+		}
+		fData = (char const*)p;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (fData) {
+			munmap((void*)fData, fSize);
+		}
+	}
+
+#endif
+
+}
@@ -0,0 +1,32 @@
+#ifndef SRT_MAPPEDFILE_H
+#define SRT_MAPPEDFILE_H
+
+#include <string>
+#include <stddef.h>
+
+namespace srt {
+
+	// read only memory mapping of a whole file
+	struct MappedFile {
+
+		// throw std::runtime_error if the file can't be mapped
+		MappedFile(std::string const& path);
+		~MappedFile();
+
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+
+		char const* data() const { return fData; }
+		size_t size() const { return fSize; }
+
+	private:
+		char const* fData = nullptr;
+		size_t fSize = 0;
+#ifdef _WIN32
+		void* fFile = nullptr;
+		void* fMapping = nullptr;
+#endif
+	};
+
+}
+#endif
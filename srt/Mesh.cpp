@@ -0,0 +1,270 @@
+#include "Mesh.h"
+#include <stdexcept>
+#include "Engine.h"
+
+namespace srt {
+
+	void TriangleMesh::setVertices(std::vector<Vec3> vertices, std::vector<uint32_t> indices)
+	{
+		if (indices.size() % 3 != 0) {
+			throw std::logic_error("number of indices must be multiple of 3");
+		}
+		for (uint32_t i : indices) {
+			if (i >= vertices.size()) {
+				throw std::logic_error("vertex index out of range");
+			}
+		}
+		fVertices = std::move(vertices);
+		fIndices = std::move(indices);
+		fNormals.clear();
+		fNormalIndices.clear();
+		fMaterialIndices.clear();
+		fNodes.clear();
+		fOrder.clear();
+		fOwner.reset();
+		fBuilt = false;
+		updateView();
+	}
+
+	// put per triangle values given in the order of setVertices() into the order of the BVH
+	template<class T>
+	static void reorder(std::vector<T>& v, std::span<uint32_t const> order, size_t stride)
+	{
+		if (v.empty() || order.empty()) {
+			return;
+		}
+		std::vector<T> tmp(v.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			for (size_t k = 0; k < stride; ++k) {
+				tmp[stride * i + k] = v[stride * order[i] + k];
+			}
+		}
+		v.swap(tmp);
+	}
+
+	void TriangleMesh::setNormals(std::vector<Vec3> normals, std::vector<uint32_t> normalIndices)
+	{
+		if (fBuilt && fView.fOrder.size() != triangleCount()) {
+			throw std::logic_error("the order of the triangles of the mesh is unknown");
+		}
+		if (!normalIndices.empty() && normalIndices.size() != fView.fIndices.size()) {
+			throw std::logic_error("normal indices must match the vertex indices");
+		}
+		size_t limit = normalIndices.empty() ? fView.fVertices.size() : normals.size();
+		if (normalIndices.empty() && normals.size() != fView.fVertices.size()) {
+			throw std::logic_error("one normal per vertex expected");
+		}
+		for (uint32_t i : normalIndices) {
+			if (i >= limit) {
+				throw std::logic_error("normal index out of range");
+			}
+		}
+		for (Vec3& n : normals) {
+			if (norm2(n) > 0) {
+				n = normalize(n);
+			}
+		}
+		reorder(normalIndices, fView.fOrder, 3);
+		fNormals = std::move(normals);
+		fNormalIndices = std::move(normalIndices);
+		// a mapped mesh keeps its other arrays
+		fView.fNormals = fNormals;
+		fView.fNormalIndices = fNormalIndices;
+	}
+
+	void TriangleMesh::setMaterials(std::vector<std::shared_ptr<SurfaceProperties>> materials,
+		std::vector<uint32_t> materialIndices)
+	{
+		if (fBuilt && fView.fOrder.size() != triangleCount()) {
+			throw std::logic_error("the order of the triangles of the mesh is unknown");
+		}
+		if (materialIndices.size() != triangleCount()) {
+			throw std::logic_error("one material index per triangle expected");
+		}
+		for (uint32_t i : materialIndices) {
+			if (i >= materials.size()) {
+				throw std::logic_error("material index out of range");
+			}
+		}
+		reorder(materialIndices, fView.fOrder, 1);
+		fMaterials = std::move(materials);
+		fMaterialIndices = std::move(materialIndices);
+		fView.fMaterialIndices = fMaterialIndices;
+	}
+
+	void TriangleMesh::updateView()
+	{
+		fView.fVertices = fVertices;
+		fView.fIndices = fIndices;
+		fView.fNormals = fNormals;
+		fView.fNormalIndices = fNormalIndices;
+		fView.fMaterialIndices = fMaterialIndices;
+		fView.fNodes = fNodes;
+		fView.fOrder = fOrder;
+	}
+
+	void TriangleMesh::setView(MeshView const& view, std::shared_ptr<void const> owner)
+	{
+		if (view.fNodes.empty() && !view.fIndices.empty()) {
+			throw std::logic_error("view without BVH");
+		}
+		fVertices.clear();
+		fIndices.clear();
+		fNormals.clear();
+		fNormalIndices.clear();
+		fMaterialIndices.clear();
+		fNodes.clear();
+		fOrder.clear();
+		fView = view;
+		fOwner = std::move(owner);
+		fBuilt = true;
+	}
+
+	void TriangleMesh::build(int maxLeafSize)
+	{
+		if (fOwner) {
+			// the BVH comes with the view
+			return;
+		}
+		size_t n = triangleCount();
+		std::vector<AABB> boxes(n);
+		for (size_t i = 0; i < n; ++i) {
+			boxes[i].extend(fVertices[fIndices[3 * i]]);
+			boxes[i].extend(fVertices[fIndices[3 * i + 1]]);
+			boxes[i].extend(fVertices[fIndices[3 * i + 2]]);
+		}
+
+		std::vector<uint32_t> order;
+		buildBVH(boxes, fNodes, order, maxLeafSize);
+
+		// the leaves refer to triangle ranges directly
+		reorder(fIndices, order, 3);
+		reorder(fNormalIndices, order, 3);
+		reorder(fMaterialIndices, order, 1);
+		if (fOrder.empty()) {
+			fOrder = std::move(order);
+		} else {
+			// built again
+			reorder(fOrder, order, 1);
+		}
+		fBuilt = true;
+		updateView();
+	}
+
+	AABB TriangleMesh::boundingBox() const
+	{
+		AABB box;
+		if (!fView.fNodes.empty()) {
+			BVHNode const& root = fView.fNodes[0];
+			box.fMin = { root.fMin[0], root.fMin[1], root.fMin[2] };
+			box.fMax = { root.fMax[0], root.fMax[1], root.fMax[2] };
+			return box;
+		}
+		for (uint32_t i : fView.fIndices) {
+			box.extend(fView.fVertices[i]);
+		}
+		return box;
+	}
+
+	SurfaceProperties const* TriangleMesh::material(size_t tri) const
+	{
+		if (fView.fMaterialIndices.empty() || fMaterials.empty()) {
+			return this;
+		}
+		uint32_t i = fView.fMaterialIndices[tri];
+		SurfaceProperties const* m = i < fMaterials.size() ? fMaterials[i].get() : nullptr;
+		return m ? m : this;
+	}
+
+	int64_t TriangleMesh::intersect(Ray const& ray, Real& smin, Real& umin, Real& vmin) const
+	{
+		int64_t hit = -1;
+		smin = kInfity;
+		Vec3 const* vertices = fView.fVertices.data();
+		uint32_t const* indices = fView.fIndices.data();
+
+		auto leaf = [&](uint32_t first, uint32_t count, Real& smax) {
+			for (uint32_t t = first; t < first + count; ++t) {
+				Vec3 const& v0 = vertices[indices[3 * t]];
+				Vec3 const& v1 = vertices[indices[3 * t + 1]];
+				Vec3 const& v2 = vertices[indices[3 * t + 2]];
+
+				// Moller-Trumbore
+				Vec3 e1 = v1 - v0;
+				Vec3 e2 = v2 - v0;
+				Vec3 p = cross(ray.fD, e2);
+				Real det = dot(e1, p);
+				if (det == 0) {
+					continue;
+				}
+				Real invDet = 1 / det;
+				Vec3 tv = ray.fO - v0;
+				Real u = dot(tv, p) * invDet;
+				if (u < 0 || u > 1) {
+					continue;
+				}
+				Vec3 q = cross(tv, e1);
+				Real v = dot(ray.fD, q) * invDet;
+				if (v < 0 || u + v > 1) {
+					continue;
+				}
+				Real s = dot(e2, q) * invDet;
+				if (s <= gSmin || s >= smax) {
+					continue;
+				}
+				smax = s;
+				smin = s;
+				umin = u;
+				vmin = v;
+				hit = t;
+			}
+		};
+
+		Real smax = kInfity;
+		traverseBVH(fView.fNodes.data(), fView.fNodes.size(), ray.fO, ray.fD, smax, leaf);
+		return hit;
+	}
+
+	void TriangleMesh::process(Ray const& r, ProcessHandler& handler) const
+	{
+		if (!fBuilt) {
+			throw std::logic_error("mesh is not built");
+		}
+
+		Real s, u, v;
+		int64_t tri = intersect(r, s, u, v);
+		if (tri < 0) {
+			return;
+		}
+
+		Vec3 const* vertices = fView.fVertices.data();
+		uint32_t const* idx = &fView.fIndices[3 * tri];
+		Vec3 Ng = cross(vertices[idx[1]] - vertices[idx[0]],
+			vertices[idx[2]] - vertices[idx[0]]);
+		// leaving the mesh?
+		bool in2out = dot(Ng, r.fD) > 0;
+
+		if (handler.fType == HandlerType::Distance) {
+			static_cast<DistanceHandler&>(handler).distance(s, in2out);
+		} else if (handler.fType == HandlerType::Tracing) {
+			Ng = normalize(Ng);
+			Vec3 N = Ng;
+			if (!fView.fNormals.empty()) {
+				Vec3 const* normals = fView.fNormals.data();
+				uint32_t const* nidx = fView.fNormalIndices.empty() ? idx : &fView.fNormalIndices[3 * tri];
+				Vec3 Ns = (1 - u - v) * normals[nidx[0]]
+					+ u * normals[nidx[1]]
+					+ v * normals[nidx[2]];
+				// the shading normal must stay on the side of the geometric normal
+				if (dot(Ns, Ng) > 0) {
+					N = normalize(Ns);
+				}
+			}
+			Vec3 inter = r.fO + s * r.fD;
+			static_cast<TracingHandler&>(handler).hitSurface(inter,
+				N,
+				in2out, material(tri), this);
+		}
+	}
+
+}
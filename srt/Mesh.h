@@ -0,0 +1,129 @@
+#ifndef SRT_MESH_H
+#define SRT_MESH_H
+
+#include <memory>
+#include <vector>
+#include <span>
+#include <stdint.h>
+#include "Device.h"
+#include "SurfaceProperties.h"
+#include "BVH.h"
+
+namespace srt {
+
+	// the arrays of a mesh, they may live in the mesh or in a mapped file
+	struct MeshView {
+		std::span<Vec3 const> fVertices;
+		std::span<uint32_t const> fIndices;
+		std::span<Vec3 const> fNormals;
+		std::span<uint32_t const> fNormalIndices;
+		std::span<uint32_t const> fMaterialIndices;
+		std::span<BVHNode const> fNodes;
+		// the triangle i was the triangle fOrder[i] before build(), empty if not built
+		std::span<uint32_t const> fOrder;
+	};
+
+	// indexed triangle mesh with an internal BVH.
+	// triangles are counter clockwise when looked from outside,
+	// i.e. cross(v1 - v0, v2 - v0) points to the outer side.
+	struct TriangleMesh : Device, SurfaceProperties
+	{
+		static constexpr auto pars_ = Device::pars_ | SurfaceProperties::pars_;
+
+		TriangleMesh(pars::argument auto const &... args)
+		{
+			set(args...);
+		}
+
+		TriangleMesh(pars::uncheck_t, pars::argument auto const &... args)
+		{
+			set(pars::uncheck, args...);
+		}
+
+		void set(pars::argument auto const &... args)
+		{
+			pars::check(pars_, args...);
+			set(pars::uncheck, args...);
+		}
+
+		void set(pars::uncheck_t, pars::argument auto const &... args)
+		{
+			Device::set(pars::uncheck, args...);
+			SurfaceProperties::set(pars::uncheck, args...);
+		}
+
+		// 3 indices per triangle
+		void setVertices(std::vector<Vec3> vertices, std::vector<uint32_t> indices);
+		// per vertex normals, normalIndices can be empty if normals share the vertex indices.
+		// the indices are in the order of setVertices(), also after build()
+		void setNormals(std::vector<Vec3> normals, std::vector<uint32_t> normalIndices = {});
+		// per face material, the mesh itself is used if no material is set.
+		// the indices are in the order of setVertices(), also after build()
+		void setMaterials(std::vector<std::shared_ptr<SurfaceProperties>> materials,
+			std::vector<uint32_t> materialIndices);
+
+		// must be called after the geometry changed.
+		// triangles are reordered, the order is kept for setNormals() and setMaterials()
+		void build(int maxLeafSize = 4);
+
+		// use external arrays (with a prebuilt BVH), owner keeps them alive
+		void setView(MeshView const& view, std::shared_ptr<void const> owner);
+		MeshView const& getView() const;
+
+		size_t triangleCount() const;
+		AABB boundingBox() const override;
+
+		void process(Ray const& in, ProcessHandler& handler) const override;
+
+	private:
+		// find the nearest hit, return the triangle index or -1
+		int64_t intersect(Ray const& ray, Real& s, Real& u, Real& v) const;
+		SurfaceProperties const* material(size_t tri) const;
+
+		void updateView();
+
+		std::vector<Vec3> fVertices;
+		std::vector<uint32_t> fIndices;
+		std::vector<Vec3> fNormals;
+		std::vector<uint32_t> fNormalIndices;
+		std::vector<uint32_t> fMaterialIndices;
+		std::vector<BVHNode> fNodes;
+		std::vector<uint32_t> fOrder;
+		std::vector<std::shared_ptr<SurfaceProperties>> fMaterials;
+
+		// all the queries go through the view
+		MeshView fView;
+		std::shared_ptr<void const> fOwner;
+		bool fBuilt = false;
+	};
+
+	// built, normals and materials can still be set
+	std::shared_ptr<TriangleMesh> triangleMesh(std::vector<Vec3> vertices,
+		std::vector<uint32_t> indices,
+		pars::argument auto const &... args)
+	{
+		pars::check(TriangleMesh::pars_, args...);
+		auto mesh = std::make_shared<TriangleMesh>(pars::uncheck, args...);
+		mesh->setVertices(std::move(vertices), std::move(indices));
+		mesh->build();
+		return mesh;
+	}
+
+}
+
+// implementation
+namespace srt {
+
+	inline size_t TriangleMesh::triangleCount() const
+	{
+		return fView.fIndices.size() / 3;
+	}
+
+	inline MeshView const& TriangleMesh::getView() const
+	{
+		return fView;
+	}
+
+}
+
+#endif
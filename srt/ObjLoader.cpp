@@ -0,0 +1,566 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <string.h>
+
+namespace srt {
+
+	static bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	static bool isEol(char c)
+	{
+		return c == '\n' || c == '\r';
+	}
+
+	static char const* skipBlank(char const* p, char const* end)
+	{
+		while (p < end && isBlank(*p)) {
+			++p;
+		}
+		return p;
+	}
+
+	static char const* nextLine(char const* p, char const* end)
+	{
+		char const* nl = (char const*)memchr(p, '\n', end - p);
+		return nl ? nl + 1 : end;
+	}
+
+	static char const* parseReal(char const* p, char const* end, Real& v)
+	{
+		p = skipBlank(p, end);
+		// from_chars doesn't accept the plus sign
+		if (p < end && *p == '+') {
+			++p;
+		}
+		auto r = std::from_chars(p, end, v);
+		if (r.ec != std::errc()) {
+			throw std::runtime_error("bad number in obj");
+		}
+		return r.ptr;
+	}
+
+	static char const* parseInt(char const* p, char const* end, int64_t& v, bool& has)
+	{
+		bool neg = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			neg = *p == '-';
+			++p;
+		}
+		int64_t x = 0;
+		char const* b = p;
+		while (p < end && *p >= '0' && *p <= '9') {
+			x = 10 * x + (*p - '0');
+			++p;
+		}
+		has = p != b;
+		v = neg ? -x : x;
+		return p;
+	}
+
+	enum class ObjLine {
+		Vertex,
+		Normal,
+		Face,
+		Other,
+	};
+
+	// p points to the first non blank character of the line
+	static ObjLine lineType(char const*& p, char const* end)
+	{
+		if (end - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+			p += 2;
+			return ObjLine::Vertex;
+		}
+		if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+			p += 3;
+			return ObjLine::Normal;
+		}
+		if (end - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+			p += 2;
+			return ObjLine::Face;
+		}
+		return ObjLine::Other;
+	}
+
+	struct ObjChunk {
+		char const* fBegin;
+		char const* fEnd;
+
+		// the first pass
+		size_t fVertices = 0;
+		size_t fNormals = 0;
+		size_t fTriangles = 0;
+		bool fHasNormals = false;
+
+		// the offsets of this chunk in the output
+		size_t fVertexBase = 0;
+		size_t fNormalBase = 0;
+		size_t fTriangleBase = 0;
+
+		std::exception_ptr fError;
+
+		void count()
+		{
+			for (char const* p = fBegin; p < fEnd; p = nextLine(p, fEnd)) {
+				char const* q = skipBlank(p, fEnd);
+				switch (lineType(q, fEnd)) {
+				case ObjLine::Vertex:
+					++fVertices;
+					break;
+				case ObjLine::Normal:
+					++fNormals;
+					break;
+				case ObjLine::Face:
+				{
+					size_t n = 0;
+					for (;;) {
+						q = skipBlank(q, fEnd);
+						if (q == fEnd || isEol(*q)) {
+							break;
+						}
+						++n;
+						int slashes = 0;
+						while (q < fEnd && !isBlank(*q) && !isEol(*q)) {
+							if (*q == '/') {
+								++slashes;
+							} else if (slashes == 2) {
+								// the normal index follows the second slash
+								fHasNormals = true;
+							}
+							++q;
+						}
+					}
+					if (n >= 3) {
+						fTriangles += n - 2;
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+
+		void parse(ObjData& out, size_t totalVertices, size_t totalNormals, uint32_t noNormal)
+		{
+			Vec3* vertices = out.fVertices.data() + fVertexBase;
+			Vec3* normals = out.fNormals.data() + fNormalBase;
+			uint32_t* indices = out.fIndices.data() + 3 * fTriangleBase;
+			uint32_t* normalIndices = out.fNormalIndices.empty() ? nullptr
+				: out.fNormalIndices.data() + 3 * fTriangleBase;
+
+			size_t nv = 0;
+			size_t nn = 0;
+			// reused for all the faces
+			std::vector<uint32_t> face;
+			std::vector<uint32_t> faceNormals;
+
+			// resolve 1-based or negative (relative) index
+			auto resolve = [](int64_t i, size_t count, size_t total) -> uint32_t {
+				int64_t r = i > 0 ? i - 1 : (int64_t)count + i;
+				if (i == 0 || r < 0 || r >= (int64_t)total) {
+					throw std::runtime_error("index out of range in obj face");
+				}
+				return (uint32_t)r;
+			};
+
+			for (char const* p = fBegin; p < fEnd; p = nextLine(p, fEnd)) {
+				char const* q = skipBlank(p, fEnd);
+				switch (lineType(q, fEnd)) {
+				case ObjLine::Vertex:
+				{
+					Vec3& v = vertices[nv++];
+					q = parseReal(q, fEnd, v.fX);
+					q = parseReal(q, fEnd, v.fY);
+					q = parseReal(q, fEnd, v.fZ);
+					break;
+				}
+				case ObjLine::Normal:
+				{
+					Vec3& v = normals[nn++];
+					q = parseReal(q, fEnd, v.fX);
+					q = parseReal(q, fEnd, v.fY);
+					q = parseReal(q, fEnd, v.fZ);
+					break;
+				}
+				case ObjLine::Face:
+				{
+					face.clear();
+					faceNormals.clear();
+					for (;;) {
+						q = skipBlank(q, fEnd);
+						if (q == fEnd || isEol(*q)) {
+							break;
+						}
+						// v, v/vt, v/vt/vn or v//vn
+						int64_t iv, it, in;
+						bool hv, ht, hn = false;
+						q = parseInt(q, fEnd, iv, hv);
+						if (!hv) {
+							throw std::runtime_error("bad face in obj");
+						}
+						if (q < fEnd && *q == '/') {
+							q = parseInt(q + 1, fEnd, it, ht);
+							if (q < fEnd && *q == '/') {
+								q = parseInt(q + 1, fEnd, in, hn);
+							}
+						}
+						face.push_back(resolve(iv, fVertexBase + nv, totalVertices));
+						faceNormals.push_back(hn ? resolve(in, fNormalBase + nn, totalNormals) : noNormal);
+					}
+					if (face.size() < 3) {
+						break;
+					}
+					// fan triangulation
+					for (size_t i = 1; i + 1 < face.size(); ++i) {
+						*indices++ = face[0];
+						*indices++ = face[i];
+						*indices++ = face[i + 1];
+						if (normalIndices) {
+							*normalIndices++ = faceNormals[0];
+							*normalIndices++ = faceNormals[i];
+							*normalIndices++ = faceNormals[i + 1];
+						}
+					}
+					break;
+				}
+				default:
+					break;
+				}
+			}
+		}
+	};
+
+	ObjData parseObj(char const* data, size_t size, int threads)
+	{
+		if (threads <= 0) {
+			threads = std::max(1, (int)std::thread::hardware_concurrency());
+		}
+		// not worth a thread for less than 1MB
+		size_t nChunks = std::min((size_t)threads, size / (1 << 20) + 1);
+
+		char const* end = data + size;
+		std::vector<ObjChunk> chunks(nChunks);
+		char const* p = data;
+		for (size_t i = 0; i < nChunks; ++i) {
+			chunks[i].fBegin = p;
+			if (i + 1 == nChunks) {
+				p = end;
+			} else {
+				// chunks end at line boundaries
+				p = std::max(p, data + size * (i + 1) / nChunks);
+				p = p < end ? nextLine(p, end) : end;
+			}
+			chunks[i].fEnd = p;
+		}
+
+		auto run = [&](auto&& job) {
+			std::vector<std::thread> workers;
+			for (size_t i = 1; i < nChunks; ++i) {
+				workers.emplace_back([&, i]() {
+					try {
+						job(chunks[i]);
+					} catch (...) {
+						chunks[i].fError = std::current_exception();
+					}
+				});
+			}
+			try {
+				job(chunks[0]);
+			} catch (...) {
+				chunks[0].fError = std::current_exception();
+			}
+			for (auto& w : workers) {
+				w.join();
+			}
+			for (auto& c : chunks) {
+				if (c.fError) {
+					std::rethrow_exception(c.fError);
+				}
+			}
+		};
+
+		run([](ObjChunk& c) { c.count(); });
+
+		size_t nv = 0, nn = 0, nt = 0;
+		bool hasNormals = false;
+		for (auto& c : chunks) {
+			c.fVertexBase = nv;
+			c.fNormalBase = nn;
+			c.fTriangleBase = nt;
+			nv += c.fVertices;
+			nn += c.fNormals;
+			nt += c.fTriangles;
+			hasNormals |= c.fHasNormals;
+		}
+		if (nv > UINT32_MAX || nn >= UINT32_MAX || 3 * nt > UINT32_MAX) {
+			throw std::runtime_error("obj too large");
+		}
+
+		ObjData out;
+		out.fVertices.resize(nv);
+		out.fIndices.resize(3 * nt);
+		if (hasNormals) {
+			// the corners without normal refer to an extra zero normal,
+			// the mesh then falls back to the geometric normal
+			out.fNormals.resize(nn + 1);
+			out.fNormalIndices.resize(3 * nt);
+		}
+		uint32_t noNormal = (uint32_t)nn;
+
+		run([&](ObjChunk& c) { c.parse(out, nv, nn, noNormal); });
+
+		if (!hasNormals) {
+			out.fNormals.clear();
+		}
+		return out;
+	}
+
+	static constexpr int kCacheArrays = 7;
+
+	struct MeshCacheHeader {
+		char fMagic[8];
+		uint32_t fVersion;
+		uint32_t fHeaderSize;
+		uint64_t fSourceSize;
+		int64_t fSourceTime;
+		// vertices, indices, normals, normal indices, material indices, nodes, order
+		uint64_t fCount[kCacheArrays];
+		uint64_t fOffset[kCacheArrays];
+	};
+
+	static constexpr char kCacheMagic[8] = { 'S', 'R', 'T', 'M', 'E', 'S', 'H', 0 };
+	static constexpr uint32_t kCacheVersion = 2;
+	static constexpr uint64_t kCacheAlign = 64;
+
+	static constexpr size_t kCacheElemSize[kCacheArrays] = {
+		sizeof(Vec3),
+		sizeof(uint32_t),
+		sizeof(Vec3),
+		sizeof(uint32_t),
+		sizeof(uint32_t),
+		sizeof(BVHNode),
+		sizeof(uint32_t),
+	};
+
+	void writeMeshCache(std::string const& path, TriangleMesh const& mesh,
+		uint64_t sourceSize, int64_t sourceTime)
+	{
+		MeshView const& view = mesh.getView();
+		void const* arrays[kCacheArrays] = {
+			view.fVertices.data(),
+			view.fIndices.data(),
+			view.fNormals.data(),
+			view.fNormalIndices.data(),
+			view.fMaterialIndices.data(),
+			view.fNodes.data(),
+			view.fOrder.data(),
+		};
+		size_t counts[kCacheArrays] = {
+			view.fVertices.size(),
+			view.fIndices.size(),
+			view.fNormals.size(),
+			view.fNormalIndices.size(),
+			view.fMaterialIndices.size(),
+			view.fNodes.size(),
+			view.fOrder.size(),
+		};
+
+		MeshCacheHeader header = {};
+		memcpy(header.fMagic, kCacheMagic, sizeof(kCacheMagic));
+		header.fVersion = kCacheVersion;
+		header.fHeaderSize = sizeof(MeshCacheHeader);
+		header.fSourceSize = sourceSize;
+		header.fSourceTime = sourceTime;
+		uint64_t offset = sizeof(MeshCacheHeader);
+		for (int i = 0; i < kCacheArrays; ++i) {
+			offset = (offset + kCacheAlign - 1) / kCacheAlign * kCacheAlign;
+			header.fCount[i] = counts[i];
+			header.fOffset[i] = offset;
+			offset += counts[i] * kCacheElemSize[i];
+		}
+
+		// write to a temporary file, so that a reader never sees a partial cache
+		std::string tmp = path + ".tmp";
+		{
+			std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				throw std::runtime_error("can't write " + tmp);
+			}
+			out.write((char const*)&header, sizeof(header));
+			uint64_t pos = sizeof(header);
+			char const zeros[kCacheAlign] = {};
+			for (int i = 0; i < kCacheArrays; ++i) {
+				out.write(zeros, header.fOffset[i] - pos);
+				out.write((char const*)arrays[i], counts[i] * kCacheElemSize[i]);
+				pos = header.fOffset[i] + counts[i] * kCacheElemSize[i];
+			}
+			if (!out) {
+				throw std::runtime_error("can't write " + tmp);
+			}
+		}
+		std::filesystem::rename(tmp, path);
+	}
+
+	// the indices of the view are in range and the BVH is a tree that
+	// traverseBVH can walk, so a broken file can't make the mesh read out of its arrays
+	static bool validView(MeshView const& view)
+	{
+		size_t nt = view.fIndices.size() / 3;
+		if (view.fIndices.size() % 3 != 0 || (view.fNodes.empty() && nt != 0)) {
+			return false;
+		}
+		for (uint32_t i : view.fIndices) {
+			if (i >= view.fVertices.size()) {
+				return false;
+			}
+		}
+		if (view.fNormalIndices.empty()) {
+			if (!view.fNormals.empty() && view.fNormals.size() != view.fVertices.size()) {
+				return false;
+			}
+		} else if (view.fNormalIndices.size() != view.fIndices.size()) {
+			return false;
+		}
+		for (uint32_t i : view.fNormalIndices) {
+			if (i >= view.fNormals.size()) {
+				return false;
+			}
+		}
+		if (!view.fMaterialIndices.empty() && view.fMaterialIndices.size() != nt) {
+			return false;
+		}
+		if (!view.fOrder.empty() && view.fOrder.size() != nt) {
+			return false;
+		}
+		for (uint32_t i : view.fOrder) {
+			if (i >= nt) {
+				return false;
+			}
+		}
+
+		// children come after their parent, so one pass gives the depths
+		size_t nn = view.fNodes.size();
+		std::vector<uint8_t> depth(nn, 0);
+		for (size_t k = 0; k < nn; ++k) {
+			BVHNode const& node = view.fNodes[k];
+			if (node.isLeaf()) {
+				if ((uint64_t)node.fIndex + node.fCount > nt) {
+					return false;
+				}
+				continue;
+			}
+			// the stack of traverseBVH holds 64 nodes
+			if (k + 1 >= nn || node.fIndex <= k + 1 || node.fIndex >= nn || depth[k] >= 63) {
+				return false;
+			}
+			uint8_t d = depth[k] + 1;
+			depth[k + 1] = std::max(depth[k + 1], d);
+			depth[node.fIndex] = std::max(depth[node.fIndex], d);
+		}
+		return true;
+	}
+
+	std::shared_ptr<TriangleMesh> readMeshCache(std::string const& path,
+		uint64_t sourceSize, int64_t sourceTime)
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(path, ec)) {
+			return nullptr;
+		}
+
+		std::shared_ptr<MappedFile> file;
+		try {
+			file = std::make_shared<MappedFile>(path);
+		} catch (std::runtime_error const&) {
+			return nullptr;
+		}
+
+		if (file->size() < sizeof(MeshCacheHeader)) {
+			return nullptr;
+		}
+		MeshCacheHeader const& header = *(MeshCacheHeader const*)file->data();
+		if (memcmp(header.fMagic, kCacheMagic, sizeof(kCacheMagic)) != 0
+			|| header.fVersion != kCacheVersion
+			|| header.fHeaderSize != sizeof(MeshCacheHeader)
+			|| header.fSourceSize != sourceSize
+			|| header.fSourceTime != sourceTime) {
+			return nullptr;
+		}
+		for (int i = 0; i < kCacheArrays; ++i) {
+			if (header.fOffset[i] % kCacheAlign != 0
+				|| header.fOffset[i] > file->size()
+				|| header.fCount[i] > (file->size() - header.fOffset[i]) / kCacheElemSize[i]) {
+				return nullptr;
+			}
+		}
+
+		auto span = [&](auto* type, int i) {
+			using T = std::remove_pointer_t<decltype(type)>;
+			return std::span<T const>((T const*)(file->data() + header.fOffset[i]), header.fCount[i]);
+		};
+		MeshView view;
+		view.fVertices = span((Vec3*)nullptr, 0);
+		view.fIndices = span((uint32_t*)nullptr, 1);
+		view.fNormals = span((Vec3*)nullptr, 2);
+		view.fNormalIndices = span((uint32_t*)nullptr, 3);
+		view.fMaterialIndices = span((uint32_t*)nullptr, 4);
+		view.fNodes = span((BVHNode*)nullptr, 5);
+		view.fOrder = span((uint32_t*)nullptr, 6);
+
+		if (!validView(view)) {
+			return nullptr;
+		}
+
+		auto mesh = std::make_shared<TriangleMesh>();
+		mesh->setView(view, file);
+		return mesh;
+	}
+
+	std::shared_ptr<TriangleMesh> loadObj(std::string const& path, bool cache)
+	{
+		std::filesystem::path p(path);
+		uint64_t sourceSize = std::filesystem::file_size(p);
+		int64_t sourceTime = std::filesystem::last_write_time(p).time_since_epoch().count();
+		std::string cachePath = path + ".srtmesh";
+
+		if (cache) {
+			if (auto mesh = readMeshCache(cachePath, sourceSize, sourceTime)) {
+				return mesh;
+			}
+		}
+
+		ObjData obj;
+		{
+			MappedFile file(path);
+			obj = parseObj(file.data(), file.size());
+		}
+
+		auto mesh = std::make_shared<TriangleMesh>();
+		mesh->setVertices(std::move(obj.fVertices), std::move(obj.fIndices));
+		if (!obj.fNormals.empty()) {
+			mesh->setNormals(std::move(obj.fNormals), std::move(obj.fNormalIndices));
+		}
+		mesh->build();
+
+		if (cache) {
+			try {
+				writeMeshCache(cachePath, *mesh, sourceSize, sourceTime);
+			} catch (std::exception const&) {
+				// the cache is optional, e.g. the directory may be read only
+			}
+		}
+		return mesh;
+	}
+
+}
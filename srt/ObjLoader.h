@@ -0,0 +1,42 @@
+#ifndef SRT_OBJLOADER_H
+#define SRT_OBJLOADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "Vec3.h"
+#include "Mesh.h"
+
+namespace srt {
+
+	// triangulated content of an obj file
+	// only v, vn and f are used, the other statements are ignored.
+	struct ObjData {
+		std::vector<Vec3> fVertices;
+		std::vector<Vec3> fNormals;
+		std::vector<uint32_t> fIndices;
+		// empty if no face has normals
+		std::vector<uint32_t> fNormalIndices;
+	};
+
+	// parse obj text, the buffer is split into chunks parsed by threads.
+	// threads = 0 to use all the hardware threads.
+	// throw std::runtime_error on malformed faces
+	ObjData parseObj(char const* data, size_t size, int threads = 0);
+
+	// load an obj file into a mesh.
+	// with cache, "<path>.srtmesh" is mapped if it is up to date,
+	// or written after the obj is parsed.
+	// materials can be set on the mesh in the order of the faces of the file
+	std::shared_ptr<TriangleMesh> loadObj(std::string const& path, bool cache = true);
+
+	// binary mesh cache, the arrays are used in place after mapping
+	void writeMeshCache(std::string const& path, TriangleMesh const& mesh,
+		uint64_t sourceSize = 0, int64_t sourceTime = 0);
+	// return nullptr if the file is missing, stale or broken
+	std::shared_ptr<TriangleMesh> readMeshCache(std::string const& path,
+		uint64_t sourceSize = 0, int64_t sourceTime = 0);
+
+}
+#endif
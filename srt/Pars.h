@@ -10,6 +10,7 @@
 #include <memory>
 #include <utility>
 #include <string>
+#include <functional>
 #include <type_traits>
 
 namespace srt {
@@ -27,8 +28,26 @@ namespace srt {
 		Cone,
 	};
 
+	// how a screen hit is spread over the pixels
+	enum class SplatKernel {
+		Nearest,
+		Bilinear,
+		Gaussian,
+	};
+
+	// how eye() picks the wavelengths of the samples of a pixel
+	enum class WaveLengthSampling {
+		// independently uniform
+		Uniform,
+		// one uniform sample in each of samplePerPixel equal bins
+		Stratified,
+	};
+
 	struct Bound;
 	struct Spectrum;
+	struct Progress;
+	struct CancelToken;
+	struct Bitmap;
 
 	namespace pars {
 
@@ -102,7 +121,7 @@ namespace srt {
 		template<class Arg, class Par, class T>
 		constexpr bool has1(par<Par, T> const& p)
 		{
-			return std::is_same_v<Arg::Par, Par>;
+			return std::is_same_v<typename Arg::Par, Par>;
 		}
 
 		//argument has wanted parameter?
@@ -334,6 +353,13 @@ namespace srt {
 		struct focalDistance_; constexpr par<focalDistance_, Real> focalDistance;
 		struct apertureDiameter_; constexpr par<apertureDiameter_, Real> apertureDiameter;
 		struct gray_; constexpr par<gray_, bool> gray{};
+		// wavelength range of spectrums and screen histograms
+		struct lambdaMin_; constexpr par<lambdaMin_, Real> lambdaMin{};
+		struct lambdaMax_; constexpr par<lambdaMax_, Real> lambdaMax{};
+		struct spectralBins_; constexpr par<spectralBins_, int> spectralBins{};
+		struct splat_; constexpr par<splat_, SplatKernel> splat{};
+		// standard deviation of the gaussian splat in pixels
+		struct splatSigma_; constexpr par<splatSigma_, Real> splatSigma{};
 
 	
 		struct outerReflectType_; constexpr par<outerReflectType_, ReflectType> outerReflectType{};
@@ -361,6 +387,23 @@ namespace srt {
 		// multiple-threading
 		struct mult_; constexpr par<mult_, bool> mult{};
 		struct stdoutProgress_; constexpr par< stdoutProgress_, bool> stdoutProgress{};
+		// random seed, 0 for not seeded
+		struct seed_; constexpr par<seed_, uint32_t> seed{};
+		struct lambdaSampling_; constexpr par<lambdaSampling_, WaveLengthSampling> lambdaSampling{};
+		// path tracing limits and splitting, see TraceOpts
+		struct maxLevel_; constexpr par<maxLevel_, int> maxLevel{};
+		struct minRayAmp_; constexpr par<minRayAmp_, Real> minRayAmp{};
+		struct firstLevelSplit_; constexpr par<firstLevelSplit_, int> firstLevelSplit{};
+		// record the cost of the pixels and devices, see RenderProfile
+		struct profile_; constexpr par<profile_, bool> profile{};
+		// progress callback and cancellation of a long run, see Progress
+		struct onProgress_; constexpr par<onProgress_, std::function<void(Progress const&)>> onProgress{};
+		struct cancel_; constexpr par<cancel_, CancelToken const*> cancel{};
+		// seconds between two progress calls
+		struct progressInterval_; constexpr par<progressInterval_, Real> progressInterval{};
+		// seconds of Engine::eyeProgressive, and the image after each pass
+		struct timeBudget_; constexpr par<timeBudget_, Real> timeBudget{};
+		struct onPass_; constexpr par<onPass_, std::function<void(Bitmap const&, int)>> onPass{};
 		struct x0_; constexpr par<x0_, Real> x0{};
 		struct x1_; constexpr par<x1_, Real> x1{};
 		struct y0_; constexpr par<y0_, Real> y0{};
@@ -0,0 +1,118 @@
+#ifndef SRT_PERTHREAD_H
+#define SRT_PERTHREAD_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace srt {
+
+	// one T per thread, created on the first local() of the thread.
+	// local() takes the mutex only the first time a thread meets this object,
+	// later calls hit a small thread local cache.
+	template<class T>
+	struct PerThread {
+
+		PerThread() : fId(nextId()) {}
+
+		// make new values with f()
+		template<class F>
+		PerThread(F f) : fId(nextId()), fMake(std::move(f)) {}
+
+		PerThread(PerThread const&) = delete;
+		PerThread& operator=(PerThread const&) = delete;
+
+		T& local()
+		{
+			Cache& cache = threadCache();
+			for (auto& e : cache.fEntries) {
+				if (e.fId == fId) {
+					return *e.fValue;
+				}
+			}
+
+			T* value;
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				auto tid = std::this_thread::get_id();
+				value = nullptr;
+				for (auto& s : fSlots) {
+					if (s.fThread == tid) {
+						value = s.fValue.get();
+						break;
+					}
+				}
+				if (!value) {
+					fSlots.push_back({ tid, fMake ? std::make_unique<T>(fMake()) : std::make_unique<T>() });
+					value = fSlots.back().fValue.get();
+				}
+			}
+			// ids are never reused, stale entries are harmless
+			if (cache.fEntries.size() >= kCacheSize) {
+				cache.fEntries.erase(cache.fEntries.begin());
+			}
+			cache.fEntries.push_back({ fId, value });
+			return *value;
+		}
+
+		// not thread safe against local()
+		template<class F>
+		void forEach(F&& f)
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			for (auto& s : fSlots) {
+				f(*s.fValue);
+			}
+		}
+
+		// drop all the values, not thread safe against local()
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(fMutex);
+			fSlots.clear();
+			// the cached pointers of other threads are dead now
+			fId = nextId();
+		}
+
+	private:
+		static constexpr size_t kCacheSize = 16;
+
+		struct Slot {
+			std::thread::id fThread;
+			std::unique_ptr<T> fValue;
+		};
+
+		struct Entry {
+			uint64_t fId;
+			T* fValue;
+		};
+
+		struct Cache {
+			std::vector<Entry> fEntries;
+		};
+
+		static uint64_t nextId()
+		{
+			static std::atomic<uint64_t> id{ 0 };
+			return ++id;
+		}
+
+		static Cache& threadCache()
+		{
+			thread_local Cache cache;
+			return cache;
+		}
+
+		uint64_t fId;
+		std::function<T()> fMake;
+		std::mutex fMutex;
+		std::vector<Slot> fSlots;
+	};
+
+}
+
+#endif
@@ -17,6 +17,15 @@ namespace srt {
 		// <Qx,x> + <-2Qo+P,x> + <Qo,o> + <P,-o> + R = 0
 		fR += dot(dot(fQ, r), r) + dot(fP, -r);
 		fP += -2 * dot(fQ, r);
+		fCenter += r;
+	}
+
+	void Quadric::invert()
+	{
+		fQ = -fQ;
+		fP = -fP;
+		fR = -fR;
+		fSign = -fSign;
 	}
 
 
@@ -32,6 +41,11 @@ namespace srt {
 		fQ.fM23 = 0;
 		fP = -2 * origin;
 		fR = norm2(origin) - radius * radius;
+
+		fKind = QuadricKind::Sphere;
+		fSign = 1;
+		fCenter = origin;
+		fRadius2 = radius * radius;
 	}
 
 
@@ -40,10 +54,13 @@ namespace srt {
 		Real radius) {
 		fP = -2. * origin;
 		fR = norm2(origin) - radius * radius;
+		fCenter = origin;
+		fRadius2 = radius * radius;
 	}
 
 	bool Sphere::inner(Vec3 const& p) const {
-		return dot(fP + p, p) + fR < 0.;
+		Vec3 r = p - fCenter;
+		return dot(r, r) - fRadius2 < 0.;
 	}
 
 
@@ -71,6 +88,13 @@ namespace srt {
 		fR = 0;
 
 		shift(origin);
+
+		fKind = QuadricKind::Conic;
+		fSign = 1;
+		fCenter = origin;
+		fAxis = d;
+		fCurvature = radius;
+		fConic = K;
 	}
 
 	void Quadric::setParabola(Vec3 origin,
@@ -108,6 +132,9 @@ namespace srt {
 
 		shift(origin);
 
+		fKind = QuadricKind::General;
+		fSign = 1;
+
 
 	}
 
@@ -133,6 +160,12 @@ namespace srt {
 		fR = -radius * radius;
 
 		shift(origin);
+
+		fKind = QuadricKind::Tube;
+		fSign = 1;
+		fCenter = origin;
+		fAxis = d;
+		fRadius2 = radius * radius;
 	}
 
 	void Quadric::setSpheroid(Vec3 origin,
@@ -158,10 +191,13 @@ namespace srt {
 		fR = -b * b;
 
 		shift(origin);
+
+		fKind = QuadricKind::General;
+		fSign = 1;
 	}
 
 	bool Quadric::inner(Vec3 const& p) const
 	{
-		return dot(dot(fQ, p), p) + dot(fP, p) + fR < 0.;
+		return value(p) < 0.;
 	}
 }
@@ -1,6 +1,7 @@
 #ifndef SRT_QUADRIC_H
 #define SRT_QUADRIC_H
 
+#include <stdint.h>
 #include "Vec3.h"
 #include "Real.h"
 #include "Pars.h"
@@ -28,6 +29,17 @@ namespace srt {
 	Vec3 dot(SymMatrix3X3 const& q, Vec3 const& v);
 
 
+	// the special forms of a quadric, each has its own kernel
+	enum class QuadricKind : uint8_t {
+		General,
+		// |r|^2 - radius^2, r = x - center
+		Sphere,
+		// |r|^2 - <r, axis>^2 - radius^2
+		Tube,
+		// |r|^2 + K <r, axis>^2 - 2 R <r, axis>
+		Conic,
+	};
+
 	struct Sphere {
 
 		static constexpr auto pars_ = pars::shape | pars::origin | pars::radius;
@@ -55,6 +67,9 @@ namespace srt {
 
 		Real fR;
 		Vec3 fP;
+		// f(x) = |x - fCenter|^2 - fRadius2 is used for the kernels
+		Vec3 fCenter{};
+		Real fRadius2{};
 	};
 
 	struct Quadric
@@ -91,7 +106,20 @@ namespace srt {
 			Real a, Real b);
 
 		void shift(Vec3 r);
-
+		// swap the inner and the outer sides
+		void invert();
+
+		// f(O + D s) = a s^2 + 2 <V, D> s + c
+		// the terms of the origin: V and c
+		void originTerms(Vec3 const& O, Vec3& V, Real& c) const;
+		// the term of the direction: a
+		Real directionTerm(Vec3 const& D) const;
+		// b^2 - a c, b = <V, D>. spheres and tubes use a form
+		// without the cancellation of b^2 - a c for far origins
+		Real discriminant(Vec3 const& V, Vec3 const& D, Real a, Real b, Real c) const;
+		// grad f(x)
+		Vec3 gradient(Vec3 const& x) const;
+		Real value(Vec3 const& x) const;
 
 
 		static constexpr auto pars_ = pars::shape| pars::origin |
@@ -177,6 +205,18 @@ namespace srt {
 		SymMatrix3X3 fQ;
 		Vec3 fP{};
 		Real fR{};
+
+		// set by setSphere, setTube, setParabola and setConicSurface,
+		// f(x) = fSign * form(x) is evaluated by the kernel of the kind
+		QuadricKind fKind = QuadricKind::General;
+		Real fSign = 1;
+		Vec3 fCenter{};
+		Vec3 fAxis{};
+		// radius^2 of sphere and tube
+		Real fRadius2{};
+		// R and K of conic
+		Real fCurvature{};
+		Real fConic{};
 	};
 
 
@@ -200,6 +240,83 @@ namespace srt {
 		fM33 = m33;
 	}
 
+	inline void Quadric::originTerms(Vec3 const& O, Vec3& V, Real& c) const
+	{
+		if (fKind == QuadricKind::General) {
+			Vec3 QO = dot(fQ, O);
+			V = QO + 0.5 * fP;
+			c = dot(QO, O) + dot(fP, O) + fR;
+			return;
+		}
+		Vec3 o = O - fCenter;
+		if (fKind == QuadricKind::Sphere) {
+			V = o;
+			c = dot(o, o) - fRadius2;
+		} else if (fKind == QuadricKind::Tube) {
+			Real od = dot(o, fAxis);
+			V = o - od * fAxis;
+			c = dot(o, o) - od * od - fRadius2;
+		} else {
+			Real od = dot(o, fAxis);
+			V = o + (fConic * od - fCurvature) * fAxis;
+			c = dot(o, o) + (fConic * od - 2 * fCurvature) * od;
+		}
+		V *= fSign;
+		c *= fSign;
+	}
+
+	inline Real Quadric::directionTerm(Vec3 const& D) const
+	{
+		if (fKind == QuadricKind::General) {
+			return dot(dot(fQ, D), D);
+		} else if (fKind == QuadricKind::Sphere) {
+			return fSign * dot(D, D);
+		} else if (fKind == QuadricKind::Tube) {
+			Real Dd = dot(D, fAxis);
+			return fSign * (dot(D, D) - Dd * Dd);
+		} else {
+			Real Dd = dot(D, fAxis);
+			return fSign * (dot(D, D) + fConic * Dd * Dd);
+		}
+	}
+
+	inline Real Quadric::discriminant(Vec3 const& V, Vec3 const& D,
+		Real a, Real b, Real c) const
+	{
+		// V is the origin relative to the center (projected for a tube) times fSign
+		if (fKind == QuadricKind::Sphere) {
+			return fSign * a * fRadius2 - norm2(cross(V, D));
+		} else if (fKind == QuadricKind::Tube) {
+			Real t = dot(fAxis, cross(V, D));
+			return fSign * a * fRadius2 - t * t;
+		} else {
+			return b * b - a * c;
+		}
+	}
+
+	inline Vec3 Quadric::gradient(Vec3 const& x) const
+	{
+		if (fKind == QuadricKind::General) {
+			return fP + 2. * dot(fQ, x);
+		}
+		Vec3 r = x - fCenter;
+		if (fKind == QuadricKind::Sphere) {
+			return (2 * fSign) * r;
+		} else if (fKind == QuadricKind::Tube) {
+			return (2 * fSign) * (r - dot(r, fAxis) * fAxis);
+		} else {
+			return (2 * fSign) * (r + (fConic * dot(r, fAxis) - fCurvature) * fAxis);
+		}
+	}
+
+	inline Real Quadric::value(Vec3 const& x) const
+	{
+		Vec3 V;
+		Real c;
+		originTerms(x, V, c);
+		return c;
+	}
+
 	inline Vec3 dot(SymMatrix3X3 const& q, Vec3 const& v) {
 		return { q.fM11 * v.fX +
 				q.fM12 * v.fY +
@@ -19,10 +19,20 @@ namespace srt {
         gDefaultRndEngine.seed(s);
     }
 
+    char const* randomEngineName()
+    {
+        return "std";
+    }
+
 #else
+    // xorshift needs a non zero state, close seeds give unrelated states
     static uint64_t realRandomSeed(uint32_t s)
     {
-        return s & 0xa4b097a27e0f4d;
+        uint64_t z = s + 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        z ^= z >> 31;
+        return z ? z : 0xa4b097a27e0f4d;
     }
 
     thread_local uint64_t gDefaultRndEngine = realRandomSeed((uint32_t)(uint64_t)&gDefaultRndEngine);
@@ -41,6 +51,11 @@ namespace srt {
         gDefaultRndEngine = realRandomSeed(s);
     }
 
+    char const* randomEngineName()
+    {
+        return "xorshift64";
+    }
+
 #endif
 
     static double asDouble(uint64_t v)
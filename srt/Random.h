@@ -1,11 +1,18 @@
 #ifndef SRT_RANDOM_H
 #define SRT_RANDOM_H
 
+#include <stdint.h>
 #include "Real.h"
 #include "Vec3.h"
 
 namespace srt {
-    
+
+    // seed the generator of the calling thread, each thread has its own.
+    // a fixed seed gives a repeatable sequence
+    void setRandomSeed(uint32_t s);
+    // "xorshift64", or "std" if built with SRT_CPPSTD
+    char const* randomEngineName();
+
     Real uniformUnitary();
     // uniform random number in rnage [a,b]
     Real uniform(Real a, Real b);
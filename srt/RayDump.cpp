@@ -0,0 +1,215 @@
+#include "RayDump.h"
+#include "MappedFile.h"
+#include <stdexcept>
+#include <string.h>
+
+namespace srt {
+
+	static constexpr char kRayDumpMagic[8] = { 'S', 'R', 'T', 'R', 'A', 'Y', 'S', 0 };
+	static constexpr uint32_t kRayDumpVersion = 1;
+
+	static constexpr char kColumnNames[kRayColumns][8] = {
+		"x", "y", "z", "dx", "dy", "dz", "amp", "lambda", "id",
+	};
+
+	struct RayDumpHeader {
+		char fMagic[8];
+		uint32_t fVersion;
+		uint32_t fColumns;
+	};
+
+	struct RayDumpColumn {
+		char fName[8];
+		uint32_t fType;
+		uint32_t fReserved;
+	};
+
+	RayDumpWriter::RayDumpWriter(std::string const& path, size_t memoryBudget)
+	{
+		fCapacity = std::max<size_t>(1, memoryBudget / (kRayColumns * sizeof(Real)));
+		for (auto& c : fColumns) {
+			c.resize(fCapacity);
+		}
+		fIDs.resize(fCapacity);
+
+		fOut.open(path, std::ios::binary | std::ios::trunc);
+		if (!fOut) {
+			throw std::runtime_error("can't write " + path);
+		}
+
+		RayDumpHeader header = {};
+		memcpy(header.fMagic, kRayDumpMagic, sizeof(kRayDumpMagic));
+		header.fVersion = kRayDumpVersion;
+		header.fColumns = kRayColumns;
+		fOut.write((char const*)&header, sizeof(header));
+		for (int i = 0; i < kRayColumns; ++i) {
+			RayDumpColumn col = {};
+			memcpy(col.fName, kColumnNames[i], sizeof(col.fName));
+			col.fType = i < kRayRealColumns ? 0 : 1;
+			fOut.write((char const*)&col, sizeof(col));
+		}
+	}
+
+	RayDumpWriter::~RayDumpWriter()
+	{
+		try {
+			close();
+		} catch (...) {
+		}
+	}
+
+	void RayDumpWriter::append(Ray const& r)
+	{
+		append(&r, 1);
+	}
+
+	void RayDumpWriter::append(Ray const* rays, size_t n)
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (!fOut.is_open()) {
+			throw std::logic_error("ray dump is closed");
+		}
+		for (size_t i = 0; i < n; ++i) {
+			Ray const& r = rays[i];
+			size_t k = fSize++;
+			fColumns[0][k] = r.fO.fX;
+			fColumns[1][k] = r.fO.fY;
+			fColumns[2][k] = r.fO.fZ;
+			fColumns[3][k] = r.fD.fX;
+			fColumns[4][k] = r.fD.fY;
+			fColumns[5][k] = r.fD.fZ;
+			fColumns[6][k] = r.fAmp;
+			fColumns[7][k] = r.fLambda;
+			fIDs[k] = r.fID;
+			if (fSize == fCapacity) {
+				writeChunk();
+			}
+		}
+	}
+
+	void RayDumpWriter::writeChunk()
+	{
+		if (fSize == 0) {
+			return;
+		}
+		uint64_t rows = fSize;
+		fOut.write((char const*)&rows, sizeof(rows));
+		for (auto& c : fColumns) {
+			fOut.write((char const*)c.data(), fSize * sizeof(Real));
+		}
+		fOut.write((char const*)fIDs.data(), fSize * sizeof(int64_t));
+		if (!fOut) {
+			throw std::runtime_error("failed to write ray dump");
+		}
+		fRows += fSize;
+		fSize = 0;
+	}
+
+	void RayDumpWriter::flush()
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (fOut.is_open()) {
+			writeChunk();
+			fOut.flush();
+		}
+	}
+
+	void RayDumpWriter::close()
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (fOut.is_open()) {
+			writeChunk();
+			fOut.close();
+		}
+	}
+
+	Ray RayDumpReader::Chunk::ray(size_t i) const
+	{
+		Ray r;
+		r.fO = { fColumns[0][i], fColumns[1][i], fColumns[2][i] };
+		r.fD = { fColumns[3][i], fColumns[4][i], fColumns[5][i] };
+		r.fP = {};
+		r.fAmp = fColumns[6][i];
+		r.fLambda = fColumns[7][i];
+		r.fID = fIDs[i];
+		return r;
+	}
+
+	RayDumpReader::RayDumpReader(std::string const& path)
+	{
+		fFile = std::make_shared<MappedFile>(path);
+		char const* data = fFile->data();
+		size_t size = fFile->size();
+
+		size_t headerSize = sizeof(RayDumpHeader) + kRayColumns * sizeof(RayDumpColumn);
+		if (size < headerSize) {
+			throw std::runtime_error("not a ray dump: " + path);
+		}
+		RayDumpHeader const& header = *(RayDumpHeader const*)data;
+		if (memcmp(header.fMagic, kRayDumpMagic, sizeof(kRayDumpMagic)) != 0
+			|| header.fVersion != kRayDumpVersion
+			|| header.fColumns != kRayColumns) {
+			throw std::runtime_error("not a ray dump: " + path);
+		}
+
+		size_t pos = headerSize;
+		while (pos < size) {
+			if (size - pos < sizeof(uint64_t)) {
+				throw std::runtime_error("truncated ray dump: " + path);
+			}
+			uint64_t rows = *(uint64_t const*)(data + pos);
+			pos += sizeof(uint64_t);
+			if (rows > (size - pos) / (kRayColumns * sizeof(Real))) {
+				throw std::runtime_error("truncated ray dump: " + path);
+			}
+			Chunk chunk;
+			chunk.fRows = (size_t)rows;
+			for (int i = 0; i < kRayRealColumns; ++i) {
+				chunk.fColumns[i] = (Real const*)(data + pos);
+				pos += rows * sizeof(Real);
+			}
+			chunk.fIDs = (int64_t const*)(data + pos);
+			pos += rows * sizeof(int64_t);
+			fChunks.push_back(chunk);
+			fRows += rows;
+		}
+	}
+
+	RayDumpIter::RayDumpIter(RayDumpReader const& reader) : fReader(reader)
+	{
+		skipEmpty();
+	}
+
+	void RayDumpIter::skipEmpty()
+	{
+		auto& chunks = fReader.chunks();
+		while (fChunk < chunks.size() && fRow >= chunks[fChunk].fRows) {
+			++fChunk;
+			fRow = 0;
+		}
+	}
+
+	void RayDumpIter::next()
+	{
+		++fRow;
+		skipEmpty();
+	}
+
+	bool RayDumpIter::end()
+	{
+		return fChunk >= fReader.chunks().size();
+	}
+
+	Ray RayDumpIter::get()
+	{
+		return fReader.chunks()[fChunk].ray(fRow);
+	}
+
+	void writeRays(std::string const& path, Ray const* rays, size_t n)
+	{
+		RayDumpWriter writer(path);
+		writer.append(rays, n);
+		writer.close();
+	}
+
+}
@@ -0,0 +1,106 @@
+#ifndef SRT_RAYDUMP_H
+#define SRT_RAYDUMP_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <stdint.h>
+#include "Ray.h"
+#include "Iter.h"
+
+namespace srt {
+
+	// binary columnar ray file (.srtrays), native endian:
+	// header: magic[8], version u32, column count u32,
+	//     per column: name[8], type u32 (0: f64, 1: i64), reserved u32
+	// then chunks: rows u64, followed by each column as rows contiguous values.
+	// every value is 8 bytes aligned, so a mapped file is used in place.
+	enum class RayColumn {
+		X, Y, Z,
+		DX, DY, DZ,
+		Amp,
+		Lambda,
+		// the i64 id column
+		ID,
+	};
+
+	constexpr int kRayColumns = 9;
+	constexpr int kRayRealColumns = 8;
+
+	// streaming writer, rows are buffered and written as a chunk
+	// once the buffer reaches the memory budget.
+	struct RayDumpWriter {
+
+		RayDumpWriter(std::string const& path, size_t memoryBudget = 64 << 20);
+		~RayDumpWriter();
+
+		// thread safe
+		void append(Ray const& ray);
+		void append(Ray const* rays, size_t n);
+		void flush();
+		void close();
+
+		uint64_t rows() const { return fRows; }
+
+	private:
+		void writeChunk();
+
+		std::mutex fMutex;
+		std::ofstream fOut;
+		size_t fCapacity;
+		size_t fSize = 0;
+		std::vector<Real> fColumns[kRayRealColumns];
+		std::vector<int64_t> fIDs;
+		uint64_t fRows = 0;
+	};
+
+	struct MappedFile;
+
+	// map a .srtrays file and expose its columns in place
+	struct RayDumpReader {
+
+		struct Chunk {
+			size_t fRows;
+			Real const* fColumns[kRayRealColumns];
+			int64_t const* fIDs;
+
+			Real const* column(RayColumn c) const { return fColumns[(int)c]; }
+			Ray ray(size_t i) const;
+		};
+
+		// throw std::runtime_error if the file is not a ray dump
+		RayDumpReader(std::string const& path);
+
+		uint64_t rows() const { return fRows; }
+		std::vector<Chunk> const& chunks() const { return fChunks; }
+
+	private:
+		std::shared_ptr<MappedFile> fFile;
+		std::vector<Chunk> fChunks;
+		uint64_t fRows = 0;
+	};
+
+	// iterate all the rays of a dump, e.g. for Raster
+	struct RayDumpIter : Iter<Ray> {
+
+		RayDumpIter(RayDumpReader const& reader);
+
+		void next() override;
+		bool end() override;
+		Ray get() override;
+
+	private:
+		void skipEmpty();
+
+		RayDumpReader const& fReader;
+		size_t fChunk = 0;
+		size_t fRow = 0;
+	};
+
+	void writeRays(std::string const& path, Ray const* rays, size_t n);
+
+}
+
+#endif
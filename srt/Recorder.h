@@ -20,12 +20,34 @@ namespace srt {
 		End,      // end of ray life cycle
 	};
 
+	constexpr unsigned eventBit(Event e)
+	{
+		return 1u << (int)e;
+	}
+
+	constexpr unsigned kAllEvents = 0x3F;
+
+	// record() is called from one background thread of the engine,
+	// never concurrently, events of a traced ray come in order and
+	// events of different rays don't interleave.
 	struct Recorder
 	{
 		virtual void record(Event event,
 			Ray const& ray,
 			int level,
 			TracingHandler& handler) = 0;
+
+		// events not in the mask are not produced for this recorder
+		void setEventMask(unsigned mask) { fEventMask = mask; }
+		unsigned eventMask() const { return fEventMask; }
+
+		// record only one of n traced rays (with all its events)
+		void setSampleRate(int n) { fSampleRate = n > 1 ? n : 1; }
+		int sampleRate() const { return fSampleRate; }
+
+	private:
+		unsigned fEventMask = kAllEvents;
+		int fSampleRate = 1;
 	};
 }
 
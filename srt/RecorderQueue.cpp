@@ -0,0 +1,235 @@
+#include "RecorderQueue.h"
+#include "Device.h"
+#include <bit>
+#include <chrono>
+#include <stdexcept>
+
+namespace srt {
+
+	void EventRing::push(RecordedEvent const& e)
+	{
+		size_t tail = fTail.load(std::memory_order_relaxed);
+		while (tail - fHeadCache == kCapacity) {
+			fHeadCache = fHead.load(std::memory_order_acquire);
+			if (tail - fHeadCache == kCapacity) {
+				std::this_thread::yield();
+			}
+		}
+		fEvents[tail & (kCapacity - 1)] = e;
+		fTail.store(tail + 1, std::memory_order_release);
+	}
+
+	RecordedEvent const* EventRing::front()
+	{
+		size_t head = fHead.load(std::memory_order_relaxed);
+		if (head == fTail.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &fEvents[head & (kCapacity - 1)];
+	}
+
+	void EventRing::pop()
+	{
+		fHead.store(fHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool EventRing::empty() const
+	{
+		return fHead.load(std::memory_order_acquire) == fTail.load(std::memory_order_acquire);
+	}
+
+	EventRingLease::EventRingLease(EventRingLease&& r) noexcept :
+		fQueue(r.fQueue), fRing(r.fRing)
+	{
+		r.fQueue = nullptr;
+		r.fRing = nullptr;
+	}
+
+	EventRingLease& EventRingLease::operator=(EventRingLease&& r) noexcept
+	{
+		if (this != &r) {
+			if (fRing) {
+				fQueue->release(fRing);
+			}
+			fQueue = r.fQueue;
+			fRing = r.fRing;
+			r.fQueue = nullptr;
+			r.fRing = nullptr;
+		}
+		return *this;
+	}
+
+	EventRingLease::~EventRingLease()
+	{
+		if (fRing) {
+			fQueue->release(fRing);
+		}
+	}
+
+	void EventRingLease::push(RecordedEvent const& e)
+	{
+		fRing->push(e);
+		fQueue->wake();
+	}
+
+	RecorderQueue::RecorderQueue(std::vector<Recorder*> const& recorders) :
+		fRecorders(recorders)
+	{
+		if (fRecorders.size() > 32) {
+			throw std::logic_error("too many recorders");
+		}
+		for (size_t i = 0; i < fRecorders.size(); ++i) {
+			fAllRecorders |= 1u << i;
+			fSampled = fSampled || fRecorders[i]->sampleRate() > 1;
+			unsigned mask = fRecorders[i]->eventMask();
+			for (int e = 0; e < 6; ++e) {
+				if (mask & eventBit((Event)e)) {
+					fEventRecorders[e] |= 1u << i;
+				}
+			}
+		}
+		fConsumer = std::thread([this]() { consume(); });
+	}
+
+	RecorderQueue::~RecorderQueue()
+	{
+		drain();
+		fStop = true;
+		{
+			std::lock_guard<std::mutex> lock(fWakeMutex);
+			fWake.notify_one();
+		}
+		fConsumer.join();
+	}
+
+	EventRingLease RecorderQueue::acquire()
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		if (fFree.empty()) {
+			fRings.push_back(std::make_unique<EventRing>());
+			fRingCount = fRings.size();
+			return EventRingLease(this, fRings.back().get());
+		}
+		EventRing* ring = fFree.back();
+		fFree.pop_back();
+		return EventRingLease(this, ring);
+	}
+
+	void RecorderQueue::release(EventRing* ring)
+	{
+		std::lock_guard<std::mutex> lock(fMutex);
+		fFree.push_back(ring);
+	}
+
+	uint32_t RecorderQueue::sampleRay()
+	{
+		if (!fSampled) {
+			return fAllRecorders;
+		}
+		uint64_t n = fRays.fetch_add(1, std::memory_order_relaxed);
+		uint32_t m = 0;
+		for (size_t i = 0; i < fRecorders.size(); ++i) {
+			if (n % fRecorders[i]->sampleRate() == 0) {
+				m |= 1u << i;
+			}
+		}
+		return m;
+	}
+
+	void RecorderQueue::wake()
+	{
+		if (fSleeping.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(fWakeMutex);
+			fWake.notify_one();
+		}
+	}
+
+	void RecorderQueue::drain()
+	{
+		wake();
+		for (int k = 0; ; ++k) {
+			bool empty = true;
+			{
+				std::lock_guard<std::mutex> lock(fMutex);
+				for (auto& ring : fRings) {
+					empty = empty && ring->empty();
+				}
+			}
+			if (empty) {
+				break;
+			}
+			if (k < 256) {
+				std::this_thread::yield();
+			} else {
+				std::this_thread::sleep_for(std::chrono::microseconds(20));
+			}
+		}
+	}
+
+	void RecorderQueue::dispatch(RecordedEvent const& e)
+	{
+		TracingHandler handler;
+		handler.pictrue = e.fPictrue;
+		handler.record = true;
+		handler.hit = e.fHit;
+		handler.inter = e.fInter;
+		handler.N = e.fN;
+		handler.inner = e.fInner;
+		handler.property = e.fProperty;
+		handler.device = e.fDevice;
+		for (uint32_t m = e.fRecorders; m; m &= m - 1) {
+			int i = std::countr_zero(m);
+			fRecorders[i]->record(e.fEvent, e.fRay, e.fLevel, handler);
+		}
+	}
+
+	void RecorderQueue::consume()
+	{
+		int idle = 0;
+		while (!fStop) {
+			bool any = false;
+			// rings are only appended, and never freed before the queue
+			size_t n = fRingCount;
+			for (size_t i = 0; i < n; ++i) {
+				EventRing* ring;
+				{
+					std::lock_guard<std::mutex> lock(fMutex);
+					ring = fRings[i].get();
+				}
+				// once a ray is started, stay on the ring until its end,
+				// so events of different rays don't interleave
+				bool inRay = false;
+				for (;;) {
+					RecordedEvent const* e = ring->front();
+					if (!e) {
+						if (!inRay || fStop) {
+							break;
+						}
+						std::this_thread::yield();
+						continue;
+					}
+					any = true;
+					dispatch(*e);
+					inRay = e->fEvent != Event::End;
+					ring->pop();
+					if (!inRay) {
+						break;
+					}
+				}
+			}
+			if (any) {
+				idle = 0;
+			} else if (++idle < 64) {
+				std::this_thread::yield();
+			} else {
+				// a push after the flag is set wakes us, the timeout
+				// covers a push that raced with setting it
+				std::unique_lock<std::mutex> lock(fWakeMutex);
+				fSleeping = true;
+				fWake.wait_for(lock, std::chrono::milliseconds(1));
+				fSleeping = false;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,117 @@
+#ifndef SRT_RECORDERQUEUE_H
+#define SRT_RECORDERQUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "Ray.h"
+#include "Recorder.h"
+
+namespace srt {
+
+	// what a recorder needs to know about an event, copied out of the handler
+	struct RecordedEvent {
+		Ray fRay;
+		Vec3 fInter;
+		Vec3 fN;
+		SurfaceProperties const* fProperty;
+		Device const* fDevice;
+		// bit i: for the i-th recorder
+		uint32_t fRecorders;
+		int32_t fLevel;
+		Event fEvent;
+		bool fHit;
+		bool fInner;
+		bool fPictrue;
+	};
+
+	// single producer, single consumer ring
+	struct EventRing {
+
+		static constexpr size_t kCapacity = 4096;
+
+		// producer, wait while the ring is full
+		void push(RecordedEvent const& e);
+		// consumer, nullptr if empty
+		RecordedEvent const* front();
+		void pop();
+		bool empty() const;
+
+	private:
+		alignas(64) std::atomic<size_t> fHead{ 0 };
+		alignas(64) std::atomic<size_t> fTail{ 0 };
+		// cached fHead of the producer
+		size_t fHeadCache = 0;
+		std::unique_ptr<RecordedEvent[]> fEvents{ new RecordedEvent[kCapacity] };
+	};
+
+	struct RecorderQueue;
+
+	// a ring owned by one tracing thread, returned to the queue on destruction
+	struct EventRingLease {
+		EventRingLease() = default;
+		EventRingLease(RecorderQueue* queue, EventRing* ring) : fQueue(queue), fRing(ring) {}
+		EventRingLease(EventRingLease&& r) noexcept;
+		EventRingLease& operator=(EventRingLease&& r) noexcept;
+		~EventRingLease();
+
+		EventRing* get() const { return fRing; }
+		void push(RecordedEvent const& e);
+
+	private:
+		RecorderQueue* fQueue = nullptr;
+		EventRing* fRing = nullptr;
+	};
+
+	// events are pushed into per thread rings by the tracing threads,
+	// a background thread pops them and calls the recorders.
+	struct RecorderQueue {
+
+		// at most 32 recorders
+		RecorderQueue(std::vector<Recorder*> const& recorders);
+		~RecorderQueue();
+
+		std::vector<Recorder*> const& recorders() const { return fRecorders; }
+		// recorders (bits) that want the event
+		uint32_t recordersOf(Event e) const { return fEventRecorders[(int)e]; }
+
+		EventRingLease acquire();
+		// wait until all the pushed events are recorded
+		void drain();
+
+		// recorders (bits) sampling the next traced ray
+		uint32_t sampleRay();
+
+	private:
+		friend struct EventRingLease;
+		void release(EventRing* ring);
+		void consume();
+		void dispatch(RecordedEvent const& e);
+		void wake();
+
+		std::vector<Recorder*> fRecorders;
+		uint32_t fEventRecorders[6] = {};
+		uint32_t fAllRecorders = 0;
+		bool fSampled = false;
+		std::atomic<uint64_t> fRays{ 0 };
+
+		std::mutex fMutex;
+		std::vector<std::unique_ptr<EventRing>> fRings;
+		std::vector<EventRing*> fFree;
+		std::atomic<size_t> fRingCount{ 0 };
+
+		std::atomic<bool> fStop{ false };
+		// the consumer sleeps on fWake when it finds nothing to do
+		std::atomic<bool> fSleeping{ false };
+		std::mutex fWakeMutex;
+		std::condition_variable fWake;
+		std::thread fConsumer;
+	};
+
+}
+
+#endif
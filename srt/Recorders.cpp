@@ -1,5 +1,6 @@
 
 #include "Recorders.h"
+#include "Random.h"
 
 namespace srt {
 
@@ -177,57 +178,180 @@ namespace srt {
 
 
 
+	void Tracking::endPath(Recording& rec)
+	{
+		rec.fOpen.clear();
+		if (rec.fPath.empty()) {
+			return;
+		}
+
+		uint64_t n = ++fSeen;
+		if (fMaxPaths == 0) {
+			std::lock_guard<std::mutex> lock(fMutex);
+			fSegments.insert(fSegments.end(), rec.fPath.begin(), rec.fPath.end());
+			fBuilt = false;
+		} else if (n <= fMaxPaths) {
+			// a later path may have replaced this slot already, the one
+			// swapped out is dropped as if it lost the draw
+			std::lock_guard<std::mutex> lock(fMutex);
+			fReservoir[n - 1].swap(rec.fPath);
+			fBuilt = false;
+		} else {
+			// keep the n-th path with probability fMaxPaths / n
+			uint64_t j = std::min(n - 1, (uint64_t)(uniformUnitary() * n));
+			if (j < fMaxPaths) {
+				std::lock_guard<std::mutex> lock(fMutex);
+				fReservoir[j].swap(rec.fPath);
+				fBuilt = false;
+			}
+		}
+		rec.fPath.clear();
+	}
+
+	void Tracking::clear()
+	{
+		fRecording.forEach([](Recording& rec) {
+			rec.fOpen.clear();
+			rec.fPath.clear();
+		});
+		fReservoir.assign(fMaxPaths, {});
+		fSegments.clear();
+		fSeen = 0;
+		fBuilt = false;
+	}
+
+	std::vector<Tracking::Segment> const& Tracking::segments() const
+	{
+		if (!fBuilt) {
+			build();
+		}
+		return fSegments;
+	}
+
 	void Tracking::record(Event event,
 		Ray const& ray,
 		int level,
 		TracingHandler& handler)
 	{
 		if (!handler.pictrue) {
+			Recording& rec = fRecording.local();
+			auto& open = rec.fOpen;
+			auto& path = rec.fPath;
 			if (event == Event::End) {
-				paths.push_back(std::move(path));
-				nodes.clear();
+				endPath(rec);
 			} if (event == Event::Generate) {
-				path.reset(new Node{ event, level, ray.fO });
-				nodes.push_back(path.get());
+				open.push_back({ ray.fO, level, 1 });
 			}
 			else if (event == Event::Escape) {
-				auto last = nodes.back();
+				Open& last = open.back();
+				path.push_back({ last.fO, normalize(ray.fD), kInfity });
 
-				last->subnodes.emplace_back(new Node{ event, level, ray.fD });
-
-				nodes.back()->cnt -= 1;
-				if (nodes.back()->cnt == 0)
-					nodes.pop_back();
+				last.fCnt -= 1;
+				if (last.fCnt == 0)
+					open.pop_back();
 			}
 			else if (event == Event::Die) {
-				auto last = nodes.back();
-
-				last->subnodes.emplace_back(new Node{ event, level, handler.inter });
+				Open& last = open.back();
+				Vec3 o = last.fO;
+				path.push_back({ o, normalize(handler.inter - o), sqrt(norm2(handler.inter - o)) });
 
-				nodes.back()->cnt -= 1;
-				if (nodes.back()->cnt == 0)
-					nodes.pop_back();
+				last.fCnt -= 1;
+				if (last.fCnt == 0)
+					open.pop_back();
 			}
 			else if (event == Event::Reflect || event == Event::Refract) {
 
-				if (nodes.back()->level + 1 == level) {
-					auto last = nodes.back();
-					last->subnodes.emplace_back(new Node{ event, level, handler.inter });
+				if (open.back().fLevel + 1 == level) {
+					Open& last = open.back();
+					Vec3 o = last.fO;
+					path.push_back({ o, normalize(handler.inter - o), sqrt(norm2(handler.inter - o)) });
 
-					nodes.back()->cnt -= 1;
-					if (nodes.back()->cnt == 0)
-						nodes.pop_back();
+					last.fCnt -= 1;
+					if (last.fCnt == 0)
+						open.pop_back();
 
-					nodes.emplace_back(last->subnodes.back().get());
+					open.push_back({ handler.inter, level, 1 });
 				}
 				else {
-					nodes.back()->cnt += 1;
+					open.back().fCnt += 1;
 				}
 
 			}
 		}
 	}
 
+	void Tracking::build() const
+	{
+		std::lock_guard<std::mutex> lock(fBuildMutex);
+		if (fBuilt) {
+			return;
+		}
+
+		if (fMaxPaths > 0) {
+			fSegments.clear();
+			for (auto& path : fReservoir) {
+				fSegments.insert(fSegments.end(), path.begin(), path.end());
+			}
+		}
+
+		AABB scene;
+		for (auto& seg : fSegments) {
+			scene.extend(seg.fO);
+			if (!std::isinf(seg.fLen)) {
+				scene.extend(seg.fO + seg.fD * seg.fLen);
+			}
+		}
+		Real size = scene.empty() ? 1 : sqrt(norm2(scene.fMax - scene.fMin));
+		if (!(size > 0)) {
+			size = 1;
+		}
+
+		// long pieces have loose boxes, so segments are cut into pieces
+		// no longer than size / kSplit. an escaped ray is cut evenly up to
+		// size, then into pieces growing by kGrowth, nothing is drawn
+		// beyond kFar * size.
+		constexpr int kSplit = 16;
+		constexpr Real kGrowth = 1.5;
+		constexpr Real kFar = 1E6;
+		Real piece = size / kSplit;
+		std::vector<Segment> pieces;
+		pieces.reserve(fSegments.size());
+		for (auto& seg : fSegments) {
+			Real len = std::isinf(seg.fLen) ? size : seg.fLen;
+			int n = std::max(1, (int)ceil(len / piece));
+			for (int i = 0; i < n; ++i) {
+				Real a = len * i / n;
+				Real b = len * (i + 1) / n;
+				pieces.push_back({ seg.fO + seg.fD * a, seg.fD, b - a });
+			}
+			if (std::isinf(seg.fLen)) {
+				for (Real a = size; a < kFar * size; a *= kGrowth) {
+					pieces.push_back({ seg.fO + seg.fD * a, seg.fD, a * (kGrowth - 1) });
+				}
+			}
+		}
+
+		// the hit point is within the radius of the axis
+		Vec3 r = { fPictrueRadius, fPictrueRadius, fPictrueRadius };
+		std::vector<AABB> boxes(pieces.size());
+		for (size_t i = 0; i < pieces.size(); ++i) {
+			Vec3 o = pieces[i].fO;
+			Vec3 e = o + pieces[i].fD * pieces[i].fLen;
+			boxes[i].extend(o - r);
+			boxes[i].extend(o + r);
+			boxes[i].extend(e - r);
+			boxes[i].extend(e + r);
+		}
+
+		std::vector<uint32_t> order;
+		buildBVH(boxes, fNodes, order);
+		fPieces.resize(pieces.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			fPieces[i] = pieces[order[i]];
+		}
+		fBuilt = true;
+	}
+
 	Real Tracking::distance(Vec3 o, Vec3 d, Real len,
 		Ray const& ray, Vec3& n) const
 	{
@@ -262,35 +386,26 @@ namespace srt {
 	void Tracking::process(Ray const& ray, ProcessHandler& handler) const
 	{
 
+		if (!fBuilt) {
+			build();
+		}
+
 		{
 			Vec3 N = Vec3{ 0,0, 1 };
 			Real smin = kInfity;
-			if (0) {
-				paths[0]->for_each([=](Node* o, Node* node) {
-					printf("%d %d (%f %f %f)\n",
-						o->level, node->level,
-						node->o.fX, node->o.fY, node->o.fZ);
-					});
-			}
 
-			for (size_t i = 0; i < paths.size(); ++i) {
-				auto& path = paths[i];
-				path->for_each([&](Node* o, Node* node) {
-					Real s;
-					if (node->event == Event::Escape) {
-						s = distance(o->o, normalize(node->o),
-							kInfity, ray, N);
-					}
-					else {
-						s = distance(o->o, normalize(node->o - o->o),
-							sqrt(norm2(node->o - o->o)), ray, N);
+			traverseBVH(fNodes.data(), fNodes.size(), ray.fO, ray.fD, smin,
+				[&](uint32_t first, uint32_t count, Real& smax) {
+					for (uint32_t i = first; i < first + count; ++i) {
+						Segment const& seg = fPieces[i];
+						Vec3 n;
+						Real s = distance(seg.fO, seg.fD, seg.fLen, ray, n);
+						if (s < smax) {
+							smax = s;
+							N = n;
+						}
 					}
-					if (s < smin) {
-						//printf("%f %f %f", ray.fD.fX, ray.fD.fY, ray.fD.fZ);
-						smin = s;
-					}
-					});
-			}
+				});
 
 			if (!std::isinf(smin)) {
 				if (handler.fType == HandlerType::Distance) {
@@ -3,21 +3,25 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <cmath>
 
 #include "Real.h"
 #include "Recorder.h"
 #include "Device.h"
+#include "BVH.h"
+#include "PerThread.h"
 
 namespace srt {
-	extern constexpr int kDebugLight = 4;
-	extern constexpr int kDebugReflect = 2;
-	extern constexpr int kDebugRefract = 1;
-	extern constexpr int kDebugEscape = 8;
-	extern constexpr int kDebugDie = 16;
-	extern constexpr int kDebugScreen = 32;
-	extern constexpr int kDebugGenerate = 64;
-	extern constexpr int kDebugEnd = 128;
+	inline constexpr int kDebugLight = 4;
+	inline constexpr int kDebugReflect = 2;
+	inline constexpr int kDebugRefract = 1;
+	inline constexpr int kDebugEscape = 8;
+	inline constexpr int kDebugDie = 16;
+	inline constexpr int kDebugScreen = 32;
+	inline constexpr int kDebugGenerate = 64;
+	inline constexpr int kDebugEnd = 128;
 
 
 
@@ -27,6 +31,14 @@ namespace srt {
 
 		Logger(int debugConfig = -1) :debugConfig(debugConfig)
 		{
+			unsigned mask = 0;
+			if (debugConfig & kDebugGenerate) mask |= eventBit(Event::Generate);
+			if (debugConfig & kDebugRefract) mask |= eventBit(Event::Refract);
+			if (debugConfig & kDebugReflect) mask |= eventBit(Event::Reflect);
+			if (debugConfig & kDebugEscape) mask |= eventBit(Event::Escape);
+			if (debugConfig & kDebugDie) mask |= eventBit(Event::Die);
+			if (debugConfig & kDebugEnd) mask |= eventBit(Event::End);
+			setEventMask(mask);
 		}
 
 		void record(Event event, // what event
@@ -45,27 +57,25 @@ namespace srt {
 	{
 	};
 
+	// draw the recorded paths as thin cylinders.
+	// segments are kept in flat arrays, a BVH over them is built
+	// by the first process() after new segments are recorded.
+	// record() is thread safe, a path is kept when it ends.
 	struct Tracking : RecorderDevice, SurfaceProperties
 	{
-		struct Node {
-			Event event;
-			int level;
-			Vec3 o{};
-			int cnt = 1;
-			std::vector<std::shared_ptr<Node>> subnodes;
-
-			template<class T>
-			void for_each(T const& t)
-			{
-				for (auto& n : subnodes) {
-					t(this, n.get());
-					n->for_each(t);
-				}
-			}
+		// a segment of a path, fLen is kInfity for escaped rays
+		struct Segment {
+			Vec3 fO;
+			Vec3 fD;
+			Real fLen;
 		};
 
-		Tracking(Real r) :
-			fPictrueRadius(r)
+		// maxPaths > 0: keep a uniform sample (reservoir) of maxPaths
+		// of all the ended paths, memory doesn't grow with emitted rays
+		Tracking(Real r, size_t maxPaths = 0) :
+			fPictrueRadius(r),
+			fMaxPaths(maxPaths),
+			fReservoir(maxPaths)
 		{
 
 		}
@@ -79,20 +89,57 @@ namespace srt {
 			Ray const& ray, Vec3& n) const;
 
 		void process(Ray const& ray, ProcessHandler& handler) const override;
+
+		// segments of the kept paths
+		std::vector<Segment> const& segments() const;
+		// number of paths ended since construction or clear()
+		uint64_t seenPaths() const { return fSeen; }
+		// not thread safe against record()
+		void clear();
+
 	private:
+		// a vertex with children still to come
+		struct Open {
+			Vec3 fO;
+			int fLevel;
+			int fCnt;
+		};
 
-		Real fPictrueRadius = 0.01;
+		// the path under recording of a thread, buffers are reused
+		struct Recording {
+			std::vector<Open> fOpen;
+			std::vector<Segment> fPath;
+		};
+
+		void endPath(Recording& rec);
+		void build() const;
 
-		std::vector<Node*> nodes;
-		std::unique_ptr<Node> path;
-		std::vector<std::unique_ptr<Node>> paths;
+		Real fPictrueRadius = 0.01;
+		size_t fMaxPaths = 0;
+
+		PerThread<Recording> fRecording;
+		std::mutex fMutex;
+		std::atomic<uint64_t> fSeen{ 0 };
+		// kept paths if fMaxPaths > 0, a replaced path gives its buffer
+		// to the thread, so no allocation once the buffers are grown.
+		// sized to fMaxPaths, the n-th path goes to [n - 1]
+		std::vector<std::vector<Segment>> fReservoir;
+		// all the segments if fMaxPaths == 0, else gathered by build()
+		mutable std::vector<Segment> fSegments;
+
+		// escaped rays are cut into pieces of growing length,
+		// fPieces is ordered as the leaves of fNodes
+		mutable std::mutex fBuildMutex;
+		mutable std::atomic<bool> fBuilt{ false };
+		mutable std::vector<Segment> fPieces;
+		mutable std::vector<BVHNode> fNodes;
 	};
 
 
 
-	inline std::shared_ptr<RecorderDevice> tracking(Real pictrueRadius)
+	inline std::shared_ptr<RecorderDevice> tracking(Real pictrueRadius, size_t maxPaths = 0)
 	{
-		return std::make_shared<Tracking>(pictrueRadius);
+		return std::make_shared<Tracking>(pictrueRadius, maxPaths);
 	}
 
 }
@@ -21,7 +21,7 @@ namespace srt {
         }
         Real pixelWidthY() const
         {
-            return (yMax - yMin) / w;
+            return (yMax - yMin) / h;
         }
 
         Real pixel2WorldX(Real x) const
@@ -39,7 +39,7 @@ namespace srt {
         }
         Real worldToPixelY(Real y) const
         {
-            return (yMax - y) / (yMax - yMin) * w;
+            return (yMax - y) / (yMax - yMin) * h;
         }
     };
 }
@@ -11,6 +11,8 @@
 #include "wavelength.h"
 #include "Bitmap.h"
 #include "Surfaces.h"
+#include "PerThread.h"
+#include "RayDump.h"
 
 namespace srt {
 	
@@ -28,7 +30,13 @@ namespace srt {
 			pars::n2Min_,
 			pars::n1Max_,
 			pars::n2Max_,
-			pars::gray_>;
+			pars::gray_,
+			pars::spectralBins_,
+			pars::lambdaMin_,
+			pars::lambdaMax_,
+			pars::mult_,
+			pars::splat_,
+			pars::splatSigma_>;
 
 		ScreenOpts(pars::argument auto const &... args)
 		{
@@ -51,7 +59,12 @@ namespace srt {
 			pars::set(N1Max, pars::n1Max, args...);
 			pars::set(N2Max, pars::n2Max, args...);
 			pars::set(Gray, pars::gray, args...);
-
+			pars::set(SpectralBins, pars::spectralBins, args...);
+			pars::set(LambdaMin, pars::lambdaMin, args...);
+			pars::set(LambdaMax, pars::lambdaMax, args...);
+			pars::set(Mult, pars::mult, args...);
+			pars::set(Splat, pars::splat, args...);
+			pars::set(SplatSigma, pars::splatSigma, args...);
 		}
 
 		int Width = 500;
@@ -67,6 +80,17 @@ namespace srt {
 		Real N2Max = 1;
 
 		bool Gray = false;
+
+		// histogram screen only, energy per wavelength bin in [LambdaMin, LambdaMax)
+		int SpectralBins = 0;
+		Real LambdaMin = LEN_MIN;
+		Real LambdaMax = LEN_MAX;
+
+		// rasterize with multiple threads
+		bool Mult = true;
+		SplatKernel Splat = SplatKernel::Nearest;
+		Real SplatSigma = 1.;
+
 		void setScreenSize(Real s)
 		{
 			N1Min = -s / 2;
@@ -76,11 +100,37 @@ namespace srt {
 		}
 	};
 
+	// strided view of the ray fields used by the raster,
+	// over an array of Ray or over the columns of a ray dump
+	struct RayBatch {
+		size_t fRows = 0;
+		// in bytes
+		size_t fStride = sizeof(Real);
+		Real const* fX = nullptr;
+		Real const* fY = nullptr;
+		Real const* fZ = nullptr;
+		Real const* fAmp = nullptr;
+		Real const* fLambda = nullptr;
+	};
+
+	RayBatch rayBatch(Ray const* rays, size_t n);
+	RayBatch rayBatch(RayDumpReader::Chunk const& chunk);
+
 	struct Raster
 	{
+		// one by one, nearest pixel
 		void raster(Bitmap&,
 			Iter<Ray>& iter,
 			ScreenOpts const& opts);
+
+		// batched, multithreaded if opts.Mult, with opts.Splat kernel
+		void raster(Bitmap&,
+			std::vector<RayBatch> const& batches,
+			ScreenOpts const& opts);
+
+		void raster(Bitmap&,
+			RayDumpReader const& reader,
+			ScreenOpts const& opts);
 	};
 
 	struct Screen {
@@ -106,21 +156,53 @@ namespace srt {
 		void recordIn2Out(bool r) { fRecordIn2Out = r; }
 		void recordOut2In(bool r) { fRecordOut2In = r; }
 
-		// file type infered from filename
+		// file type infered from filename, csv or srtrays
 		void save(std::string const& filename);
 
+		// stream the hits to a srtrays file instead of keeping them,
+		// a chunk is written each time memoryBudget bytes are buffered.
+		// with setHistogram the hits are both dumped and binned.
+		// save() and raster() throw while dumping without histogram, use
+		// Raster::raster with a RayDumpReader of the file instead
+		void setDump(std::string const& filename, size_t memoryBudget = 64 << 20);
+		// flush and close the dump file
+		void closeDump();
+
 		void raster(std::string const& filename, ScreenOpts const& opts);
 		void raster(std::ostream& os, ImageFileFormat iff, ScreenOpts const& opts);
 		void raster(Bitmap&, ScreenOpts const& opts);
 
+		// bin the hits into pixels at record time instead of storing the rays,
+		// the memory is fixed by the resolution and not by the number of rays.
+		// raster() then uses these opts and ignores the ones passed to it.
+		void setHistogram(ScreenOpts const& opts);
+		bool isHistogram() const;
+		// merged over threads, [row * Width + col]
+		std::vector<Real> histogramAmplitude() const;
+		// merged over threads, [(row * Width + col) * SpectralBins + bin]
+		std::vector<Real> histogramSpectrum() const;
+		// drop the recorded rays or histograms
+		void clearRecords();
+
 		void record(
 			Ray const& in, ProcessHandler& handler) const;
 
 	private:
+		struct Histogram {
+			std::vector<Color> fColor;
+			std::vector<Real> fAmp;
+			std::vector<Real> fSpectrum;
+		};
+		void recordHit(Vec3 const& inter, Ray const& r) const;
+
 		bool fRecordIn2Out = true;
 		bool fRecordOut2In = true;
 		mutable std::vector<Ray> fRays;
 
+		std::shared_ptr<RayDumpWriter> fDump;
+		std::shared_ptr<ScreenOpts> fHistogramOpts;
+		std::shared_ptr<PerThread<Histogram>> fHistograms;
+
 	};
 
 	struct PlaneScreen : PlaneSurface, Screen
@@ -164,6 +246,9 @@ namespace srt {
 
 
 		void process(Ray const& in, ProcessHandler& handler) const override;
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& in, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
 	};
 
 	std::shared_ptr<PlaneScreen> planeScreen(pars::argument auto const &... args)
@@ -187,6 +272,9 @@ namespace srt {
 		}
 
 		void process(Ray const& in, ProcessHandler& handler) const override;
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& in, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
 	};
 
 
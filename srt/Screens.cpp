@@ -1,12 +1,15 @@
 #include "Screen.h"
 #include "Quadric.h"
 #include "Surfaces.h"
+#include <thread>
+#include <typeinfo>
 
 namespace srt {
 
 
 	enum class fileformat {
 		CSV,
+		SRTRAYS,
 	};
 
 
@@ -17,6 +20,9 @@ namespace srt {
 		if (substr == "csv" || substr == "") {
 			return fileformat::CSV;
 		}
+		else if (substr == "srtrays") {
+			return fileformat::SRTRAYS;
+		}
 		else {
 			throw "unkown file format";
 		}
@@ -24,6 +30,12 @@ namespace srt {
 
 	void Screen::save(std::string const& file)
 	{
+		if (isHistogram()) {
+			throw std::logic_error("histogram screen doesn't keep the rays");
+		}
+		if (fDump) {
+			throw std::logic_error("dump screen doesn't keep the rays, the dump file has them");
+		}
 
 		fileformat ff = get_format(file);
 		if (ff == fileformat::CSV) {
@@ -39,6 +51,9 @@ namespace srt {
 			}
 			of.close();
 		}
+		else if (ff == fileformat::SRTRAYS) {
+			writeRays(file, fRays.data(), fRays.size());
+		}
 		else {
 			throw "unknown file format";
 		}
@@ -56,16 +71,12 @@ namespace srt {
 			{
 				if (fRecordOut2In) {
 					if (dot(r.fD, th.N) < 0) { // out 2 in
-
-						Vec3 inter = static_cast<TracingHandler&>(handler).inter;
-						fRays.push_back(Ray(inter, r.fD, r.fAmp, r));
+						recordHit(th.inter, r);
 					}
 				}
 				if (fRecordIn2Out) {
 					if (dot(r.fD, th.N) > 0) { // in 2 out
-
-						Vec3 inter = static_cast<TracingHandler&>(handler).inter;
-						fRays.push_back(Ray(inter, r.fD, r.fAmp, r));
+						recordHit(th.inter, r);
 					}
 				}
 			}
@@ -73,9 +84,7 @@ namespace srt {
 		}
 	}
 
-	void Raster::raster(Bitmap& bitmap,
-		Iter<Ray>& iter,
-		ScreenOpts const& opts)
+	static Scaler screenScaler(ScreenOpts const& opts)
 	{
 		Scaler s;
 		s.h = opts.High;
@@ -84,41 +93,437 @@ namespace srt {
 		s.xMax = opts.N1Max;
 		s.yMin = opts.N2Min;
 		s.yMax = opts.N2Max;
+		return s;
+	}
+
+	// pixel of a point on the screen, false if out of the screen
+	static bool screenPixel(ScreenOpts const& opts, Scaler const& s,
+		Vec3 const& p, int& iidx, int& jidx)
+	{
+		Real x = s.worldToPixelX(dot(p - opts.Origin, opts.N1));
+		Real y = s.worldToPixelY(dot(p - opts.Origin, opts.N2));
+		iidx = (int)floor(x);
+		jidx = (int)floor(y);
+		return iidx < opts.Width && jidx < opts.High
+			&& iidx >= 0 && jidx >= 0;
+	}
+
+	static Color screenColor(ScreenOpts const& opts, Ray const& p)
+	{
+		Color c;
+		if (opts.Gray) {
+			c = Color::white(1.);
+		}
+		else {
+			WaveLength2RGB(p.fLambda, &c.R(), &c.G(), &c.B());
+		}
+		c.cmul(p.fAmp);
+		return c;
+	}
+
+	void Raster::raster(Bitmap& bitmap,
+		Iter<Ray>& iter,
+		ScreenOpts const& opts)
+	{
+		Scaler s = screenScaler(opts);
 
 		bitmap.resize(opts.Width, opts.High);
 		bitmap.setBlack(0);
 
 		for (; !iter.end();) {
 			Ray p = iter.get();
-			Real x = s.worldToPixelX(dot(p.fO - opts.Origin, opts.N1));
-			Real y = s.worldToPixelY(dot(p.fO - opts.Origin, opts.N2));
-			int iidx = (int)floor(x);
-			int jidx = (int)floor(y);
-			if (iidx < opts.Width && jidx < opts.High
-				&& iidx >= 0 && jidx >= 0) {
-
-				Color c;
-				if (opts.Gray) {
-					c = Color::white(1.);
+			int iidx, jidx;
+			if (screenPixel(opts, s, p.fO, iidx, jidx)) {
+				bitmap.at(jidx, iidx) += screenColor(opts, p);
+			}
+			iter.next();
+		}
+		bitmap.cnormalize();
+		bitmap.setAlpha(1.);
+	}
+
+	RayBatch rayBatch(Ray const* rays, size_t n)
+	{
+		RayBatch b;
+		b.fRows = n;
+		b.fStride = sizeof(Ray);
+		if (n) {
+			b.fX = &rays->fO.fX;
+			b.fY = &rays->fO.fY;
+			b.fZ = &rays->fO.fZ;
+			b.fAmp = &rays->fAmp;
+			b.fLambda = &rays->fLambda;
+		}
+		return b;
+	}
+
+	RayBatch rayBatch(RayDumpReader::Chunk const& chunk)
+	{
+		RayBatch b;
+		b.fRows = chunk.fRows;
+		b.fStride = sizeof(Real);
+		b.fX = chunk.column(RayColumn::X);
+		b.fY = chunk.column(RayColumn::Y);
+		b.fZ = chunk.column(RayColumn::Z);
+		b.fAmp = chunk.column(RayColumn::Amp);
+		b.fLambda = chunk.column(RayColumn::Lambda);
+		return b;
+	}
+
+	// accumulate rgb of hits into a W x H x 3 buffer
+	struct SplatBuffer {
+
+		// gaussian weights are tabulated for this many sub-pixel offsets
+		static constexpr int kSubpixels = 16;
+
+		ScreenOpts const& opts;
+		Scaler s;
+		std::vector<Real> rgb;
+		// the kernels reach into the screen from a few pixels outside
+		Real margin = 1;
+		// gaussian radius and weights[offset][k], normalized
+		int radius = 0;
+		std::vector<Real> weights;
+
+		SplatBuffer(ScreenOpts const& opts) : opts(opts), s(screenScaler(opts))
+		{
+			rgb.assign((size_t)opts.Width * opts.High * 3, 0);
+			if (opts.Splat == SplatKernel::Gaussian) {
+				Real sigma = opts.SplatSigma;
+				radius = (int)ceil(3 * sigma);
+				margin = radius + 1;
+				int n = 2 * radius + 1;
+				weights.resize(kSubpixels * n);
+				for (int q = 0; q < kSubpixels; ++q) {
+					Real frac = (q + 0.5) / kSubpixels;
+					Real sum = 0;
+					for (int k = 0; k < n; ++k) {
+						Real d = k - radius + 0.5 - frac;
+						weights[q * n + k] = exp(-d * d / (2 * sigma * sigma));
+						sum += weights[q * n + k];
+					}
+					// keep the energy of the hit
+					for (int k = 0; k < n; ++k) {
+						weights[q * n + k] /= sum;
+					}
 				}
-				else {
-					WaveLength2RGB(p.fLambda, &c.R(), &c.G(), &c.B());
+			}
+		}
+
+		void add(int i, int j, Real w, Real const* c)
+		{
+			if (i < 0 || j < 0 || i >= opts.Width || j >= opts.High) {
+				return;
+			}
+			Real* p = &rgb[((size_t)j * opts.Width + i) * 3];
+			p[0] += w * c[0];
+			p[1] += w * c[1];
+			p[2] += w * c[2];
+		}
+
+		void splat(Vec3 const& p, Real amp, Real lambda)
+		{
+			Real x = s.worldToPixelX(dot(p - opts.Origin, opts.N1));
+			Real y = s.worldToPixelY(dot(p - opts.Origin, opts.N2));
+			if (!(x > -margin && y > -margin && x < opts.Width + margin && y < opts.High + margin)) {
+				return;
+			}
+
+			Real c[3];
+			if (opts.Gray) {
+				c[0] = c[1] = c[2] = amp;
+			} else {
+				WaveLength2RGB(lambda, &c[0], &c[1], &c[2]);
+				c[0] *= amp;
+				c[1] *= amp;
+				c[2] *= amp;
+			}
+
+			switch (opts.Splat) {
+			case SplatKernel::Nearest:
+				add((int)floor(x), (int)floor(y), 1, c);
+				break;
+			case SplatKernel::Bilinear:
+			{
+				// relative to the pixel centers
+				Real fx = x - 0.5;
+				Real fy = y - 0.5;
+				int i = (int)floor(fx);
+				int j = (int)floor(fy);
+				Real tx = fx - i;
+				Real ty = fy - j;
+				add(i, j, (1 - tx) * (1 - ty), c);
+				add(i + 1, j, tx * (1 - ty), c);
+				add(i, j + 1, (1 - tx) * ty, c);
+				add(i + 1, j + 1, tx * ty, c);
+				break;
+			}
+			case SplatKernel::Gaussian:
+			{
+				int n = 2 * radius + 1;
+				Real fx = floor(x);
+				Real fy = floor(y);
+				int i0 = (int)fx - radius;
+				int j0 = (int)fy - radius;
+				int qx = std::min(kSubpixels - 1, (int)((x - fx) * kSubpixels));
+				int qy = std::min(kSubpixels - 1, (int)((y - fy) * kSubpixels));
+				Real const* wx = &weights[qx * n];
+				Real const* wy = &weights[qy * n];
+				int a0 = std::max(0, -i0);
+				int a1 = std::min(n, opts.Width - i0);
+				for (int b = 0; b < n; ++b) {
+					int j = j0 + b;
+					if (j < 0 || j >= opts.High) {
+						continue;
+					}
+					Real* row = rgb.data() + (size_t)j * opts.Width * 3;
+					for (int a = a0; a < a1; ++a) {
+						Real w = wx[a] * wy[b];
+						Real* p = row + 3 * (i0 + a);
+						p[0] += w * c[0];
+						p[1] += w * c[1];
+						p[2] += w * c[2];
+					}
 				}
-				c.cmul(p.fAmp);
-				bitmap.at(jidx, iidx) += c;
+				break;
+			}
+			}
+		}
+	};
 
+	void Raster::raster(Bitmap& bitmap,
+		std::vector<RayBatch> const& batches,
+		ScreenOpts const& opts)
+	{
+		if (opts.Splat == SplatKernel::Gaussian && !(opts.SplatSigma > 0)) {
+			throw std::logic_error("splat sigma must be positive");
+		}
+
+		size_t total = 0;
+		for (auto& b : batches) {
+			total += b.fRows;
+		}
+
+		size_t pixels = (size_t)opts.Width * opts.High;
+		int nThreads = 1;
+		if (opts.Mult) {
+			nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+			// enough rays per thread to pay for its buffer
+			nThreads = (int)std::min<size_t>(nThreads, total / std::max<size_t>(pixels, 1 << 16) + 1);
+			// at most about 1GB of buffers
+			nThreads = (int)std::min<size_t>(nThreads, std::max<size_t>(1, (1ull << 30) / (pixels * 3 * sizeof(Real) + 1)));
+		}
+
+		std::vector<std::unique_ptr<SplatBuffer>> buffers(nThreads);
+		auto work = [&](int t) {
+			buffers[t] = std::make_unique<SplatBuffer>(opts);
+			SplatBuffer& buf = *buffers[t];
+
+			// rows [begin, end) of the concatenated batches
+			size_t begin = total * t / nThreads;
+			size_t end = total * (t + 1) / nThreads;
+			size_t base = 0;
+			for (auto& b : batches) {
+				size_t lo = std::max(begin, base);
+				size_t hi = std::min(end, base + b.fRows);
+				for (size_t k = lo; k < hi; ++k) {
+					size_t off = (k - base) * b.fStride;
+					auto at = [off](Real const* p) {
+						return *(Real const*)((char const*)p + off);
+					};
+					buf.splat(Vec3{ at(b.fX), at(b.fY), at(b.fZ) }, at(b.fAmp), at(b.fLambda));
+				}
+				base += b.fRows;
 			}
-			iter.next();
+		};
+
+		std::vector<std::thread> threads;
+		for (int t = 1; t < nThreads; ++t) {
+			threads.emplace_back(work, t);
 		}
+		work(0);
+		for (auto& th : threads) {
+			th.join();
+		}
+
+		bitmap.resize(opts.Width, opts.High);
+		bitmap.setBlack(0);
+
+		// reduce row bands in parallel
+		auto reduce = [&](int t) {
+			int j0 = opts.High * t / nThreads;
+			int j1 = opts.High * (t + 1) / nThreads;
+			for (int j = j0; j < j1; ++j) {
+				for (int i = 0; i < opts.Width; ++i) {
+					size_t p = ((size_t)j * opts.Width + i) * 3;
+					Real r = 0, g = 0, b = 0;
+					for (auto& buf : buffers) {
+						r += buf->rgb[p];
+						g += buf->rgb[p + 1];
+						b += buf->rgb[p + 2];
+					}
+					Color& c = bitmap.at(j, i);
+					c.R() = r;
+					c.G() = g;
+					c.B() = b;
+				}
+			}
+		};
+		threads.clear();
+		for (int t = 1; t < nThreads; ++t) {
+			threads.emplace_back(reduce, t);
+		}
+		reduce(0);
+		for (auto& th : threads) {
+			th.join();
+		}
+
 		bitmap.cnormalize();
 		bitmap.setAlpha(1.);
 	}
 
+	void Raster::raster(Bitmap& bitmap,
+		RayDumpReader const& reader,
+		ScreenOpts const& opts)
+	{
+		std::vector<RayBatch> batches;
+		for (auto& chunk : reader.chunks()) {
+			batches.push_back(rayBatch(chunk));
+		}
+		raster(bitmap, batches, opts);
+	}
+
+	void Screen::setHistogram(ScreenOpts const& opts)
+	{
+		if (opts.SpectralBins < 0 || (opts.SpectralBins > 0 && !(opts.LambdaMax > opts.LambdaMin))) {
+			throw std::logic_error("bad spectral bins");
+		}
+		fRays.clear();
+		fRays.shrink_to_fit();
+		fHistogramOpts = std::make_shared<ScreenOpts>(opts);
+		size_t pixels = (size_t)opts.Width * opts.High;
+		size_t bins = (size_t)opts.SpectralBins;
+		fHistograms = std::make_shared<PerThread<Histogram>>([pixels, bins]() {
+			Histogram h;
+			h.fColor.assign(pixels, Color(0, 0, 0, 0));
+			h.fAmp.assign(pixels, 0);
+			h.fSpectrum.assign(pixels * bins, 0);
+			return h;
+		});
+	}
+
+	void Screen::setDump(std::string const& filename, size_t memoryBudget)
+	{
+		closeDump();
+		fRays.clear();
+		fRays.shrink_to_fit();
+		fDump = std::make_shared<RayDumpWriter>(filename, memoryBudget);
+	}
+
+	void Screen::closeDump()
+	{
+		if (fDump) {
+			fDump->close();
+			fDump.reset();
+		}
+	}
+
+	bool Screen::isHistogram() const
+	{
+		return (bool)fHistogramOpts;
+	}
+
+	void Screen::clearRecords()
+	{
+		fRays.clear();
+		if (fHistograms) {
+			fHistograms->clear();
+		}
+	}
+
+	void Screen::recordHit(Vec3 const& inter, Ray const& r) const
+	{
+		if (fDump) {
+			fDump->append(Ray(inter, r.fD, r.fAmp, r));
+		}
+		if (!fHistogramOpts) {
+			if (!fDump) {
+				fRays.push_back(Ray(inter, r.fD, r.fAmp, r));
+			}
+			return;
+		}
+
+		ScreenOpts const& opts = *fHistogramOpts;
+		int iidx, jidx;
+		if (!screenPixel(opts, screenScaler(opts), inter, iidx, jidx)) {
+			return;
+		}
+		size_t pixel = (size_t)jidx * opts.Width + iidx;
+
+		Histogram& h = fHistograms->local();
+		h.fColor[pixel] += screenColor(opts, r);
+		h.fAmp[pixel] += r.fAmp;
+		if (opts.SpectralBins > 0) {
+			Real t = (r.fLambda - opts.LambdaMin) / (opts.LambdaMax - opts.LambdaMin);
+			int bin = (int)floor(t * opts.SpectralBins);
+			if (bin >= 0 && bin < opts.SpectralBins) {
+				h.fSpectrum[pixel * opts.SpectralBins + bin] += r.fAmp;
+			}
+		}
+	}
+
+	std::vector<Real> Screen::histogramAmplitude() const
+	{
+		if (!fHistogramOpts) {
+			throw std::logic_error("not a histogram screen");
+		}
+		std::vector<Real> amp((size_t)fHistogramOpts->Width * fHistogramOpts->High, 0);
+		fHistograms->forEach([&](Histogram const& h) {
+			for (size_t i = 0; i < amp.size(); ++i) {
+				amp[i] += h.fAmp[i];
+			}
+		});
+		return amp;
+	}
+
+	std::vector<Real> Screen::histogramSpectrum() const
+	{
+		if (!fHistogramOpts) {
+			throw std::logic_error("not a histogram screen");
+		}
+		std::vector<Real> spec((size_t)fHistogramOpts->Width * fHistogramOpts->High
+			* fHistogramOpts->SpectralBins, 0);
+		fHistograms->forEach([&](Histogram const& h) {
+			for (size_t i = 0; i < spec.size(); ++i) {
+				spec[i] += h.fSpectrum[i];
+			}
+		});
+		return spec;
+	}
+
 	void Screen::raster(Bitmap& bitmap, ScreenOpts const& opts)
 	{
-		auto ran = range(fRays);
+		if (fHistogramOpts) {
+			ScreenOpts const& hopts = *fHistogramOpts;
+			bitmap.resize(hopts.Width, hopts.High);
+			bitmap.setBlack(0);
+			fHistograms->forEach([&](Histogram const& h) {
+				for (int j = 0; j < hopts.High; ++j) {
+					for (int i = 0; i < hopts.Width; ++i) {
+						bitmap.at(j, i) += h.fColor[(size_t)j * hopts.Width + i];
+					}
+				}
+			});
+			bitmap.cnormalize();
+			bitmap.setAlpha(1.);
+			return;
+		}
+
+		if (fDump) {
+			throw std::logic_error("dump screen doesn't keep the rays, raster the dump file");
+		}
 		Raster rast;
-		rast.raster(bitmap, ran, opts);
+		rast.raster(bitmap, { rayBatch(fRays.data(), fRays.size()) }, opts);
 	}
 
 	void Screen::raster(std::ostream& os,
@@ -149,6 +554,21 @@ namespace srt {
 		record(in, handler);
 	}
 
+	bool QuadricScreen::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		if (typeid(*this) != typeid(QuadricScreen))
+			return false;
+		fillOriginTerms(o, terms);
+		return true;
+	}
+
+	void QuadricScreen::processFrom(Ray const& in, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		QuadricSurface::processFrom(in, terms, handler);
+		record(in, handler);
+	}
+
 
 	void PlaneScreen::process(Ray const& in, ProcessHandler& handler) const
 	{
@@ -156,4 +576,19 @@ namespace srt {
 		record(in, handler);
 	}
 
+	bool PlaneScreen::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		if (typeid(*this) != typeid(PlaneScreen))
+			return false;
+		fillOriginTerms(o, terms);
+		return true;
+	}
+
+	void PlaneScreen::processFrom(Ray const& in, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		PlaneSurface::processFrom(in, terms, handler);
+		record(in, handler);
+	}
+
 }
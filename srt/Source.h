@@ -2,6 +2,10 @@
 
 #include "Real.h"
 #include "Ray.h"
+#include "Random.h"
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 namespace srt {
 
@@ -16,6 +20,27 @@ namespace srt {
         Real fAmp = 1.;
     };
 
+    // generates from one of the sources, chosen with probability
+    // proportional to fAmp in O(1) by an alias table (Vose's method).
+    // fAmp is the sum of the sources
+    struct SourceSelecter : Source {
+
+        SourceSelecter() : Source(0) {}
+
+        void initialize(std::vector<Source*>& src);
+
+        Ray generate() override {
+            return getSource()->generate();
+        }
+
+        Source* getSource();
+
+        // column i gives source i with probability fProb[i], else fAlias[i]
+        std::vector<Real> fProb;
+        std::vector<uint32_t> fAlias;
+        std::vector<Source*>* fSrcs = nullptr;
+    };
+
 }
 
 // implementations
@@ -24,5 +49,50 @@ namespace srt {
     inline Source::Source(Real amp) : fAmp(amp)
     {
     }
+
+    inline void SourceSelecter::initialize(std::vector<Source*>& src)
+    {
+        fSrcs = &src;
+        size_t n = src.size();
+        fAmp = 0;
+        for (Source* s : src) {
+            fAmp += s->fAmp;
+        }
+
+        // the columns of small sources are filled up by large ones
+        std::vector<Real> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            scaled[i] = fAmp > 0 ? src[i]->fAmp * n / fAmp : 1;
+            (scaled[i] < 1 ? small : large).push_back((uint32_t)i);
+        }
+        fProb.assign(n, 1);
+        fAlias.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            fAlias[i] = (uint32_t)i;
+        }
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back();
+            uint32_t l = large.back();
+            small.pop_back();
+            fProb[s] = scaled[s];
+            fAlias[s] = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1;
+            if (scaled[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // what is left is 1 up to rounding, fProb is 1 already
+    }
+
+    inline Source* SourceSelecter::getSource()
+    {
+        // the column and the coin from one uniform number
+        size_t n = fProb.size();
+        Real u = uniform(0, 1) * n;
+        size_t i = std::min((size_t)u, n - 1);
+        return (*fSrcs)[u - i < fProb[i] ? i : fAlias[i]];
+    }
 }
 
@@ -39,8 +39,6 @@ namespace srt {
 
 	namespace pars {
 		struct temperature_; constexpr par<temperature_, Real> temperature;
-		struct lambdaMin_; constexpr par<lambdaMin_, Real> lambdaMin;
-		struct lambdaMax_; constexpr par<lambdaMax_, Real> lambdaMax;
 	}
 
 	std::shared_ptr<PlankLaw> plankSpectrum(Real t);
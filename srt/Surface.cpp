@@ -1,3 +1,28 @@
 #include "Surface.h"
+#include "Engine.h"
+
 namespace srt {
+
+	int Surface::crossings(Ray const& ray, Crossing* out, int max) const
+	{
+		int n = 0;
+		Ray r = ray;
+		Real s0 = 0;
+		while (n < max) {
+			TracingHandler th;
+			process(r, th);
+			if (!th.hit) {
+				break;
+			}
+			Real s = dot(th.inter - r.fO, r.fD);
+			s0 += s;
+			out[n++] = { s0, th.N, th.inner, th.inner, this };
+			if (!(s > 0)) {
+				break;
+			}
+			r.fO = th.inter;
+		}
+		return n;
+	}
+
 }
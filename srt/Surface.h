@@ -3,6 +3,7 @@
 #include "Device.h"
 #include "Vec3.h"
 #include "Bound.h"
+#include "BoundProgram.h"
 #include <vector>
 #include <string>
 #include <memory>
@@ -63,17 +64,46 @@ namespace srt {
 	}
 
 
+	struct Surface;
+
+	// where a ray crosses a surface
+	struct Crossing {
+		Real fS;
+		// gradient at the crossing, points to the outer side of fSurface
+		Vec3 fN;
+		// the ray goes from the inner to the outer side of fSurface
+		bool fIn2out;
+		// the ray leaves the solid reporting the crossing,
+		// which may be a CSG made of fSurface
+		bool fOut;
+		Surface const* fSurface;
+	};
+
 	// A surface devides the space into two parts
 	struct Surface : Device, SurfaceProperties
 	{
+		static constexpr int kMaxCrossings = 8;
 
-		Bound* getBound();
 		Bound const* getBound() const;
+		// the bound is compiled here, and again by refresh() if it was
+		// edited in place since (e.g. setXBound, shift, addBound)
 		void setBound(std::shared_ptr<Bound> b);
+		BoundProgram const& getBoundProgram() const;
 
 		// is p at the inner side of the surface ?
 		virtual bool isInner(Vec3 const& p) const = 0;
 
+		// crossings with s > gSmin in increasing s, at most max of them.
+		// a crossing is where isInner changes. the surfaces of srt ignore
+		// the bound here, the default finds the crossings one by one with
+		// process(), so it keeps the bound if process() applies it.
+		// a surface meant for CSG should override it without the bound
+		virtual int crossings(Ray const& ray, Crossing* out, int max) const;
+
+		// the box of the bound
+		AABB boundingBox() const override;
+		void refresh() const override;
+
 		static constexpr auto pars_ = Device::pars_ | SurfaceProperties::pars_ | pars::bound;
 
 
@@ -87,12 +117,17 @@ namespace srt {
 			pars::argument auto const &... args)
 		{
 			pars::set(fBound, pars::bound, args...);
+			if constexpr (pars::has<decltype(args)...>(pars::bound)) {
+				fBoundProgram.compile(fBound.get());
+			}
 			Device::set(pars::uncheck, args...);
 			SurfaceProperties::set(pars::uncheck, args...);
 		}
 
 	private:
 		std::shared_ptr<Bound> fBound;
+		// recompiled by refresh()
+		mutable BoundProgram fBoundProgram;
 	};
 	std::shared_ptr<Bound> asBound(std::shared_ptr<Surface>);
 
@@ -100,11 +135,6 @@ namespace srt {
 
 // implementation
 namespace srt {
-	inline Bound* Surface::getBound()
-	{
-		return fBound.get();
-	}
-
 	inline Bound const* Surface::getBound() const
 	{
 		return fBound.get();
@@ -113,6 +143,24 @@ namespace srt {
 	inline void Surface::setBound(std::shared_ptr<Bound> b)
 	{
 		fBound = std::move(b);
+		fBoundProgram.compile(fBound.get());
+	}
+
+	inline BoundProgram const& Surface::getBoundProgram() const
+	{
+		return fBoundProgram;
+	}
+
+	inline AABB Surface::boundingBox() const
+	{
+		return fBound ? fBound->boundingBox() : AABB::infinite();
+	}
+
+	inline void Surface::refresh() const
+	{
+		if (!fBoundProgram.same(fBound.get())) {
+			fBoundProgram.compile(fBound.get());
+		}
 	}
 
 }
@@ -1,4 +1,5 @@
 #include "Surfaces.h"
+#include <typeinfo>
 
 namespace srt {
 
@@ -41,9 +42,35 @@ namespace srt {
 	}
 
 	void PlaneSurface::process(Ray const& r, ProcessHandler& handler) const
+	{
+		process(r, dot(fP, r.fO) + fR, handler);
+	}
+
+	bool PlaneSurface::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		// a subclass may override process(), it opts in itself
+		if (typeid(*this) != typeid(PlaneSurface))
+			return false;
+		fillOriginTerms(o, terms);
+		return true;
+	}
+
+	void PlaneSurface::fillOriginTerms(Vec3 const& o, OriginTerms& terms) const
+	{
+		terms.fO = o;
+		terms.fC = dot(fP, o) + fR;
+	}
+
+	void PlaneSurface::processFrom(Ray const& r, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		process(r, terms.fC, handler);
+	}
+
+	void PlaneSurface::process(Ray const& r, Real b, ProcessHandler& handler) const
 	{
 		// <P,O+Ds> + R = 0
-		Real b = dot(fP, r.fO) + fR;
+		// b = <P,O> + R
 		Real a = dot(fP, r.fD);
 		// a s + b = 0
 
@@ -59,7 +86,7 @@ namespace srt {
 		}
 		else {
 			Vec3 inter = r.fO + r.fD * s1;
-			if (!inBound(getBound(), inter)) {
+			if (!getBoundProgram().inBound(inter)) {
 				return;
 			}
 
@@ -77,191 +104,217 @@ namespace srt {
 
 	}
 
-	void QuadricSurface::process(Ray const& r,
-		ProcessHandler& handler) const
+	int PlaneSurface::crossings(Ray const& r, Crossing* out, int max) const
+	{
+		Real b = dot(fP, r.fO) + fR;
+		Real a = dot(fP, r.fD);
+		if (a == 0 || max < 1) {
+			return 0;
+		}
+		Real s = -b / a;
+		if (!(s > gSmin)) {
+			return 0;
+		}
+		out[0] = { s, fP, a > 0, a > 0, this };
+		return 1;
+	}
+
+	// roots of a s^2 + 2 b s + c = 0, s1 <= s2, false if less than two.
+	// Delta = b^2 - a c, the small root is found without cancellation
+	static bool quadraticRoots(Real a, Real b, Real c, Real Delta, Real& s1, Real& s2)
 	{
-		// <Qx,x> + <P,x> + R = 0
-		// <Q(O+Ds>,O+Ds> + <P,O> + <P,D>s + R = 0
-
-		Vec3 D = r.fD;
-		Vec3 O = r.fO;
-		Vec3 QO = dot(fQ, O);
-		Real c = dot(QO, O)
-			+ dot(fP, O) + fR;
-		Real b = dot(QO + 0.5 * fP, D);
-		Real a = dot(dot(fQ, D), D);
-
-		// a s^2 + 2 b s + c = 0
-		// s =  (-b +- sqrt(b* b - a * c)) / a
-		// s =  c / (-b -+ sqrt(b*b-a*c))
-
-		Real Delta = b * b - a * c;
 		if (Delta <= 0) {
-			// no intersection
+			return false;
 		}
-		else {
-			Real sqrtD = sqrt(Delta);
-			Real alpha1 = (-b - sqrtD);
-			Real alpha2 = (-b + sqrtD);
-
-			Real s1, s2;
-
-			if (fabs(a * c) < 0.1 * b * b) {
-				if (b > 0) {
-					if (a == 0)
-						s1 = kInfity;
-					else
-						s1 = alpha1 / a;
-
-					s2 = c / alpha1;
-				}
-				else {
-					if (a == 0)
-						s2 = kInfity;
-					else
-						s2 = alpha2 / a;
-					s1 = c / alpha2;
-				}
-			}
-			else {
-				s1 = alpha1 / a;
-				s2 = alpha2 / a;
-			}
-			if (s2 < s1) {
-				std::swap(s1, s2);
+		Real sqrtD = sqrt(Delta);
+		Real q = b > 0 ? -b - sqrtD : -b + sqrtD;
+		s1 = a == 0 ? kInfity : q / a;
+		s2 = c / q;
+		if (s2 < s1) {
+			std::swap(s1, s2);
+		}
+		return true;
+	}
+
+	// write the roots s1, s2 (those > gSmin) of a quadric as crossings
+	template<class Gradient>
+	static int quadricCrossings(Surface const* surf, Ray const& r,
+		Real a, Real b, Real c, Real Delta, Gradient grad, Crossing* out, int max)
+	{
+		Real s[2];
+		if (!quadraticRoots(a, b, c, Delta, s[0], s[1])) {
+			return 0;
+		}
+		int n = 0;
+		for (int i = 0; i < 2 && n < max; ++i) {
+			if (s[i] > gSmin && !std::isinf(s[i])) {
+				Vec3 N = grad(r.fO + r.fD * s[i]);
+				bool in2out = dot(N, r.fD) > 0;
+				out[n++] = { s[i], N, in2out, in2out, surf };
 			}
+		}
+		return n;
+	}
+
+	int QuadricSurface::crossings(Ray const& r, Crossing* out, int max) const
+	{
+		Vec3 V;
+		Real c;
+		originTerms(r.fO, V, c);
+		Real a = directionTerm(r.fD);
+		Real b = dot(V, r.fD);
+		return quadricCrossings(this, r, a, b, c, discriminant(V, r.fD, a, b, c),
+			[this](Vec3 const& p) {
+				return gradient(p);
+			}, out, max);
+	}
+
+	int SphereSurface::crossings(Ray const& r, Crossing* out, int max) const
+	{
+		Vec3 o = r.fO - fCenter;
+		Real a = dot(r.fD, r.fD);
+		return quadricCrossings(this, r, a, dot(o, r.fD), dot(o, o) - fRadius2,
+			a * fRadius2 - norm2(cross(o, r.fD)),
+			[this](Vec3 const& p) {
+				return 2. * (p - fCenter);
+			}, out, max);
+	}
 
-			if (s1 <= gSmin && s2 <= gSmin) {
-				// surface is behind ray
+	// the nearest root (> gSmin, in the bound) of a s^2 + 2 b s + c = 0
+	template<class Gradient>
+	static void processQuadratic(Surface const* surf, Ray const& r,
+		Real a, Real b, Real c, Real Delta, Gradient grad, ProcessHandler& handler)
+	{
+		Real s1, s2;
+		if (!quadraticRoots(a, b, c, Delta, s1, s2)) {
+			// no intersection
+			return;
+		}
+		bool ok1 = s1 > gSmin && !std::isinf(s1);
+		bool ok2 = s2 > gSmin && !std::isinf(s2);
+
+		Real s;
+		Vec3 inter;
+		if (ok1 && ok2) {
+			// both are tested at once
+			Vec3 inter1 = r.fO + r.fD * s1;
+			Vec3 inter2 = r.fO + r.fD * s2;
+			bool in1, in2;
+			surf->getBoundProgram().inBound(inter1, inter2, in1, in2);
+			if (in1) {
+				inter = inter1;
+				s = s1;
+			} else if (in2) {
+				inter = inter2;
+				s = s2;
+			} else {
 				return;
 			}
-			else {
-
-				Real s;
-				Vec3 inter;
-
-				if (s1 <= gSmin/* && s2 > 0*/) {
-					inter = r.fO + r.fD * s2;
-					if (!inBound(getBound(), inter)) {
-						return;
-					}
-					s = s2;
-				}
-				else { /*s1 > 0*/
-				 // two intersections
-
-					inter = O + D * s1;
-
-					// try the first one
-					if (inBound(getBound(), inter)) {
-						s = s1;
-					}
-					else {
-						// try the second one
-						inter = O + D * s2;
-						if (inBound(getBound(), inter)) {
-							s = s2;
-						}
-						else {
-							return;
-						}
-					}
-				}
-
-				Vec3 N = normalize(fP + 2. * dot(fQ, inter));
-
-				if (handler.fType == HandlerType::Distance) {
-					static_cast<DistanceHandler&>(handler).distance(s, dot(N, r.fD) > 0);
-					return;
-				}
-
-
-				if (handler.fType == HandlerType::Tracing) {
-					static_cast<TracingHandler&>(handler).hitSurface(inter,
-						N, dot(N, r.fD) > 0, this, this);
-					return;
-				}
+		} else if (ok1 || ok2) {
+			s = ok1 ? s1 : s2;
+			inter = r.fO + r.fD * s;
+			if (!surf->getBoundProgram().inBound(inter)) {
+				return;
 			}
+		} else {
+			// surface is behind ray
+			return;
+		}
+
+		Vec3 N = normalize(grad(inter));
+		if (handler.fType == HandlerType::Distance) {
+			static_cast<DistanceHandler&>(handler).distance(s, dot(N, r.fD) > 0);
+		} else if (handler.fType == HandlerType::Tracing) {
+			static_cast<TracingHandler&>(handler).hitSurface(inter,
+				N, dot(N, r.fD) > 0, surf, surf);
 		}
 	}
 
+	void QuadricSurface::process(Ray const& r,
+		ProcessHandler& handler) const
+	{
+		Vec3 V;
+		Real c;
+		originTerms(r.fO, V, c);
+		process(r, V, c, handler);
+	}
+
+	bool QuadricSurface::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		// a subclass may override process(), it opts in itself
+		if (typeid(*this) != typeid(QuadricSurface))
+			return false;
+		fillOriginTerms(o, terms);
+		return true;
+	}
+
+	void QuadricSurface::fillOriginTerms(Vec3 const& o, OriginTerms& terms) const
+	{
+		terms.fO = o;
+		originTerms(o, terms.fV, terms.fC);
+	}
+
+	void QuadricSurface::processFrom(Ray const& r, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		process(r, terms.fV, terms.fC, handler);
+	}
+
+	void QuadricSurface::process(Ray const& r, Vec3 const& V, Real c,
+		ProcessHandler& handler) const
+	{
+		// f(O + Ds) = a s^2 + 2 b s + c = 0, the terms are computed by
+		// the kernel of the kind (sphere, tube, conic or general)
+		Real a = directionTerm(r.fD);
+		Real b = dot(V, r.fD);
+		processQuadratic(this, r, a, b, c, discriminant(V, r.fD, a, b, c),
+			[this](Vec3 const& p) {
+				return gradient(p);
+			}, handler);
+	}
+
 	std::string to_string(QuadricSurface const& q) {
 		return std::format("Q = {};\nP = {};\nR = {}\n", q.fQ, q.fP, q.fR);
 	}
 
 	void SphereSurface::process(Ray const& r,
 		ProcessHandler& handler) const {
-		// <Qx,x> + <P,x> + R = 0
-		// <Q(O+Ds>,O+Ds> + <P,O> + <P,D>s + R = 0
-
-		Vec3 D = r.fD;
-		Vec3 O = r.fO;
-		Real c =  dot(fP + O, O) + fR;
-		Real b = dot(O + 0.5 * fP, D);
-
-		// s^2 + 2 b s + c = 0
-		// s =  -b +- sqrt(b* b - c)
-		// s =  c / (-b -+ sqrt(b*b-c))
+		Vec3 o = r.fO - fCenter;
+		process(r, o, dot(o, o) - fRadius2, handler);
+	}
 
-		Real Delta = b * b - c;
-		if (Delta <= 0) {
-			// no intersection
-		} else {
+	bool SphereSurface::precomputeOrigin(Vec3 const& o, OriginTerms& terms) const
+	{
+		// a subclass may override process(), it opts in itself
+		if (typeid(*this) != typeid(SphereSurface))
+			return false;
+		fillOriginTerms(o, terms);
+		return true;
+	}
 
-			Real s;
-			Vec3 inter;
-			Real sqrtD = sqrt(Delta);
-			Real s1 = (-b - sqrtD);
-			Real s2 = (-b + sqrtD);
-			// -b + sqrt(b*b-c) < smin
-			// b*b - c < 2*smin*b+b*b
-			// c > -2*b*smin
-			if (s2 <= gSmin) {
-				// surface is behind ray
-				return;
-			} else {
+	void SphereSurface::fillOriginTerms(Vec3 const& o, OriginTerms& terms) const
+	{
+		terms.fO = o;
+		terms.fV = o - fCenter;
+		terms.fC = dot(terms.fV, terms.fV) - fRadius2;
+	}
 
+	void SphereSurface::processFrom(Ray const& r, OriginTerms const& terms,
+		ProcessHandler& handler) const
+	{
+		process(r, terms.fV, terms.fC, handler);
+	}
 
-				if (s1 <= gSmin/* && s2 > 0*/) {
-					inter = r.fO + r.fD * s2;
-					if (!inBound(getBound(), inter)) {
-						return;
-					}
-					s = s2;
-				} else { /*s1 > 0*/
-				 // two intersections
-
-					inter = O + D * s1;
-
-					// try the first one
-					if (inBound(getBound(), inter)) {
-						s = s1;
-					} else {
-						// try the second one
-						inter = O + D * s2;
-						if (inBound(getBound(), inter)) {
-							s = s2;
-						} else {
-							return;
-						}
-					}
-				}
-
-				Vec3 N = normalize(fP + 2. * inter);
-
-				if (handler.fType == HandlerType::Distance) {
-					static_cast<DistanceHandler&>(handler).distance(s, dot(N, r.fD) > 0);
-					return;
-				}
-
-
-				if (handler.fType == HandlerType::Tracing) {
-					static_cast<TracingHandler&>(handler).hitSurface(inter,
-						N, dot(N, r.fD) > 0, this, this);
-					return;
-				}
-			}
-		}
+	void SphereSurface::process(Ray const& r, Vec3 const& V, Real c,
+		ProcessHandler& handler) const {
+		// |O + Ds - center|^2 - radius^2 = 0
+		// b^2 - a c = a radius^2 - |V x D|^2 has no cancellation for far spheres
+		Real a = dot(r.fD, r.fD);
+		processQuadratic(this, r, a, dot(V, r.fD), c,
+			a * fRadius2 - norm2(cross(V, r.fD)),
+			[this](Vec3 const& p) {
+				return 2. * (p - fCenter);
+			}, handler);
 	}
 
 	ShiftSurface::ShiftSurface(std::shared_ptr<Surface> sur, Vec3 s) {
@@ -273,7 +326,19 @@ namespace srt {
 	{
 		Ray ray = r;
 		ray.shift(-fShift);
-		fOrigin->process(r, handler);
+		if (handler.fType == HandlerType::Tracing) {
+			TracingHandler& h = static_cast<TracingHandler&>(handler);
+			bool hit = h.hit;
+			h.hit = false;
+			fOrigin->process(ray, handler);
+			if (h.hit) {
+				h.inter += fShift;
+			} else {
+				h.hit = hit;
+			}
+		} else {
+			fOrigin->process(ray, handler);
+		}
 	}
 
 	bool ShiftSurface::isInner(Vec3 const& p) const
@@ -281,6 +346,29 @@ namespace srt {
 		return fOrigin->isInner(p - fShift);
 	}
 
+	int ShiftSurface::crossings(Ray const& r, Crossing* out, int max) const
+	{
+		Ray ray = r;
+		ray.shift(-fShift);
+		return fOrigin->crossings(ray, out, max);
+	}
+
+	AABB ShiftSurface::boundingBox() const
+	{
+		AABB box = fOrigin->boundingBox();
+		if (box.bounded()) {
+			box.fMin += fShift;
+			box.fMax += fShift;
+		}
+		return box;
+	}
+
+	void ShiftSurface::refresh() const
+	{
+		Surface::refresh();
+		fOrigin->refresh();
+	}
+
 	void ShiftSurface::shift(Vec3 const& p) {
 		fShift += p;
 	}
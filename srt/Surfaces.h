@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <vector>
+#include <format>
 #include "Surface.h"
 #include "Ray.h"
 #include "Plane.h"
@@ -40,6 +41,18 @@ namespace srt {
 		}
 
 		void process(Ray const& in, ProcessHandler& handler) const override;
+		int crossings(Ray const& ray, Crossing* out, int max) const override;
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& in, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
+
+	protected:
+		void fillOriginTerms(Vec3 const& o, OriginTerms& terms) const;
+
+	private:
+		// V and c: see Quadric::originTerms
+		void process(Ray const& in, Vec3 const& V, Real c,
+			ProcessHandler& handler) const;
 	};
 
 	std::shared_ptr<QuadricSurface> quadricSurface(pars::argument auto const &... args) {
@@ -65,7 +78,7 @@ namespace std {
 		auto format(T const& p, auto& fc) {
 			return strfmt.format(to_string(p), fc);
 		}
-
+
 	};
 
 	template<class CharT>
@@ -83,10 +96,9 @@ namespace std {
 
 namespace srt {
 
-	// not test yet! don't use!
-	// not test yet! don't use!
-	// not test yet! don't use!
- 	struct SphereSurface : Surface, Sphere {
+	// a sphere without the matrix of a quadric,
+	// same as a QuadricSurface set by setSphere
+	struct SphereSurface : Surface, Sphere {
 
 		static constexpr auto pars_ = Surface::pars_ | Sphere::pars_;
 
@@ -99,7 +111,7 @@ namespace srt {
 		}
 
 		void set(pars::argument auto const &... args) {
-			pars::check(pars, args...);
+			pars::check(pars_, args...);
 			set(pars::uncheck, args...);
 		}
 
@@ -113,8 +125,25 @@ namespace srt {
 		}
 
 		void process(Ray const& in, ProcessHandler& handler) const override;
+		int crossings(Ray const& ray, Crossing* out, int max) const override;
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& in, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
+
+	protected:
+		void fillOriginTerms(Vec3 const& o, OriginTerms& terms) const;
+
+	private:
+		// V = O - center, c = |V|^2 - radius^2
+		void process(Ray const& in, Vec3 const& V, Real c,
+			ProcessHandler& handler) const;
 	};
 
+	std::shared_ptr<SphereSurface> sphereSurface(pars::argument auto const &... args) {
+		pars::check(SphereSurface::pars_, args...);
+		return std::make_shared<SphereSurface>(args...);
+	}
+
 
 	struct PlaneSurface : Surface, Plane
 	{
@@ -143,6 +172,17 @@ namespace srt {
 		bool isInner(Vec3 const& p) const override;
 		void setGridTexture(Real w);
 		void process(Ray const& r, ProcessHandler& handler) const override;
+		int crossings(Ray const& ray, Crossing* out, int max) const override;
+		bool precomputeOrigin(Vec3 const& o, OriginTerms& terms) const override;
+		void processFrom(Ray const& r, OriginTerms const& terms,
+			ProcessHandler& handler) const override;
+
+	protected:
+		void fillOriginTerms(Vec3 const& o, OriginTerms& terms) const;
+
+	private:
+		// b = <P,O> + R
+		void process(Ray const& r, Real b, ProcessHandler& handler) const;
 	};
 
 	std::shared_ptr<PlaneSurface> planeSurface(pars::argument auto const &... args)
@@ -157,6 +197,9 @@ namespace srt {
 		ShiftSurface(std::shared_ptr<Surface> sur, Vec3 s);
 		void process(Ray const& r, ProcessHandler& handler) const override;
 		bool isInner(Vec3 const& p) const override;
+		int crossings(Ray const& ray, Crossing* out, int max) const override;
+		AABB boundingBox() const override;
+		void refresh() const override;
 		void shift(Vec3 const &p);
 	private:
 		Vec3 fShift;
@@ -165,12 +208,12 @@ namespace srt {
 
 	std::shared_ptr<ShiftSurface> shift(std::shared_ptr<Surface> sur, Vec3 const& s);
 
-	inline std::shared_ptr<ShiftSurface> inverse(std::shared_ptr<QuadricSurface> sur)
+	// the inner and the outer sides swapped
+	inline std::shared_ptr<QuadricSurface> inverse(std::shared_ptr<QuadricSurface> sur)
 	{
 		auto newsur = std::make_shared<QuadricSurface>(*sur);
-		newsur->fP = -sur->fP;
-		newsur->fR = -sur->fR;
-		newsur->fQ = -sur->fQ;
+		newsur->invert();
+		return newsur;
 	}
 	
 	inline std::shared_ptr<PlaneSurface> inverse(std::shared_ptr<PlaneSurface> sur)
@@ -178,6 +221,7 @@ namespace srt {
 		auto newsur = std::make_shared<PlaneSurface>(*sur);
 		newsur->fP = -sur->fP;
 		newsur->fR = -sur->fR;
+		return newsur;
 	}
 
 }
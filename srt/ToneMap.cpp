@@ -0,0 +1,116 @@
+#include "ToneMap.h"
+#include <math.h>
+#include <algorithm>
+
+namespace srt {
+
+	// rec. 709 luminance
+	static Real luminance(Color const& c)
+	{
+		return 0.2126 * c.R() + 0.7152 * c.G() + 0.0722 * c.B();
+	}
+
+	void exposure(Bitmap& bitmap, Real stops)
+	{
+		if (stops == 0) {
+			return;
+		}
+		Real s = exp2(stops);
+		for (auto& c : bitmap.fC) {
+			c.cmul(s);
+		}
+	}
+
+	static void clamp1(Color& c)
+	{
+		c.R() = std::min<Real>(c.R(), 1);
+		c.G() = std::min<Real>(c.G(), 1);
+		c.B() = std::min<Real>(c.B(), 1);
+	}
+
+	void toneMapClip(Bitmap& bitmap, Real clip, Real stops)
+	{
+		bitmap.cnormalize();
+		// the brightest channel after clipping the image at 0 stops
+		Real ref = 0;
+		for (auto& c : bitmap.fC) {
+			Real s = c.sum();
+			ref = std::max(ref, s > clip ? c.cmax() * clip / s : c.cmax());
+		}
+		if (ref <= 0) {
+			return;
+		}
+		Real e = exp2(stops);
+		for (auto& c : bitmap.fC) {
+			c.cmul(e);
+			Real s = c.sum();
+			if (s > clip) {
+				c.cmul(clip / s);
+			}
+			c.cmul(1 / ref);
+			clamp1(c);
+		}
+	}
+
+	void toneMapReinhard(Bitmap& bitmap, Real white, Real stops)
+	{
+		Real maxL = 0;
+		for (auto& c : bitmap.fC) {
+			maxL = std::max(maxL, luminance(c));
+		}
+		if (maxL <= 0) {
+			return;
+		}
+		// scale so the brightest pixel has luminance 1 at 0 stops
+		Real scale = exp2(stops) / maxL;
+		Real w2 = white * white;
+		for (auto& c : bitmap.fC) {
+			Real L = luminance(c) * scale;
+			if (L <= 0) {
+				c = Color::black(c.A());
+				continue;
+			}
+			Real Ld = L * (1 + L / w2) / (1 + L);
+			c.cmul(scale * Ld / L);
+			clamp1(c);
+		}
+	}
+
+	// Narkowicz's fit of the ACES reference curve
+	static Real filmic(Real x)
+	{
+		x = std::max<Real>(x, 0);
+		Real y = (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14);
+		return std::min<Real>(y, 1);
+	}
+
+	void toneMapFilmic(Bitmap& bitmap)
+	{
+		for (auto& c : bitmap.fC) {
+			c.R() = filmic(c.R());
+			c.G() = filmic(c.G());
+			c.B() = filmic(c.B());
+		}
+	}
+
+	void toneMap(Bitmap& bitmap, ToneMap const& tm)
+	{
+		if (tm.fOperator == ToneMapOperator::Clip) {
+			toneMapClip(bitmap, tm.fClip, tm.fExposure);
+		} else if (tm.fOperator == ToneMapOperator::Reinhard) {
+			toneMapReinhard(bitmap, tm.fWhite, tm.fExposure);
+		} else if (tm.fOperator == ToneMapOperator::Filmic) {
+			exposure(bitmap, tm.fExposure);
+			toneMapFilmic(bitmap);
+		}
+	}
+
+	void toneMap(std::string const& input, std::string const& output, ToneMap const& tm)
+	{
+		Bitmap bitmap;
+		bitmap.read(input);
+		toneMap(bitmap, tm);
+		bitmap.write(output);
+	}
+
+}
@@ -0,0 +1,48 @@
+#ifndef SRT_TONEMAP_H
+#define SRT_TONEMAP_H
+
+#include <string>
+#include "Bitmap.h"
+
+namespace srt {
+
+	// all operators work on linear colors and leave alpha alone,
+	// the result is in [0, 1], ready for an 8 bits write.
+	// Clip and Reinhard take their reference level from the image before
+	// the exposure, so +1 stop makes the result twice as bright.
+	enum class ToneMapOperator {
+		// cnormalize, cclip(fClip), cnormalize: what the examples do
+		Clip,
+		// extended reinhard on luminance, fWhite is the white point
+		// relative to the brightest pixel
+		Reinhard,
+		// ACES filmic curve fit, per channel
+		Filmic,
+	};
+
+	struct ToneMap {
+		ToneMapOperator fOperator = ToneMapOperator::Clip;
+		// in stops, applied before the operator
+		Real fExposure = 0;
+		// of Clip
+		Real fClip = 0.05;
+		// of Reinhard
+		Real fWhite = 1;
+	};
+
+	// multiply the color by 2^stops
+	void exposure(Bitmap& bitmap, Real stops);
+
+	void toneMapClip(Bitmap& bitmap, Real clip, Real stops = 0);
+	void toneMapReinhard(Bitmap& bitmap, Real white, Real stops = 0);
+	void toneMapFilmic(Bitmap& bitmap);
+
+	void toneMap(Bitmap& bitmap, ToneMap const& tm);
+
+	// read a linear image (PFM or EXR), tone map it, and write it
+	// in the format of the extension of output
+	void toneMap(std::string const& input, std::string const& output, ToneMap const& tm);
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include "Transform.h"
+#include <stdexcept>
+
+namespace srt {
+
+	Transform Transform::inverse() const
+	{
+		Real d = det();
+		if (d == 0 || !std::isfinite(d)) {
+			throw std::logic_error("singular transform");
+		}
+		// columns of the inverse are the cross products of the rows
+		Vec3 c0 = cross(fM[1], fM[2]) / d;
+		Vec3 c1 = cross(fM[2], fM[0]) / d;
+		Vec3 c2 = cross(fM[0], fM[1]) / d;
+		Transform inv;
+		inv.fM[0] = { c0.fX, c1.fX, c2.fX };
+		inv.fM[1] = { c0.fY, c1.fY, c2.fY };
+		inv.fM[2] = { c0.fZ, c1.fZ, c2.fZ };
+		inv.fT = -inv.vector(fT);
+		return inv;
+	}
+
+	Transform operator*(Transform const& a, Transform const& b)
+	{
+		Transform t;
+		for (int i = 0; i < 3; ++i) {
+			t.fM[i] = b.transposed(a.fM[i]);
+		}
+		t.fT = a.point(b.fT);
+		return t;
+	}
+
+	Transform translation(Vec3 const& t)
+	{
+		Transform r;
+		r.fT = t;
+		return r;
+	}
+
+	Transform rotation(Vec3 const& axis, Real angle)
+	{
+		Vec3 u = normalize(axis);
+		Real c = cos(angle);
+		Real s = sin(angle);
+		Real k = 1 - c;
+		Transform r;
+		r.fM[0] = { c + u.fX * u.fX * k, u.fX * u.fY * k - u.fZ * s, u.fX * u.fZ * k + u.fY * s };
+		r.fM[1] = { u.fY * u.fX * k + u.fZ * s, c + u.fY * u.fY * k, u.fY * u.fZ * k - u.fX * s };
+		r.fM[2] = { u.fZ * u.fX * k - u.fY * s, u.fZ * u.fY * k + u.fX * s, c + u.fZ * u.fZ * k };
+		return r;
+	}
+
+	Transform scaling(Real s)
+	{
+		return scaling(Vec3{ s, s, s });
+	}
+
+	Transform scaling(Vec3 const& s)
+	{
+		Transform r;
+		r.fM[0] = { s.fX, 0, 0 };
+		r.fM[1] = { 0, s.fY, 0 };
+		r.fM[2] = { 0, 0, s.fZ };
+		return r;
+	}
+
+}
@@ -0,0 +1,61 @@
+#ifndef SRT_TRANSFORM_H
+#define SRT_TRANSFORM_H
+
+#include "Real.h"
+#include "Vec3.h"
+
+namespace srt {
+
+	// affine transform p -> M p + T
+	struct Transform {
+		// rows of M
+		Vec3 fM[3] = { {1, 0, 0}, {0, 1, 0}, {0, 0, 1} };
+		Vec3 fT = { 0, 0, 0 };
+
+		Vec3 point(Vec3 const& p) const;
+		// M v
+		Vec3 vector(Vec3 const& v) const;
+		// M^T v, a normal is mapped by the transposed inverse
+		Vec3 transposed(Vec3 const& v) const;
+		Real det() const;
+		// throw if M is singular
+		Transform inverse() const;
+	};
+
+	// first b, then a
+	Transform operator*(Transform const& a, Transform const& b);
+
+	Transform translation(Vec3 const& t);
+	// right handed, angle in radian
+	Transform rotation(Vec3 const& axis, Real angle);
+	Transform scaling(Real s);
+	Transform scaling(Vec3 const& s);
+
+}
+
+// implementation
+namespace srt {
+
+	inline Vec3 Transform::point(Vec3 const& p) const
+	{
+		return vector(p) + fT;
+	}
+
+	inline Vec3 Transform::vector(Vec3 const& v) const
+	{
+		return { dot(fM[0], v), dot(fM[1], v), dot(fM[2], v) };
+	}
+
+	inline Vec3 Transform::transposed(Vec3 const& v) const
+	{
+		return fM[0] * v.fX + fM[1] * v.fY + fM[2] * v.fZ;
+	}
+
+	inline Real Transform::det() const
+	{
+		return dot(fM[0], cross(fM[1], fM[2]));
+	}
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "../Pars.h"
 #include "PositionSampler.h"
+#include "PlaneRegion.h"
 
 namespace srt {
 
@@ -61,6 +62,9 @@ namespace srt {
 		Vec3 fN1, fN2;
 		Real fN1B0, fN1B1, fN2B0, fN2B1;
 		std::shared_ptr<Bound> fBound;
+		// rebuilt when the plane, the bound, or the limits of a box or
+		// quadric bound change. other bounds are tested on each sample
+		PlaneRegion fRegion;
 	};
 
 	inline void PlanePosSampler::setNorms(Vec3 n1, Vec3 n2)
@@ -71,16 +75,11 @@ namespace srt {
 
 	inline Vec3 PlanePosSampler::sample(Vec3& norm)
 	{
-		for (;;) {
-			Real n1 = uniform(fN1B0, fN1B1);
-			Real n2 = uniform(fN2B0, fN2B1);
-			Vec3 v = fO + fN1 * n1 + fN2 * n2;
-
-			if (inBound(getBound(), v)) {
-				norm = normalize(cross(fN1, fN2));
-				return v;
-			}
+		if (!fRegion.same(fO, fN1, fN2, fN1B0, fN1B1, fN2B0, fN2B1, getBound())) {
+			fRegion.set(fO, fN1, fN2, fN1B0, fN1B1, fN2B0, fN2B1, getBound());
 		}
+		norm = normalize(cross(fN1, fN2));
+		return fRegion.sample();
 	}
 
 	std::shared_ptr<PlanePosSampler> planePositionSampler(
@@ -0,0 +1,172 @@
+#include <stdexcept>
+#include <algorithm>
+
+#include "PlaneRegion.h"
+
+#include "../Random.h"
+#include "../Bound.h"
+#include "../Bounds.h"
+
+namespace srt {
+
+	static bool sameVec(Vec3 const& a, Vec3 const& b)
+	{
+		return a.fX == b.fX && a.fY == b.fY && a.fZ == b.fZ;
+	}
+
+	static Real component(Vec3 const& v, int k)
+	{
+		return k == 0 ? v.fX : k == 1 ? v.fY : v.fZ;
+	}
+
+	// the axis of a unit vector along an axis, else -1
+	static int axisOf(Vec3 const& n)
+	{
+		Real const eps = 1E-12;
+		for (int k = 0; k < 3; ++k) {
+			if (fabs(fabs(component(n, k)) - 1) < eps) {
+				return k;
+			}
+		}
+		return -1;
+	}
+
+	// [lo, hi] of the coordinate along n (n along axis k) inside (b0, b1)
+	static void clipAxis(Real o, Real n, Real b0, Real b1, Real& lo, Real& hi)
+	{
+		Real a = (b0 - o) / n;
+		Real b = (b1 - o) / n;
+		if (a > b) {
+			std::swap(a, b);
+		}
+		lo = std::max(lo, a);
+		hi = std::min(hi, b);
+	}
+
+	void PlaneRegion::boundParams(Real (&out)[kBoundParams]) const
+	{
+		if (fBoundKind == BoundKind::Box) {
+			auto box = static_cast<BoxBound const*>(fBound);
+			Real b[kBoundParams] = { box->fX0, box->fX1, box->fY0, box->fY1, box->fZ0, box->fZ1 };
+			std::copy(b, b + kBoundParams, out);
+		} else if (fBoundKind == BoundKind::Quadric) {
+			auto q = static_cast<QuadricBound const*>(fBound);
+			// the kind and the side in one number
+			Real b[kBoundParams] = { q->fCenter.fX, q->fCenter.fY, q->fCenter.fZ,
+				q->fAxis.fX, q->fAxis.fY, q->fAxis.fZ,
+				q->fRadius2, q->fSign * (1 + (int)q->fKind) };
+			std::copy(b, b + kBoundParams, out);
+		}
+	}
+
+	void PlaneRegion::set(Vec3 o, Vec3 n1, Vec3 n2,
+		Real u0, Real u1, Real v0, Real v1, Bound const* bound)
+	{
+		fO = o;
+		fN1 = n1;
+		fN2 = n2;
+		fU0 = fIn[0] = u0;
+		fU1 = fIn[1] = u1;
+		fV0 = fIn[2] = v0;
+		fV1 = fIn[3] = v1;
+		fBound = bound;
+		fSet = true;
+		fShape = Shape::Any;
+		fBoundKind = BoundKind::Other;
+
+		Vec3 n3 = cross(n1, n2);
+		if (!bound) {
+			fShape = Shape::Rect;
+		} else if (auto box = dynamic_cast<BoxBound const*>(bound)) {
+			fBoundKind = BoundKind::Box;
+			int k1 = axisOf(n1);
+			int k2 = axisOf(n2);
+			if (k1 >= 0 && k2 >= 0 && k1 != k2) {
+				int k3 = 3 - k1 - k2;
+				Real b0[3] = { box->fX0, box->fY0, box->fZ0 };
+				Real b1[3] = { box->fX1, box->fY1, box->fZ1 };
+				clipAxis(component(o, k1), component(n1, k1), b0[k1], b1[k1], fU0, fU1);
+				clipAxis(component(o, k2), component(n2, k2), b0[k2], b1[k2], fV0, fV1);
+				Real o3 = component(o, k3);
+				if (!(o3 > b0[k3] && o3 < b1[k3])) {
+					fU1 = fU0;
+				}
+				fShape = Shape::Rect;
+			}
+		} else if (auto q = dynamic_cast<QuadricBound const*>(bound)) {
+			fBoundKind = BoundKind::Quadric;
+			Vec3 c = q->fCenter - o;
+			Real r2 = -1;
+			if (q->fSign > 0 && q->fKind == QuadricKind::Tube
+				&& fabs(fabs(dot(normalize(q->fAxis), n3)) - 1) < 1E-9) {
+				r2 = q->fRadius2;
+			} else if (q->fSign > 0 && q->fKind == QuadricKind::Sphere) {
+				r2 = q->fRadius2 - Sqr(dot(c, n3));
+				if (r2 <= 0) {
+					fU1 = fU0;
+				}
+			}
+			if (r2 > 0) {
+				fCU = dot(c, n1);
+				fCV = dot(c, n2);
+				fRadius = sqrt(r2);
+				fDiskInside = fCU - fRadius >= fU0 && fCU + fRadius <= fU1
+					&& fCV - fRadius >= fV0 && fCV + fRadius <= fV1;
+				fU0 = std::max(fU0, fCU - fRadius);
+				fU1 = std::min(fU1, fCU + fRadius);
+				fV0 = std::max(fV0, fCV - fRadius);
+				fV1 = std::min(fV1, fCV + fRadius);
+				fShape = Shape::Disk;
+			}
+		}
+
+		boundParams(fBoundIn);
+
+		if (!(fU0 < fU1 && fV0 < fV1)) {
+			throw std::logic_error("nothing of the plane rectangle is in its bound");
+		}
+	}
+
+	bool PlaneRegion::same(Vec3 o, Vec3 n1, Vec3 n2,
+		Real u0, Real u1, Real v0, Real v1, Bound const* bound) const
+	{
+		if (!(fSet && sameVec(o, fO) && sameVec(n1, fN1) && sameVec(n2, fN2)
+			&& u0 == fIn[0] && u1 == fIn[1] && v0 == fIn[2] && v1 == fIn[3]
+			&& bound == fBound)) {
+			return false;
+		}
+		// the bound may have been moved or resized in place, e.g. by
+		// setXBound or shift. other bounds are tested on each sample
+		if (fBoundKind != BoundKind::Other) {
+			Real b[kBoundParams];
+			boundParams(b);
+			return std::equal(b, b + kBoundParams, fBoundIn);
+		}
+		return true;
+	}
+
+	bool PlaneRegion::inDisk(Vec3 const& p) const
+	{
+		Vec3 d = p - fO;
+		return Sqr(dot(d, fN1) - fCU) + Sqr(dot(d, fN2) - fCV) < Sqr(fRadius);
+	}
+
+	Vec3 PlaneRegion::sample() const
+	{
+		if (fShape == Shape::Disk && fDiskInside) {
+			Real r = fRadius * sqrt(uniform(0, 1));
+			Real phi = uniform(0, 2 * kPi);
+			return fO + (fCU + r * cos(phi)) * fN1 + (fCV + r * sin(phi)) * fN2;
+		}
+		for (;;) {
+			Real u = uniform(fU0, fU1);
+			Real v = uniform(fV0, fV1);
+			Vec3 p = fO + u * fN1 + v * fN2;
+			if (fShape == Shape::Rect
+				|| (fShape == Shape::Disk ? inDisk(p) : inBound(fBound, p))) {
+				return p;
+			}
+		}
+	}
+
+}
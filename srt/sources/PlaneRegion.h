@@ -0,0 +1,73 @@
+#pragma once
+#include "../Real.h"
+#include "../Vec3.h"
+
+namespace srt {
+
+	struct Bound;
+
+	// the part of the rectangle o + u n1 + v n2, u in [u0, u1], v in [v0, v1],
+	// inside a bound, as sampled by PlaneStop and PlanePosSampler.
+	// a BoxBound along n1 and n2 clips the rectangle (Rect), a tube along
+	// the normal or a sphere cuts a disk of it (Disk), both are sampled
+	// without rejection. other bounds are left to rejection by inBound (Any)
+	struct PlaneRegion {
+
+		enum class Shape {
+			Rect,
+			Disk,
+			Any,
+		};
+
+		// n1 and n2 are unit and orthogonal
+		void set(Vec3 o, Vec3 n1, Vec3 n2,
+			Real u0, Real u1, Real v0, Real v1, Bound const* bound);
+		// set() was called with these, and the parameters of a box or
+		// quadric bound are as they were then
+		bool same(Vec3 o, Vec3 n1, Vec3 n2,
+			Real u0, Real u1, Real v0, Real v1, Bound const* bound) const;
+
+		// dProb = dA
+		Vec3 sample() const;
+		// of Disk
+		bool inDisk(Vec3 const& p) const;
+
+		// the rectangle sampled: the whole one for Any, clipped to the box
+		// for Rect, and to the square around the disk for Disk
+		Vec3 corner() const { return fO + fU0 * fN1 + fV0 * fN2; }
+		Vec3 edge1() const { return (fU1 - fU0) * fN1; }
+		Vec3 edge2() const { return (fV1 - fV0) * fN2; }
+
+		Shape fShape = Shape::Any;
+		Vec3 fO;
+		Vec3 fN1;
+		Vec3 fN2;
+		Real fU0 = 0;
+		Real fU1 = 0;
+		Real fV0 = 0;
+		Real fV1 = 0;
+		// center (in u, v) and radius of Disk
+		Real fCU = 0;
+		Real fCV = 0;
+		Real fRadius = 0;
+		// the disk is not clipped by the rectangle
+		bool fDiskInside = false;
+		Bound const* fBound = nullptr;
+		bool fSet = false;
+	private:
+		enum class BoundKind {
+			Other,
+			Box,
+			Quadric,
+		};
+		static constexpr int kBoundParams = 9;
+		// the parameters of the bound the clipping depends on
+		void boundParams(Real (&out)[kBoundParams]) const;
+
+		// as given to set()
+		Real fIn[4] = {};
+		BoundKind fBoundKind = BoundKind::Other;
+		Real fBoundIn[kBoundParams] = {};
+	};
+
+}
@@ -65,18 +65,20 @@ namespace srt {
 
 
 
-	Vec3 PlaneStop::sample()
+	void PlaneStop::updateRegion()
 	{
-		for (;;) {
-			Vec3 inter = uniform(fN1Min, fN1Max) * fN1 +
-				uniform(fN2Min, fN2Max) * fN2 +
-				fO;
-			if (inBound(fBound, inter)) {
-				return inter;
-			}
+		if (!fRegion.same(fO, fN1, fN2, fN1Min, fN1Max, fN2Min, fN2Max, fBound)) {
+			fRegion.set(fO, fN1, fN2, fN1Min, fN1Max, fN2Min, fN2Max, fBound);
+			fSQValid = false;
 		}
 	}
 
+	Vec3 PlaneStop::sample()
+	{
+		updateRegion();
+		return fRegion.sample();
+	}
+
 
 
 	Real solid_angle_triangle(Vec3 R, Vec3 r1, Vec3 r2)
@@ -166,11 +168,20 @@ namespace srt {
 	}
 
 
+	void PlaneStop::sphQuadFrom(Vec3 const& ref)
+	{
+		if (fSQValid && ref.fX == fSQRef.fX && ref.fY == fSQRef.fY && ref.fZ == fSQRef.fZ) {
+			return;
+		}
+		SphQuadInit(fSQ, fRegion.corner(), fRegion.edge1(), fRegion.edge2(), ref);
+		fSQRef = ref;
+		fSQValid = true;
+	}
+
 	Real PlaneStop::solidAngle(Vec3 const& ref)
 	{
-		Vec3 s = fO + fN1 * fN1Min + fN2 * fN2Min;
-		SphQuadInit(fSQ, s, fN1 * (fN1Max - fN1Min),
-			fN2 * (fN2Max - fN2Min), ref);
+		updateRegion();
+		sphQuadFrom(ref);
 		return fSQ.S;
 	}
 
@@ -206,17 +217,38 @@ namespace srt {
 
 	Vec3 PlaneStop::sample(Vec3 const& ref)
 	{
-		Vec3 s = fO + fN1 * fN1Min + fN2 * fN2Min;
-		SphQuadInit(fSQ, s, fN1 * (fN1Max - fN1Min),
-			fN2 * (fN2Max - fN2Min), ref);
+		updateRegion();
+		if (fRegion.fShape == PlaneRegion::Shape::Disk && fRegion.fDiskInside) {
+			// a point of the disk by area is kept with cos(theta)/d^2 over
+			// its max, (dmin/d)^3. taken if it keeps more than the square
+			// around the disk keeps by solid angle, about pi/4
+			Vec3 r = ref - fO;
+			Real h2 = Sqr(dot(r, cross(fN1, fN2)));
+			Real rho = sqrt(Sqr(dot(r, fN1) - fRegion.fCU) + Sqr(dot(r, fN2) - fRegion.fCV));
+			Real dmin2 = h2 + Sqr(std::max<Real>(0, rho - fRegion.fRadius));
+			Real dmax2 = h2 + Sqr(rho + fRegion.fRadius);
+			Real worst = dmin2 / dmax2;
+			if (dmin2 > 0 && worst * worst * worst >= Sqr(kPi / 4)) {
+				for (;;) {
+					Vec3 p = fRegion.sample();
+					Real t = dmin2 / norm2(p - ref);
+					if (Sqr(uniform(0, 1)) <= t * t * t) {
+						return p;
+					}
+				}
+			}
+		}
 
+		sphQuadFrom(ref);
 		for (;;) {
 
 			// https://www.arnoldrenderer.com/research/egsr2013_spherical_rectangle.pdf
 			Vec3 inter = SphQuadSample(fSQ,
 				uniform(0, 1), uniform(0, 1));
 
-			if (inBound(fBound, inter)) {
+			if (fRegion.fShape == PlaneRegion::Shape::Rect
+				|| (fRegion.fShape == PlaneRegion::Shape::Disk
+					? fRegion.inDisk(inter) : inBound(fBound, inter))) {
 				return inter;
 			}
 		}
@@ -7,6 +7,7 @@
 #include "PositionSampler.h"
 #include "SourcesPars.h"
 #include "Stop.h"
+#include "PlaneRegion.h"
 
 namespace srt {
 
@@ -54,7 +55,7 @@ namespace srt {
 				fN1 = normalize(fN1);
 			}
 			if constexpr (pars::has<Args...>(pars::n2)) {
-				pars::set(fN1, pars::n2, args...);
+				pars::set(fN2, pars::n2, args...);
 				fN2 = normalize(fN2);
 			}
 
@@ -70,10 +71,12 @@ namespace srt {
 
 		// dProb = dA
 		Vec3 sample() override;
-		// dProb = cos(theta)/distance^2 dA
+		// dProb = cos(theta)/distance^2 dA.
+		// without rejection for a box bound and, mostly, a disk, see PlaneRegion
 		Vec3 sample(Vec3 const& ref) override;
 		bool accept(Vec3 const& ref,
 			Vec3 const& d) override;
+		// of the rectangle sampled, see PlaneRegion::corner
 		Real solidAngle(Vec3 const& ref) override;
 
 
@@ -87,7 +90,16 @@ namespace srt {
 		Bound* fBound = nullptr;
 		std::shared_ptr<Bound> fBound_ = nullptr;
 	private:
+		// rebuilt when the rectangle, the bound, or the limits of a box or
+		// quadric bound change. other bounds are tested on each sample
+		void updateRegion();
+		// sets fSQ for ref, kept for the next samples from the same ref
+		void sphQuadFrom(Vec3 const& ref);
+
+		PlaneRegion fRegion;
 		SphQuad fSQ;
+		Vec3 fSQRef;
+		bool fSQValid = false;
 	};
 
 	inline std::shared_ptr<PlaneStop> planeStop(pars::argument auto const &... args)
@@ -102,12 +114,12 @@ namespace srt {
 			Vec3 const& norm) override;
 
 		bool accept(Vec3 const& o,
-			Vec3 const& d,
-			Vec3 const& norm) override;
+			Vec3 const& norm,
+			Vec3 const& d) override;
 
 		StopDirectionSampler(std::shared_ptr<Stop> stop,
 			std::shared_ptr<DirectionSampler> ds) :
-			fStop(std::move(stop)), fDS(std::move(fDS))
+			fStop(std::move(stop)), fDS(std::move(ds))
 		{
 		}
 		std::shared_ptr<Stop> fStop;
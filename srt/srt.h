@@ -4,12 +4,17 @@
 #include "Bound.h"
 #include "Bounds.h"
 #include "Convex.h"
+#include "CSG.h"
+#include "Instance.h"
+#include "Mesh.h"
+#include "ObjLoader.h"
 #include "Real.h"
 #include "Vec3.h"
 #include "Plane.h"
 #include "Quadric.h"
 #include "Surface.h"
 #include "Surfaces.h"
+#include "Transform.h"
 #include "Spectrum.h"
 #include "Spectrums.h"
 #include "Scaler.h"
@@ -24,6 +29,8 @@
 #include "Recorder.h"
 #include "Recorders.h"
 #include "Engine.h"
+#include "DeviceSet.h"
 #include "MirrorReflect.h"
+#include "ToneMap.h"
 
 #endif
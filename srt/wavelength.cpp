@@ -85,25 +85,42 @@ namespace srt {
 
 	}
 
+	// rgb is linear in xyz, so interpolating rgb at the knots
+	// gives the same result as converting the interpolated xyz
+	struct RGBTable {
+		double r[LEN_LEN];
+		double g[LEN_LEN];
+		double b[LEN_LEN];
+	};
+
+	static RGBTable makeRGBTable()
+	{
+		RGBTable t;
+		for (int i = 0; i < LEN_LEN; ++i) {
+			XYZ2RGB(LEN_X[i], LEN_Y[i], LEN_Z[i], t.r[i], t.g[i], t.b[i]);
+		}
+		return t;
+	}
+
+	static const RGBTable LEN_RGB = makeRGBTable();
+
 	void WaveLength2RGB(double len,
 		double* pr,
 		double* pg,
 		double* pb) {
-		double X, Y, Z;
-		WaveLength2XYZ(len, X, Y, Z);
-		if (X == 0 && Y == 0 && Z == 0) {
+		len -= LEN_MIN;
+		int index = (int)floor(len / LEN_STEP);
+		if (!(len >= 0) || index + 1 >= LEN_LEN) {
 			*pr = 0;
 			*pg = 0;
 			*pb = 0;
 			return;
 		}
+		double offset = len - LEN_STEP * index;
 
-		double r, g, b;
-		XYZ2RGB(X, Y, Z, r, g, b);
-
-		*pr = r;
-		*pg = g;
-		*pb = b;
+		*pr = Interpolate(LEN_RGB.r, index, offset);
+		*pg = Interpolate(LEN_RGB.g, index, offset);
+		*pb = Interpolate(LEN_RGB.b, index, offset);
 	}
 
 }